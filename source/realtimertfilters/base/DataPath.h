@@ -0,0 +1,2 @@
+#define VK_EXAMPLE_DATA_DIR "/root/repo/source/realtimertfilters/realtimertfilters-app/data/"
+#define VK_EXAMPLE_DATA_DIR_W L"/root/repo/source/realtimertfilters/realtimertfilters-app/data/"
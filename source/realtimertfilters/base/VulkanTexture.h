@@ -81,6 +81,18 @@ class Texture2DArray : public Texture
 	    VkQueue            copyQueue,
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	void fromBuffer(
+	    void *             buffer,
+	    VkDeviceSize       bufferSize,
+	    VkFormat           format,
+	    uint32_t           texWidth,
+	    uint32_t           texHeight,
+	    uint32_t           texLayerCount,
+	    vks::VulkanDevice *device,
+	    VkQueue            copyQueue,
+	    VkFilter           filter          = VK_FILTER_LINEAR,
+	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 };
 
 class TextureCubeMap : public Texture
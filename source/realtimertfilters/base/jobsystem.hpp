@@ -0,0 +1,380 @@
+/*
+* Work stealing job system with task dependencies and parallel for
+*
+* Every worker owns a lock free Chase-Lev deque (Le et al. 2013, "Correct and Efficient Work-Stealing for Weak Memory Models").
+* Workers push and pop at the bottom of their own deque and steal from the top of the others.
+* Threads outside the pool submit through a shared injection queue and help executing jobs while they wait.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vks
+{
+	class JobSystem
+	{
+	public:
+		struct Job
+		{
+			std::function<void()> function;
+			// Unfinished dependencies plus one for the outstanding submit
+			std::atomic<uint32_t> pendingDependencies{ 1 };
+			std::atomic<bool> finished{ false };
+			// Guards successors against a dependency finishing while they are added
+			std::mutex successorMutex;
+			std::vector<std::shared_ptr<Job>> successors;
+			// Keeps the job alive while it is queued or running
+			std::shared_ptr<Job> self;
+		};
+		typedef std::shared_ptr<Job> JobHandle;
+
+	private:
+		/*
+			Chase-Lev deque of jobs. push and pop may only be called by the owning worker, steal by any thread
+			Arrays replaced when growing are kept until destruction, as thieves may still read from them
+		*/
+		class WorkStealingQueue
+		{
+		private:
+			struct Array
+			{
+				int64_t capacity;
+				std::unique_ptr<std::atomic<Job*>[]> slots;
+				explicit Array(int64_t capacity) : capacity(capacity), slots(new std::atomic<Job*>[capacity]) {}
+				Job* get(int64_t index) const { return slots[index & (capacity - 1)].load(std::memory_order_relaxed); }
+				void put(int64_t index, Job* job) { slots[index & (capacity - 1)].store(job, std::memory_order_relaxed); }
+			};
+
+			alignas(64) std::atomic<int64_t> top{ 0 };
+			alignas(64) std::atomic<int64_t> bottom{ 0 };
+			std::atomic<Array*> array;
+			std::vector<std::unique_ptr<Array>> arrays;
+
+		public:
+			WorkStealingQueue()
+			{
+				arrays.push_back(std::unique_ptr<Array>(new Array(256)));
+				array.store(arrays.back().get(), std::memory_order_relaxed);
+			}
+
+			void push(Job* job)
+			{
+				int64_t b = bottom.load(std::memory_order_relaxed);
+				int64_t t = top.load(std::memory_order_acquire);
+				Array* a = array.load(std::memory_order_relaxed);
+				if (b - t > a->capacity - 1) {
+					Array* grown = new Array(a->capacity * 2);
+					for (int64_t i = t; i < b; i++) {
+						grown->put(i, a->get(i));
+					}
+					arrays.push_back(std::unique_ptr<Array>(grown));
+					array.store(grown, std::memory_order_release);
+					a = grown;
+				}
+				a->put(b, job);
+				std::atomic_thread_fence(std::memory_order_release);
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+
+			Job* pop()
+			{
+				int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+				Array* a = array.load(std::memory_order_relaxed);
+				bottom.store(b, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t t = top.load(std::memory_order_relaxed);
+				if (t > b) {
+					// Empty
+					bottom.store(b + 1, std::memory_order_relaxed);
+					return nullptr;
+				}
+				Job* job = a->get(b);
+				if (t == b) {
+					// Last job, race against thieves for it
+					if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+						job = nullptr;
+					}
+					bottom.store(b + 1, std::memory_order_relaxed);
+				}
+				return job;
+			}
+
+			Job* steal()
+			{
+				int64_t t = top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t b = bottom.load(std::memory_order_acquire);
+				if (t >= b) {
+					return nullptr;
+				}
+				Array* a = array.load(std::memory_order_acquire);
+				Job* job = a->get(t);
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+					return nullptr;
+				}
+				return job;
+			}
+		};
+
+		std::vector<std::unique_ptr<WorkStealingQueue>> queues;
+		std::vector<std::thread> workers;
+		std::atomic<bool> stopping{ false };
+
+		// Jobs submitted from threads outside the pool
+		std::mutex injectionMutex;
+		std::deque<Job*> injectionQueue;
+
+		// Idle workers sleep until a job is queued
+		std::atomic<int64_t> queuedJobs{ 0 };
+		std::atomic<uint32_t> sleepingWorkers{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+
+		struct WorkerContext
+		{
+			const JobSystem* system = nullptr;
+			int32_t index = -1;
+		};
+		static WorkerContext& currentWorker()
+		{
+			thread_local WorkerContext context;
+			return context;
+		}
+		int32_t currentWorkerIndex() const
+		{
+			const WorkerContext& context = currentWorker();
+			return context.system == this ? context.index : -1;
+		}
+
+		void enqueue(Job* job)
+		{
+			const int32_t worker = currentWorkerIndex();
+			if (worker >= 0) {
+				queues[worker]->push(job);
+			} else {
+				std::lock_guard<std::mutex> lock(injectionMutex);
+				injectionQueue.push_back(job);
+			}
+			queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+			if (sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+				{
+					std::lock_guard<std::mutex> lock(sleepMutex);
+				}
+				sleepCondition.notify_one();
+			}
+		}
+
+		Job* takeJob(int32_t worker)
+		{
+			Job* job = nullptr;
+			if (worker >= 0) {
+				job = queues[worker]->pop();
+			}
+			if (!job) {
+				std::lock_guard<std::mutex> lock(injectionMutex);
+				if (!injectionQueue.empty()) {
+					job = injectionQueue.front();
+					injectionQueue.pop_front();
+				}
+			}
+			// Steal, starting after the own queue so thieves spread over the victims
+			const size_t queueCount = queues.size();
+			const size_t first = worker >= 0 ? static_cast<size_t>(worker) + 1 : 0;
+			for (size_t i = 0; !job && i < queueCount; i++) {
+				const size_t victim = (first + i) % queueCount;
+				if (static_cast<int32_t>(victim) != worker) {
+					job = queues[victim]->steal();
+				}
+			}
+			if (job) {
+				queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		void execute(Job* job)
+		{
+			job->function();
+			job->function = nullptr;
+
+			std::vector<JobHandle> successors;
+			{
+				std::lock_guard<std::mutex> lock(job->successorMutex);
+				job->finished.store(true, std::memory_order_release);
+				successors.swap(job->successors);
+			}
+			for (JobHandle& successor : successors) {
+				release(successor);
+			}
+			// Drops the queue's reference, the job may be deleted here
+			JobHandle keepAlive = std::move(job->self);
+		}
+
+		void release(const JobHandle& job)
+		{
+			if (job->pendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				enqueue(job.get());
+			}
+		}
+
+		bool executeNext()
+		{
+			Job* job = takeJob(currentWorkerIndex());
+			if (!job) {
+				return false;
+			}
+			execute(job);
+			return true;
+		}
+
+		void workerLoop(int32_t index)
+		{
+			currentWorker() = WorkerContext{ this, index };
+			uint32_t idleSpins = 0;
+			while (!stopping.load(std::memory_order_acquire)) {
+				if (executeNext()) {
+					idleSpins = 0;
+					continue;
+				}
+				if (++idleSpins < 64) {
+					std::this_thread::yield();
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+				sleepCondition.wait(lock, [this] { return stopping.load() || queuedJobs.load(std::memory_order_seq_cst) > 0; });
+				sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+				idleSpins = 0;
+			}
+		}
+
+		struct ParallelForContext
+		{
+			JobSystem* system;
+			const std::function<void(uint32_t, uint32_t)>* body;
+			uint32_t grainSize;
+			std::atomic<uint32_t> remaining;
+		};
+
+		// Splits off the upper halves as jobs for other workers to steal and runs the lowest part in place
+		static void parallelForRange(ParallelForContext* context, uint32_t begin, uint32_t end)
+		{
+			while (end - begin > context->grainSize) {
+				const uint32_t middle = begin + (end - begin) / 2;
+				context->system->run([context, middle, end] { parallelForRange(context, middle, end); });
+				end = middle;
+			}
+			(*context->body)(begin, end);
+			context->remaining.fetch_sub(end - begin, std::memory_order_acq_rel);
+		}
+
+	public:
+		/** @brief Creates the workers, 0 uses one per hardware thread except for the calling thread, which helps while waiting */
+		explicit JobSystem(uint32_t workerCount = 0)
+		{
+			if (workerCount == 0) {
+				const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+				workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+			}
+			for (uint32_t i = 0; i < workerCount; i++) {
+				queues.push_back(std::unique_ptr<WorkStealingQueue>(new WorkStealingQueue()));
+			}
+			for (uint32_t i = 0; i < workerCount; i++) {
+				workers.emplace_back(&JobSystem::workerLoop, this, static_cast<int32_t>(i));
+			}
+		}
+
+		~JobSystem()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				stopping.store(true, std::memory_order_release);
+			}
+			sleepCondition.notify_all();
+			for (std::thread& worker : workers) {
+				worker.join();
+			}
+		}
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		/** @brief Job system shared by the loaders and passes of the application */
+		static JobSystem& shared()
+		{
+			static JobSystem system;
+			return system;
+		}
+
+		uint32_t getWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+		/** @brief Creates a job, it starts after submit once all of its dependencies have finished */
+		JobHandle create(std::function<void()> function)
+		{
+			JobHandle job = std::make_shared<Job>();
+			job->function = std::move(function);
+			return job;
+		}
+
+		/** @brief Lets job wait for dependency. Has to be called before submitting job */
+		void addDependency(const JobHandle& job, const JobHandle& dependency)
+		{
+			std::lock_guard<std::mutex> lock(dependency->successorMutex);
+			if (!dependency->finished.load(std::memory_order_acquire)) {
+				job->pendingDependencies.fetch_add(1, std::memory_order_relaxed);
+				dependency->successors.push_back(job);
+			}
+		}
+
+		void submit(const JobHandle& job)
+		{
+			job->self = job;
+			release(job);
+		}
+
+		JobHandle run(std::function<void()> function)
+		{
+			JobHandle job = create(std::move(function));
+			submit(job);
+			return job;
+		}
+
+		/** @brief Executes other jobs until the job has finished */
+		void wait(const JobHandle& job)
+		{
+			while (!job->finished.load(std::memory_order_acquire)) {
+				if (!executeNext()) {
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		/** @brief Calls body for consecutive ranges of at most grainSize elements covering [0, count) and waits for all of them */
+		void parallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t begin, uint32_t end)>& body)
+		{
+			if (count == 0) {
+				return;
+			}
+			ParallelForContext context{ this, &body, std::max(1u, grainSize), { count } };
+			parallelForRange(&context, 0, count);
+			while (context.remaining.load(std::memory_order_acquire) > 0) {
+				if (!executeNext()) {
+					std::this_thread::yield();
+				}
+			}
+		}
+	};
+}
@@ -948,7 +948,8 @@ bool VulkanExampleBase::initVulkan()
 	// This is handled by a separate class that gets a logical device representation
 	// and encapsulates functions related to a device
 	vulkanDevice = new vks::VulkanDevice(physicalDevice);
-	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
+	// A dedicated transfer queue is used for texture uploads if the device has one
+	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain, true, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
 	if (res != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), res);
 		return false;
@@ -2736,6 +2737,8 @@ CommandLineParser::CommandLineParser()
 	add("benchmarkruntime", { "-br", "--benchruntime" }, 1, "Set duration time for benchmark mode in seconds");
 	add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
 	add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
+	add("rayquery", { "-rq", "--rayquery" }, 0, "Trace with ray queries from compute instead of the ray tracing pipeline");
+	add("compresstextures", { "-ct", "--compresstextures" }, 0, "Cook the color textures of the scene to BC7 and cache them");
 }
 
 void CommandLineParser::add(std::string name, std::vector<std::string> commands, bool hasValue, std::string help)
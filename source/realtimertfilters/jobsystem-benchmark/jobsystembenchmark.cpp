@@ -0,0 +1,116 @@
+/*
+* Microbenchmark comparing the work stealing job system against the per-thread queues of vks::ThreadPool
+* Standalone, it only needs the two headers from base and no Vulkan device
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "jobsystem.hpp"
+#include "threadpool.hpp"
+
+namespace vks
+{
+	class JobSystemBenchmark {
+	private:
+		struct Workload {
+			std::string name;
+			uint32_t jobCount;
+			// Iterations of job i, lets workloads model uneven jobs
+			std::function<uint32_t(uint32_t)> cost;
+		};
+
+		std::vector<float> results;
+
+		void work(uint32_t job, uint32_t iterations) {
+			float x = static_cast<float>(job);
+			for (uint32_t i = 0; i < iterations; i++) {
+				x = std::sqrt(x * 1.0001f + 1.0f);
+			}
+			results[job] = x;
+		}
+
+		template<typename Function>
+		double measure(Function function) {
+			// Best of several runs, the first one also warms up the threads
+			double best = std::numeric_limits<double>::max();
+			for (uint32_t run = 0; run < repetitions; run++) {
+				auto tStart = std::chrono::high_resolution_clock::now();
+				function();
+				best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count());
+			}
+			return best;
+		}
+
+	public:
+		uint32_t repetitions = 10;
+
+		void run() {
+			const uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+			const std::vector<Workload> workloads = {
+				{ "uniform, 100000 small jobs", 100000, [](uint32_t) { return 200u; } },
+				{ "uniform, 1000 large jobs", 1000, [](uint32_t) { return 20000u; } },
+				// Every 32nd job is 100 times as expensive, round robin assignment piles them up on few threads
+				{ "uneven, 4000 jobs", 4000, [](uint32_t job) { return (job % 32 == 0) ? 200000u : 2000u; } },
+			};
+
+			vks::ThreadPool threadPool;
+			threadPool.setThreadCount(threadCount);
+			// The calling thread helps the job system while waiting, so both use the same number of threads
+			vks::JobSystem jobSystem(threadCount > 1 ? threadCount - 1 : 1);
+
+			std::cout << std::fixed << std::setprecision(3);
+			std::cout << "Job system benchmark (" << threadCount << " threads, best of " << repetitions << " runs)" << "\n";
+			for (const Workload& workload : workloads) {
+				results.assign(workload.jobCount, 0.0f);
+
+				const double tThreadPool = measure([&] {
+					for (uint32_t i = 0; i < workload.jobCount; i++) {
+						threadPool.threads[i % threadPool.threads.size()]->addJob([&, i] { work(i, workload.cost(i)); });
+					}
+					threadPool.wait();
+				});
+				const double tJobs = measure([&] {
+					std::vector<JobSystem::JobHandle> jobs(workload.jobCount);
+					for (uint32_t i = 0; i < workload.jobCount; i++) {
+						jobs[i] = jobSystem.run([&, i] { work(i, workload.cost(i)); });
+					}
+					for (JobSystem::JobHandle& job : jobs) {
+						jobSystem.wait(job);
+					}
+				});
+				const double tParallelFor = measure([&] {
+					jobSystem.parallelFor(workload.jobCount, 1, [&](uint32_t begin, uint32_t end) {
+						for (uint32_t i = begin; i < end; i++) {
+							work(i, workload.cost(i));
+						}
+					});
+				});
+
+				std::cout << workload.name << "\n";
+				std::cout << "  thread pool         : " << tThreadPool << " ms" << "\n";
+				std::cout << "  job system, jobs    : " << tJobs << " ms (" << tThreadPool / tJobs << "x)" << "\n";
+				std::cout << "  job system, for     : " << tParallelFor << " ms (" << tThreadPool / tParallelFor << "x)" << "\n";
+			}
+			std::cout << std::flush;
+		}
+	};
+}
+
+int main(int argc, char* argv[])
+{
+	vks::JobSystemBenchmark benchmark;
+	if (argc > 1) {
+		benchmark.repetitions = std::max(1, std::atoi(argv[1]));
+	}
+	benchmark.run();
+	return 0;
+}
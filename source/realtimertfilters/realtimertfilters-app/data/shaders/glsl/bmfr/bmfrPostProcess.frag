@@ -36,7 +36,7 @@ void main()
 	ivec2 texel_prevFrame = TexelizeCoords(uv_prevFrame);
 	int historylength = texelFetch(Tex_HistoryLength, texel_prevFrame, 0).x;	// HistoryLength = number of previous frames that we didn't yet discard
 
-	if (ubo_accuconfig.EnableAccumulation == 0 || 
+	if (ubo_accuconfig.EnableAccumulation == 0 || PushC.HISTORY_RESET != 0 ||
 		historylength <= 1)							// A history length of 1 means the texel was discarded in the preprocess pass
 	{
 		return;
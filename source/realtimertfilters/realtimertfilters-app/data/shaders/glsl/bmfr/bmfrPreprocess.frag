@@ -57,6 +57,7 @@ void main()
 
 	// Check if prev frame UV is outside of view frustrum
 	bool discard_viewFrustrum = uv_prevFrame.x < 0.f || uv_prevFrame.y < 0.f || uv_prevFrame.x > 1.f || uv_prevFrame.y > 1.f;
+	discard_viewFrustrum = discard_viewFrustrum || PushC.HISTORY_RESET != 0;	// The history was rendered at another size
 
 
 	if (discard_viewFrustrum)
@@ -2,6 +2,7 @@ layout(push_constant) uniform constants
 {
 	uint SCR_WIDTH;
 	uint SCR_HEIGHT;
+	uint HISTORY_RESET;		// 1 on the first frame after the render size changed, temporal passes then drop their history
 } PushC;
 
 ivec2	iSCRDIM = ivec2(PushC.SCR_WIDTH, PushC.SCR_HEIGHT);
@@ -0,0 +1,94 @@
+#version 420
+#extension GL_KHR_vulkan_glsl : enable
+
+// Reconstructs the output resolution image from the dynamic resolution render size.
+// The bilinear upsampled frame is blended with the reprojected output of the previous frame,
+// which is clamped to the colors around the pixel to reject stale history
+
+// RENDER SIZE INPUTS
+layout (set = 0, binding = 0) uniform sampler2D Tex_Color;				// Filtered color at render size
+layout (set = 0, binding = 1) uniform sampler2D Tex_Motion;				// Screenspace motion vector at render size
+
+// OUTPUT SIZE INPUTS/OUTPUTS
+layout (set = 0, binding = 2) uniform sampler2D Tex_History;			// Previous frame output
+layout (location = 0) out vec4 Out_Color;								// Output resolution color
+
+#include "filtercommon.glsl"
+
+#define BIND_DYNAMICRESOLUTIONCONFIG 0
+#define SET_DYNAMICRESOLUTIONCONFIG 1
+#include "../ubo_definitions.glsl"
+
+ivec2 renderSize = ivec2(ubo_dynamicresolutionconfig.RenderWidth, ubo_dynamicresolutionconfig.RenderHeight);
+
+vec3 fetchColor(in ivec2 texel)
+{
+	return texelFetch(Tex_Color, clamp(texel, ivec2(0), renderSize - 1), 0).rgb;
+}
+
+vec3 fetchHistory(in ivec2 texel)
+{
+	return texelFetch(Tex_History, clamp(texel, ivec2(0), iSCRDIM - 1), 0).rgb;
+}
+
+// Bilinear filtering by hand, the render size only covers part of the attachment
+vec3 bilinearColor(in vec2 position)
+{
+	vec2 p = position - 0.5;
+	ivec2 base = ivec2(floor(p));
+	vec2 f = p - vec2(base);
+	return mix(
+		mix(fetchColor(base), fetchColor(base + ivec2(1, 0)), f.x),
+		mix(fetchColor(base + ivec2(0, 1)), fetchColor(base + ivec2(1, 1)), f.x),
+		f.y);
+}
+
+vec3 bilinearHistory(in vec2 position)
+{
+	vec2 p = position - 0.5;
+	ivec2 base = ivec2(floor(p));
+	vec2 f = p - vec2(base);
+	return mix(
+		mix(fetchHistory(base), fetchHistory(base + ivec2(1, 0)), f.x),
+		mix(fetchHistory(base + ivec2(0, 1)), fetchHistory(base + ivec2(1, 1)), f.x),
+		f.y);
+}
+
+void main()
+{
+	// Rendered at output resolution, nothing to reconstruct
+	if (renderSize == iSCRDIM)
+	{
+		Out_Color = vec4(texelFetch(Tex_Color, Texel, 0).rgb, 1.0);
+		return;
+	}
+
+	vec2 renderPosition = UV * vec2(renderSize);
+	ivec2 renderTexel = ivec2(renderPosition);
+	vec3 current = bilinearColor(renderPosition);
+
+	// Color range of the render texels around the pixel
+	vec3 minColor = vec3(1e30);
+	vec3 maxColor = vec3(-1e30);
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+		{
+			vec3 color = fetchColor(renderTexel + ivec2(x, y));
+			minColor = min(minColor, color);
+			maxColor = max(maxColor, color);
+		}
+	}
+
+	vec2 motion = texelFetch(Tex_Motion, clamp(renderTexel, ivec2(0), renderSize - 1), 0).xy;
+	vec2 uv_prevFrame = UV + motion;
+	// The history holds the previous render size upscaled, drop it when that changed
+	if (any(lessThan(uv_prevFrame, vec2(0))) || any(greaterThan(uv_prevFrame, vec2(1))) || PushC.HISTORY_RESET != 0)
+	{
+		Out_Color = vec4(current, 1.0);
+		return;
+	}
+
+	vec3 history = clamp(bilinearHistory(uv_prevFrame * SCRDIM), minColor, maxColor);
+	Out_Color = vec4(mix(current, history, ubo_dynamicresolutionconfig.HistoryWeight), 1.0);
+}
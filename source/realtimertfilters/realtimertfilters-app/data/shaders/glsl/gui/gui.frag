@@ -18,8 +18,10 @@ void main()
 	int index = (inUV.x > ubo_guibase.SplitViewFactor) ? ubo_guibase.ImageRight : ubo_guibase.ImageLeft;
 	if (index != INT_MAX)
 	{
-		// Debug display
-		outFragcolor.xyz = texture(attachments[index], inUV).xyz;
+		// Debug display, attachments rendered at the dynamic resolution render size only fill their upper left part
+		bool outputResolution = ((ubo_guibase.OutputResolutionMask >> uint(index)) & 1u) != 0;
+		vec2 uv = outputResolution ? inUV : inUV * vec2(ubo_guibase.RenderScaleX, ubo_guibase.RenderScaleY);
+		outFragcolor.xyz = texture(attachments[index], uv).xyz;
 		outFragcolor.a = 1.0;
 		return;
 	}
@@ -0,0 +1,37 @@
+/// Compact vertex stream used for hit shading in the path tracer (vkglTF::HitVertex)
+/// Size: 2 * 4 = 8 Byte
+/// x = octahedral encoded normal, packed as snorm16x2
+/// y = texture coordinate, packed as half2
+
+vec2 octSignNotZero(vec2 v)
+{
+	return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+uint octEncode(vec3 n)
+{
+	n /= (abs(n.x) + abs(n.y) + abs(n.z) + 1e-20);
+	vec2 oct = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * octSignNotZero(n.xy);
+	return packSnorm2x16(oct);
+}
+
+vec3 octDecode(uint packedNormal)
+{
+	vec2 oct = unpackSnorm2x16(packedNormal);
+	vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+	if (n.z < 0.0)
+	{
+		n.xy = (1.0 - abs(n.yx)) * octSignNotZero(n.xy);
+	}
+	return normalize(n);
+}
+
+vec3 hitVertexNormal(uvec2 hitVertex)
+{
+	return octDecode(hitVertex.x);
+}
+
+vec2 hitVertexUV(uvec2 hitVertex)
+{
+	return unpackHalf2x16(hitVertex.y);
+}
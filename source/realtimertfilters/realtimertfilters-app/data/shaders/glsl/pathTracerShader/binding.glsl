@@ -10,6 +10,14 @@
 #define B_TEXTURES 7
 #define B_IMAGE_DIRECT 8
 #define B_IMAGE_INDIRECT 9
+#define B_HITTRIANGLES 10
+#define B_LIGHTS 11
+#define B_BLUENOISE 12
+#define B_IMAGE_SAMPLEBUDGET 13
+#define B_IMAGE_INDIRECT_REDUCED 14
+#define B_GBUFFER_POSITION 15
+#define B_GBUFFER_NORMAL 16
+#define B_GBUFFER_ALBEDO 17
 
 #define LOCATION_PBR 0
 #define LOCATION_SHADOW 1
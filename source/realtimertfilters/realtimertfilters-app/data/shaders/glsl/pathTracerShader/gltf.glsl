@@ -5,6 +5,7 @@ struct GltfShadeMaterial
 {
 	glm::vec4 baseColorFactor;
 	glm::vec4 baseColorTextureId; // origin int
+	glm::vec4 normalTextureId; // origin int
 };
 #endif
 
@@ -13,6 +14,7 @@ struct GltfShadeMaterial
 {
 	vec4	baseColorFactor;
 	vec4	baseColorTextureId;
+	vec4	normalTextureId;
 };
 
 vec3 computeDiffuse(GltfShadeMaterial mat, vec3 lightDir, vec3 normal)
@@ -0,0 +1,95 @@
+/// Surface evaluation shared by the closest hit shader and the ray query path tracer
+/// Requires binding.glsl, gltf.glsl and ../hitvertex.glsl
+
+layout(binding = B_VERTICES) readonly buffer _HitVertexBuf { uvec2 v[]; } hitVertices;
+layout(binding = B_INDICES) readonly buffer _Indices { uint i[]; }indices;
+struct S_HitTriangle
+{
+	int materialId;
+	float lodBias;			// 0.5 * log2(uv area / world area), see vkglTF::HitTriangle
+};
+
+layout(binding = B_HITTRIANGLES) readonly buffer _HitTriangles { S_HitTriangle t[]; } hitTriangles;
+layout(binding = B_MATERIALS ) readonly buffer _MaterialBuffer {GltfShadeMaterial m[];} materials;
+layout(binding = B_TEXTURES) uniform sampler2D textureMap[]; // all textures
+
+struct S_Vertex 
+{
+	vec3 normal;
+	vec2 uv;
+};
+
+struct S_GeometryHitPoint
+{
+	vec3 pos_world;
+	vec3 normal_world;
+	vec2 uv;
+	vec3 albedo;
+	int materialId;
+};
+
+S_Vertex getVertex(uint index)
+{
+	// Only the attributes needed for shading are fetched from the compact hit vertex stream
+	uvec2 d = hitVertices.v[index];
+
+	S_Vertex v;
+	v.normal = hitVertexNormal(d);
+	v.uv = hitVertexUV(d);
+	return v;
+}
+
+/*
+	Texture LOD of a ray cone hit (Ray Tracing Gems, chapter 20)
+	The triangle term comes precomputed, the cone footprint grows as the surface turns away from the ray
+*/
+float rayConeLod(in float lodBias, in ivec2 texSize, in vec3 normal, in vec3 direction, in float coneWidth)
+{
+	float lod = lodBias + 0.5 * log2(float(texSize.x * texSize.y));
+	lod += log2(max(abs(coneWidth), 1e-8) / max(abs(dot(normal, normalize(direction))), 1e-4));
+	return lod;
+}
+
+bool hasTexture(int texId){
+	return texId > -1;
+}
+
+/*
+	Evaluate the surface attributes of a hit
+	triangle = index of the triangle in the scene index buffer (instance custom index + primitive id)
+	attribs = barycentrics of the hit, pos_world = hit position reconstructed from the ray
+	direction = world space ray direction, coneWidth = ray cone width at the hit, selects the texture LOD
+*/
+S_GeometryHitPoint initGeometryHitPoint(in uint triangle, in vec2 attribs, in vec3 pos_world, in mat4x3 worldToObject, in vec3 direction, in float coneWidth)
+{
+	S_GeometryHitPoint hitpoint;
+	ivec3 index = ivec3(indices.i[3 * triangle], indices.i[3 * triangle + 1], indices.i[3 * triangle + 2]);
+
+	// barycentrics coordinates
+	const vec3 barycentrics = vec3(1.0f - attribs.x - attribs.y, attribs.x, attribs.y);
+
+	// Vertex of the triangle
+	S_Vertex v0 = getVertex(index.x);
+	S_Vertex v1 = getVertex(index.y);
+	S_Vertex v2 = getVertex(index.z);
+	// Positions are reconstructed from the ray instead of being fetched
+	hitpoint.pos_world = pos_world;
+
+	// Interpolate normal of hitpoint
+	vec3 normal = normalize(v0.normal * barycentrics.x + v1.normal * barycentrics.y + v2.normal * barycentrics.z);
+	hitpoint.normal_world = normalize(vec3(normal * worldToObject));
+
+	// Calculate uv and color/texture
+	hitpoint.uv = v0.uv * barycentrics.x + v1.uv * barycentrics.y + v2.uv * barycentrics.z;
+	S_HitTriangle hitTriangle = hitTriangles.t[triangle];
+	hitpoint.materialId = hitTriangle.materialId;
+	// float texId = (materials.m[hitpoint.materialId].baseColorTextureId.x);
+	int texId = int(materials.m[hitpoint.materialId].baseColorTextureId.x);
+	// hitpoint.albedo = vec3(texId,1,1);
+	if (hasTexture(texId)){
+		hitpoint.albedo = textureLod(textureMap[texId], hitpoint.uv, rayConeLod(hitTriangle.lodBias, textureSize(textureMap[texId], 0), hitpoint.normal_world, direction, coneWidth)).rgb;
+	} else {
+		hitpoint.albedo = materials.m[hitpoint.materialId].baseColorFactor.rgb;
+	}
+	return hitpoint;
+}
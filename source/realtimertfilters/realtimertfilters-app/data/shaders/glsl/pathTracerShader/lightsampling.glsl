@@ -0,0 +1,69 @@
+/// Light sampling over the light SSBO, shared by the path tracer and the ReSTIR passes
+/// Requires sampling.glsl and the light SSBO
+
+/*
+	Pick one light proportional to its power with the alias table of the light buffer
+*/
+uint sampleLightIndex(in vec2 u, in uint lightCount, out float pdf)
+{
+	uint index = min(uint(u.x * lightCount), lightCount - 1);
+	if (u.y >= ssbo_lights.Lights[index].AliasProbability)
+	{
+		index = ssbo_lights.Lights[index].Alias;
+	}
+	pdf = ssbo_lights.Lights[index].SelectionPdf;
+	return index;
+}
+
+uint sampleLightIndex(inout uint seed, in uint lightCount, out float pdf)
+{
+	return sampleLightIndex(vec2(rnd(seed), rnd(seed)), lightCount, pdf);
+}
+
+// Point on a triangle light, uniform by area. Ignored for other light types
+vec2 sampleLightUV(in vec2 u)
+{
+	if (u.x + u.y > 1.0)
+	{
+		u = 1.0 - u;
+	}
+	return u;
+}
+
+vec2 sampleLightUV(inout uint seed)
+{
+	return sampleLightUV(vec2(rnd(seed), rnd(seed)));
+}
+
+/*
+	Irradiance arriving at pos from the point uv of the light, without visibility and surface cosine.
+	Triangle lights are converted from area to solid angle measure
+*/
+vec3 evaluateLight(in S_SceneLight light, in vec2 uv, in vec3 pos, out vec3 lightDir, out float lightDistance)
+{
+	vec3 Li = light.RadiantFlux * light.Color;
+	lightDistance = 100000.0;
+
+	if (light.Type == LIGHT_TYPE_POINT)
+	{
+		vec3 lightVector = light.Position - pos;
+		lightDistance = length(lightVector);
+		lightDir = lightVector / lightDistance;
+		Li /= lightDistance * lightDistance;
+	}
+	else if (light.Type == LIGHT_TYPE_TRIANGLE)
+	{
+		vec3 lightVector = light.Position + uv.x * light.Edge1 + uv.y * light.Edge2 - pos;
+		lightDistance = length(lightVector);
+		lightDir = lightVector / lightDistance;
+		vec3 areaNormal = cross(light.Edge1, light.Edge2);
+		// Emitters are two sided, 0.5 * |areaNormal| is the area
+		float cosLight = abs(dot(areaNormal, lightDir)) * 0.5;
+		Li *= cosLight / (lightDistance * lightDistance);
+	}
+	else // Directional light
+	{
+		lightDir = normalize(light.Position);
+	}
+	return Li;
+}
@@ -0,0 +1,211 @@
+/// Path tracing loop shared by the ray tracing pipeline (raygen.rgen) and the ray query backend (raytrace_rayquery.comp)
+/// Requires sampling.glsl, lightsampling.glsl, sampler.glsl, reducedindirect.glsl, the scene info UBO, the light SSBO, the sample budget image,
+/// the indirect light images, the G-buffer images and the path tracer push constant
+
+struct S_Surface
+{
+	vec3 pos_world;
+	vec3 normal_world;
+	vec3 albedo;
+	float coneWidth;		// Width of the ray cone footprint at the surface
+};
+
+// Ray cone for texture filtering (Ray Tracing Gems, chapter 20), width at the ray origin and spread angle in radians
+struct S_RayCone
+{
+	float width;
+	float spread;
+};
+
+// Spread added at every diffuse bounce. A Lambertian lobe has no meaningful cone, this keeps bounce lookups on coarse mips
+const float DIFFUSE_CONE_SPREAD = 0.05;
+
+// Implemented by the including shader (ray tracing pipeline or ray query)
+// Trace a ray, returns false on miss
+bool traceSurface(in vec3 origin, in vec3 direction, in S_RayCone cone, out S_Surface surface);
+// Trace a visibility ray, returns true if any geometry lies between tmin and tmax
+bool traceShadow(in vec3 origin, in vec3 direction, in float tmin, in float tmax);
+
+/*
+	Direct light from a single light chosen by importance, so every shading point costs one shadow ray regardless of the light count
+*/
+vec3 calculateDirectLight(in S_Surface surface, inout S_Sampler pathSampler)
+{
+	if (config.LightCount == 0)
+	{
+		return vec3(0);
+	}
+
+	float selectionPdf;
+	S_SceneLight light = ssbo_lights.Lights[sampleLightIndex(sample2D(pathSampler), config.LightCount, selectionPdf)];
+
+	// Vector toward the light
+	vec3 lightDir;
+	float lightDistance;
+	vec3 Li = evaluateLight(light, sampleLightUV(sample2D(pathSampler)), surface.pos_world, lightDir, lightDistance);
+
+	const float BIAS = 0.001;
+
+	float NdotL = dot(surface.normal_world, lightDir);
+	if (NdotL <= 0)				// Only do shadow tests when the surface faces the light source
+	{
+		return vec3(0);
+	}
+
+	// Casting shadow ray
+	float tmin = BIAS;							// Minimum travel distance means the ray cannot re-intersect with the same primitive.
+	float tmax = lightDistance - BIAS;			// Preventing intersects "behind" the light source (and with an emitting triangle itself).
+	vec3 origin =
+		surface.pos_world + surface.normal_world * BIAS;			// Origin bias away from geometry to prevent artifacts
+	if (traceShadow(origin, lightDir, tmin, tmax))
+	{
+		return vec3(0);
+	}
+	return NdotL * Li / selectionPdf;
+}
+
+/*
+	Follow one path starting at the primary hit. Every bounce attenuates by albedo / PI,
+	each surface along the path adds its direct lighting. The result excludes the albedo of the primary hit
+*/
+vec3 calculateIndirectLight(in S_Surface primary, in float pixelSpread, inout S_Sampler pathSampler)
+{
+	vec3 indirect = vec3(0);
+	vec3 throughput = vec3(1.0 / M_PI);
+	S_Surface surface = primary;
+	S_RayCone cone = S_RayCone(primary.coneWidth, pixelSpread);
+	for (uint depth = 1; depth < config.MaxBounceDepth; depth++)
+	{
+		vec3 direction = sampleLambert(sample2D(pathSampler), createTBN(surface.normal_world));
+		cone = S_RayCone(surface.coneWidth, cone.spread + DIFFUSE_CONE_SPREAD);
+		if (!traceSurface(surface.pos_world, direction, cone, surface))
+		{
+			break;				// Miss, no environment light
+		}
+		throughput *= surface.albedo;
+		indirect += throughput * calculateDirectLight(surface, pathSampler);
+		throughput /= M_PI;
+	}
+	return indirect;
+}
+
+/*
+	Primary surface of the rasterized G-buffer, returns false where no geometry was rasterized.
+	Shading inputs match the filters' G-buffer exactly, no primary ray is needed
+*/
+bool loadGbufferSurface(in ivec2 pixel, in float pixelSpread, out S_Surface surface)
+{
+	vec4 position = imageLoad(imageGbufferPosition, pixel);
+	if (position.w == 0)
+	{
+		return false;
+	}
+	surface.normal_world = normalize(imageLoad(imageGbufferNormal, pixel).xyz);
+	surface.albedo = imageLoad(imageGbufferAlbedo, pixel).rgb;
+	surface.coneWidth = pixelSpread * distance(ubo_sceneinfo.ViewMatInverse[3].xyz, position.xyz);
+
+	// Half float positions are exact to about 1/2048 of their magnitude, lift them off the surface by more than that
+	vec3 magnitude = abs(position.xyz);
+	surface.pos_world = position.xyz + surface.normal_world * max(0.001, 0.001 * max(magnitude.x, max(magnitude.y, magnitude.z)));
+	return true;
+}
+
+/*
+	Path trace all primary samples of a pixel, results are averaged over the samples.
+	Without traceIndirect only the primary hit and its direct light are computed
+*/
+void tracePixel(in uvec2 pixel, in uvec2 size, in bool traceIndirect, out vec3 hitValue, out vec3 directValue, out vec3 inDirectValue)
+{
+	hitValue = vec3(0);
+	directValue = vec3(0);
+	inDirectValue = vec3(0);
+
+	// Adaptive sampling takes the sample count the SVGF accumulation chose for this pixel last frame
+	uint sampleCount = config.PrimarySamplesPerPixel;
+	uint sequenceStride = config.PrimarySamplesPerPixel;
+	if (config.AdaptiveSampling != 0)
+	{
+		sampleCount = uint(clamp(imageLoad(imageSampleBudget, ivec2(pixel)).x, 1, ADAPTIVE_SAMPLING_MAX_SAMPLES));
+		sequenceStride = ADAPTIVE_SAMPLING_MAX_SAMPLES;
+	}
+
+	// Spread angle of the primary ray cones, one pixel seen from the camera
+	const float pixelSpread = atan(2.0 / (abs(ubo_sceneinfo.ProjMat[1][1]) * float(size.y)));
+
+	// Primary rays go through the pixel center, so with the G-buffer all samples share its surface
+	S_Surface gbufferSurface;
+	const bool hybridPrimary = config.HybridPrimary != 0;
+	if (hybridPrimary && !loadGbufferSurface(ivec2(pixel), pixelSpread, gbufferSurface))
+	{
+		return;
+	}
+
+	// Send sampels
+	for (uint smpl = 0; smpl < sampleCount; smpl++)
+	{
+		S_Sampler pathSampler = initSampler(pixel, size, config.Frame * sequenceStride + smpl);
+
+		S_Surface primary = gbufferSurface;
+		if (!hybridPrimary)
+		{
+			const vec2 pixelCenter = vec2(pixel) + vec2(0.5);
+			const vec2 inUV = pixelCenter / vec2(size);
+			vec2 d = inUV * 2.0 - 1.0;
+
+			vec4 origin = ubo_sceneinfo.ViewMatInverse * vec4(0, 0, 0, 1);
+			vec4 target = ubo_sceneinfo.ProjMatInverse * vec4(d.x, d.y, 1, 1);
+			vec4 direction = ubo_sceneinfo.ViewMatInverse * vec4(normalize(target.xyz / target.w), 0);
+
+			if (!traceSurface(origin.xyz, direction.xyz, S_RayCone(0.0, pixelSpread), primary))
+			{
+				continue;
+			}
+		}
+
+		// ReSTIR DI replaces the direct light of the primary hit, its shadow ray would be wasted
+		vec3 direct = config.RestirDirect != 0 ? vec3(0) : calculateDirectLight(primary, pathSampler);
+
+		// Secondary samples split the path only at the primary hit, so the ray count stays linear in the bounce depth
+		vec3 indirect = vec3(0);
+		if (traceIndirect)
+		{
+			for (int i = 0; i < config.SecondarySamplesPerBounce; i++)
+			{
+				indirect += calculateIndirectLight(primary, pixelSpread, pathSampler);
+			}
+			indirect /= max(config.SecondarySamplesPerBounce, 1u);
+		}
+
+		hitValue += (direct + indirect) * primary.albedo;
+		directValue += direct;
+		inDirectValue += indirect;
+	}
+
+	hitValue /= sampleCount;
+	directValue /= sampleCount;
+	inDirectValue /= sampleCount;
+}
+
+/*
+	Trace a pixel and write its results. In the reduced indirect modes only some pixels trace indirect light,
+	which then goes to the reduced image for the upsampling pass (the combined image lacks it on the other pixels)
+*/
+void traceAndStorePixel(in uvec2 pixel, in uvec2 size)
+{
+	float reducedOffset = 0;
+	const bool traceIndirect = config.IndirectMode == INDIRECT_MODE_FULL || isReducedIndirectPixel(ivec2(pixel), config.IndirectMode, config.Frame, reducedOffset);
+
+	vec3 hitValue, directValue, inDirectValue;
+	tracePixel(pixel, size, traceIndirect, hitValue, directValue, inDirectValue);
+
+	imageStore(image, ivec2(pixel), vec4(hitValue, 1.f));
+	imageStore(imageDirect, ivec2(pixel), vec4(directValue, 1.f));
+	if (config.IndirectMode == INDIRECT_MODE_FULL)
+	{
+		imageStore(imageIndirect, ivec2(pixel), vec4(inDirectValue, 1.f));
+	}
+	else if (traceIndirect)
+	{
+		imageStore(imageIndirectReduced, reducedIndirectTexel(ivec2(pixel), config.IndirectMode), vec4(inDirectValue, reducedOffset));
+	}
+}
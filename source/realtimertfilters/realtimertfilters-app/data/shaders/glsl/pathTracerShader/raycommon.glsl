@@ -1,27 +1,30 @@
 
-struct S_HitPayload
+/// Payload returned by the closest hit / miss shaders. The bounce loop lives in raygen,
+/// so hit shaders only report the surface they found
+/// Size: 8 * 4 = 32 Byte
+struct S_SurfacePayload
 {
-	vec3	radiance;
-	vec3	radianceDirect;
-	vec3	radianceIndirect;
-	vec3	attenuation;
-	uint	seed;
-	uint	depth;
-	vec3	albedo;
-	vec3	normal;
+	vec3	position;		// World space hit position
+	float	hitT;			// Ray distance of the hit, negative on miss
+	uint	normal;			// World space shading normal, octahedral encoded (see hitvertex.glsl)
+	uint	albedo;			// Albedo, packed as unorm4x8
+	float	coneWidth;		// Ray cone at the origin, set by the caller. Holds the width at the hit on return
+	float	coneSpread;		// Ray cone spread angle, set by the caller
 };
 
-S_HitPayload InitHitpayload(in uint seed)
+S_SurfacePayload InitSurfacePayload()
 {
-	S_HitPayload result;
-	result.radiance = vec3(0.0);
-	result.radianceDirect = vec3(0.0);
-	result.radianceIndirect = vec3(0.0);
-	result.attenuation = vec3(1.0);
-	result.seed = seed;
-	result.depth = 0;
-	result.albedo = vec3(0.0);
-	result.normal = vec3(0.0, 1.0, 0.0);
+	S_SurfacePayload result;
+	result.position = vec3(0.0);
+	result.hitT = -1.0;
+	result.normal = 0;
+	result.albedo = 0;
+	result.coneWidth = 0.0;
+	result.coneSpread = 0.0;
 	return result;
 }
 
+bool IsHit(in S_SurfacePayload payload)
+{
+	return payload.hitT >= 0.0;
+}
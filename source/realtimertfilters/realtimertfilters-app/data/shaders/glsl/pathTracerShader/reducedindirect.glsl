@@ -0,0 +1,37 @@
+/// Layout of the reduced resolution indirect light image, shared by the path tracer and the upsampling pass
+/// Requires the INDIRECT_MODE_XXX defines of ubo_definitions.glsl
+/// Checkerboard: every other pixel of a row is traced, the image is half as wide as the screen
+/// Half: one pixel of every 2x2 block is traced, only the upper left quarter of the image is used
+/// The alpha channel keeps the position of the traced pixel inside its group, so the upsampling does not depend on the frame index
+
+// Reduced texel the indirect light of a full resolution pixel is stored in
+ivec2 reducedIndirectTexel(in ivec2 pixel, in uint mode)
+{
+	return mode == INDIRECT_MODE_HALF ? pixel >> 1 : ivec2(pixel.x >> 1, pixel.y);
+}
+
+// Whether the pixel traces indirect light this frame, the offset inside its group goes to alpha
+bool isReducedIndirectPixel(in ivec2 pixel, in uint mode, in uint frame, out float offset)
+{
+	if (mode == INDIRECT_MODE_HALF)
+	{
+		// Rotate through all four pixels of the block
+		const ivec2 offsets[4] = ivec2[](ivec2(0, 0), ivec2(1, 1), ivec2(1, 0), ivec2(0, 1));
+		ivec2 subpixel = pixel & 1;
+		offset = float(subpixel.x + 2 * subpixel.y);
+		return subpixel == offsets[frame % 4];
+	}
+	offset = float(pixel.x & 1);
+	return ((pixel.x + pixel.y + int(frame)) & 1) == 0;
+}
+
+// Full resolution pixel a reduced texel was traced at
+ivec2 reducedIndirectPixel(in ivec2 reducedTexel, in uint mode, in float offset)
+{
+	int subpixel = int(offset + 0.5);
+	if (mode == INDIRECT_MODE_HALF)
+	{
+		return reducedTexel * 2 + ivec2(subpixel & 1, subpixel >> 1);
+	}
+	return ivec2(reducedTexel.x * 2 + subpixel, reducedTexel.y);
+}
@@ -0,0 +1,127 @@
+/// Sample generators of the path tracer, selected with SPC_PathtracerConfig::SamplerType
+/// Requires sampling.glsl, the path tracer push constant and the blue noise texture array (blueNoise)
+///
+/// Every call of sample2D draws the next dimension of the current sample of the pixel. As long as the path
+/// consumes dimensions in the same order, sample n of dimension d is stratified against the other samples of d:
+/// over the samples of a pixel (Sobol), or over neighbouring pixels (blue noise)
+
+struct S_Sampler
+{
+	uvec2 pixel;
+	uint sampleIndex;	// Index of the sample in the sequence of the pixel, counted over all frames
+	uint dimension;		// Next dimension to draw
+	uint seed;			// Per pixel hash, scrambles the Sobol sequence. State of the LCG for the random sampler
+};
+
+S_Sampler initSampler(in uvec2 pixel, in uvec2 size, in uint sampleIndex)
+{
+	S_Sampler s;
+	s.pixel = pixel;
+	s.sampleIndex = sampleIndex;
+	s.dimension = 0;
+	// Only the random sampler reseeds per sample, the others need the same scramble over the whole sequence
+	s.seed = tea(pixel.y * size.x + pixel.x, config.SamplerType == SAMPLER_TYPE_RANDOM ? sampleIndex : 0u);
+	return s;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Owen scrambled Sobol, see Burley, "Practical Hash-based Owen Scrambling", JCGT 2020
+//-------------------------------------------------------------------------------------------------
+
+uint hashUint(uint x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+uint laineKarrasPermutation(uint x, uint seed)
+{
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return x;
+}
+
+// Owen scrambling of a fixed point value in [0, 1) with 32 bits
+uint nestedUniformScramble(uint x, uint seed)
+{
+	x = bitfieldReverse(x);
+	x = laineKarrasPermutation(x, seed);
+	return bitfieldReverse(x);
+}
+
+// Second dimension of the Sobol sequence, the first one is bitfieldReverse(index)
+uint sobolSecondDimension(uint index)
+{
+	uint result = 0u;
+	for (uint v = 1u << 31; index != 0u; index >>= 1, v ^= v >> 1)
+	{
+		if ((index & 1u) != 0u)
+		{
+			result ^= v;
+		}
+	}
+	return result;
+}
+
+/*
+	Padded 2D Sobol: every pair of dimensions is an independently shuffled and scrambled (0, 2)-sequence,
+	which keeps the 2D stratification of light and BSDF samples without direction numbers for higher dimensions
+*/
+vec2 sobol2D(in uint sampleIndex, in uint seed)
+{
+	uint index = nestedUniformScramble(sampleIndex, hashUint(seed));
+	uint x = nestedUniformScramble(bitfieldReverse(index), hashUint(seed ^ 0xa511e9b3u));
+	uint y = nestedUniformScramble(sobolSecondDimension(index), hashUint(seed ^ 0x63d83595u));
+	// 24 bits are exactly representable as float, keeping the result below 1
+	return vec2(x >> 8, y >> 8) / 16777216.0;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Blue noise
+//-------------------------------------------------------------------------------------------------
+
+// R2 sequence (Roberts 2018), low discrepancy offsets for dimensions and frames
+const vec2 R2_ALPHA = vec2(0.7548776662, 0.5698402910);
+
+/*
+	Each dimension reads a different layer at a shifted tile position. Over time the tile is offset along the
+	R2 sequence, so every pixel still sees a low discrepancy sequence while neighbours stay blue noise distributed
+*/
+vec2 blueNoise2D(in uvec2 pixel, in uint sampleIndex, in uint dimension)
+{
+	ivec3 size = textureSize(blueNoise, 0);
+	ivec2 tileOffset = ivec2(fract(R2_ALPHA * float(dimension + 1)) * vec2(size.xy));
+	int layer = int((dimension + sampleIndex / uint(size.z)) % uint(size.z));
+	vec2 noise = texelFetch(blueNoise, ivec3((ivec2(pixel) + tileOffset) % size.xy, layer), 0).rg;
+	// Centre the quantized thresholds of the 8 bit texture
+	noise += 0.5 / 256.0;
+	return fract(noise + R2_ALPHA * float(sampleIndex));
+}
+
+//-------------------------------------------------------------------------------------------------
+
+vec2 sample2D(inout S_Sampler s)
+{
+	vec2 u;
+	if (config.SamplerType == SAMPLER_TYPE_SOBOL)
+	{
+		u = sobol2D(s.sampleIndex, s.seed + s.dimension * 0x9e3779b9u);
+	}
+	else if (config.SamplerType == SAMPLER_TYPE_BLUENOISE)
+	{
+		u = blueNoise2D(s.pixel, s.sampleIndex, s.dimension);
+	}
+	else
+	{
+		u = vec2(rnd(s.seed), rnd(s.seed));
+	}
+	s.dimension++;
+	return u;
+}
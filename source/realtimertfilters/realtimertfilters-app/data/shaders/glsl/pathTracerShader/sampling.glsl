@@ -40,13 +40,13 @@ float rnd(inout uint prev)
 // Sampling
 //-------------------------------------------------------------------------------------------------
 
-// Randomly sampling around +Z
-vec3 sampleLambert(inout uint seed, in mat3 reflectionTBN)
+// Cosine weighted direction around +Z from two uniform numbers u
+vec3 sampleLambert(in vec2 u, in mat3 reflectionTBN)
 {
 #define M_PI 3.141592
 
-	float r1 = rnd(seed);
-	float r2 = rnd(seed);
+	float r1 = u.x;
+	float r2 = u.y;
 
 	float cosTheta = sqrt(1 - r1);
 	float sinTheta = sqrt(1 - cosTheta * cosTheta);
@@ -58,6 +58,12 @@ vec3 sampleLambert(inout uint seed, in mat3 reflectionTBN)
 	return direction;
 }
 
+// Randomly sampling around +Z
+vec3 sampleLambert(inout uint seed, in mat3 reflectionTBN)
+{
+	return sampleLambert(vec2(rnd(seed), rnd(seed)), reflectionTBN);
+}
+
 vec3 samplePhong(inout uint seed, in mat3 reflectionTBN, float shininess)
 {
 #define M_PI 3.141592
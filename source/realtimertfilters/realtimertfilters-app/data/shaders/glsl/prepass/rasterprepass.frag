@@ -1,8 +1,12 @@
 #version 450
 #extension GL_KHR_vulkan_glsl: enable
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout (set=1, binding = 0) uniform sampler2D samplerColor;
-layout (set=1, binding = 1) uniform sampler2D samplerNormalMap;
+#include "../pathTracerShader/gltf.glsl"
+
+// Same material buffer and texture array as the path tracer, the material comes with the vertices
+layout (set = 1, binding = 0) readonly buffer _MaterialBuffer { GltfShadeMaterial m[]; } materials;
+layout (set = 1, binding = 1) uniform sampler2D textureMap[];
 
 layout (location = 0) in vec3 inWorldPos;			// Vertex position in world space
 layout (location = 1) in vec4 inDevicePos;			// Vertex position in normalized device space (current frame)
@@ -12,6 +16,7 @@ layout (location = 4) in vec3 inTangent;			// Tangent in world space
 layout (location = 5) in vec2 inUV;				// UV coordinates
 layout (location = 6) in vec3 inColor;				// Passthrough for vertex color
 layout (location = 7) flat in int inMeshId;			// Mesh id
+layout (location = 8) flat in int inMaterialId;		// Material index, -1 for the default material
 
 layout (location = 0) out vec4 outPosition;			// Fragment position in world spcae
 layout (location = 1) out vec4 outNormal;			// Fragment normal in world space
@@ -19,12 +24,31 @@ layout (location = 2) out vec4 outAlbedo;			// Fragment raw albedo
 layout (location = 3) out vec2 outMotion;			// Fragment screenspace motion delta
 layout (location = 4) out int outMeshId;			// Fragment mesh id
 
+// A missing texture reads as black, the same as the empty texture of the glTF loader
+vec4 sampleMaterialTexture(int textureId, vec2 uv)
+{
+	if (textureId < 0)
+	{
+		return vec4(0.0);
+	}
+	// Draws of several materials can share a subgroup
+	return texture(textureMap[nonuniformEXT(textureId)], uv);
+}
+
 void main() 
 {
 	outPosition = vec4(inWorldPos, 1.0);
 
+	int baseColorTextureId = -1;
+	int normalTextureId = -1;
+	if (inMaterialId >= 0)
+	{
+		baseColorTextureId = int(materials.m[inMaterialId].baseColorTextureId.x);
+		normalTextureId = int(materials.m[inMaterialId].normalTextureId.x);
+	}
+
 	// Calculate normal in tangent space
-	vec3 texNormal = texture(samplerNormalMap, inUV).xyz;
+	vec3 texNormal = sampleMaterialTexture(normalTextureId, inUV).xyz;
 	if (texNormal == vec3(0.0))
 	{
 		outNormal = vec4(normalize(inNormal), 0.0);
@@ -40,7 +64,7 @@ void main()
 	}
 
 	// Get albedo. If texture yields full black (probably hasn't been set) and the 
-	vec4 textureColor = texture(samplerColor, inUV);
+	vec4 textureColor = sampleMaterialTexture(baseColorTextureId, inUV);
 	if (textureColor.xyz == vec3(0.f) && inColor != vec3(0.f))
 	{
 		textureColor = vec4(inColor, 1.f);
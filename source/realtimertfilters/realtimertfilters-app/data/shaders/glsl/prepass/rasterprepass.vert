@@ -6,10 +6,20 @@ layout (location = 2) in vec3 inColor;				// Per vertex color
 layout (location = 3) in vec3 inNormal;				// Vertex normal
 layout (location = 4) in vec3 inTangent;			// Vertex tangent
 layout (location = 5) in int inMeshId;				// Mesh Id
+layout (location = 6) in int inMaterialId;			// Material index, -1 for the default material
 
 #define BIND_SCENEINFO 0
 #include "../ubo_definitions.glsl"
 
+// Draws pass their primitive as first instance, they are never instanced
+layout (set = 0, binding = 1) readonly buffer _Primitives { S_CullPrimitive p[]; } primitives;
+layout (set = 0, binding = 2) readonly buffer _Instances { S_NodeInstance i[]; } instances;
+
+// Vertices are read as vec4 array, matching the 112 byte vkglTF::Vertex layout, [0] holds pos.xyz
+#define VERTEX_STRIDE 7
+// Skinned vertices of the previous frame, the scene vertices elsewhere
+layout (set = 0, binding = 3) readonly buffer _PreviousVertices { vec4 v[]; } previousVertices;
+
 layout (location = 0) out vec3 outWorldPos;			// Vertex position in world space
 layout (location = 1) out vec4 outDevicePos;		// Vertex position in normalized device space (current frame)
 layout (location = 2) out vec4 outOldDevicePos;		// Vertex position in normalized device space (previous frame)
@@ -18,26 +28,25 @@ layout (location = 4) out vec3 outTangent;			// Tangent in world space
 layout (location = 5) out vec2 outUV;				// UV coordinates
 layout (location = 6) out vec3 outColor;			// Passthrough for vertex color
 layout (location = 7) flat out int outMeshId;			// Mesh Id
+layout (location = 8) flat out int outMaterialId;		// Material index
 
-//const mat4 MODELMATRIX = mat4(1.0f);
-//const mat4 PREVMODELMATRIX = MODELMATRIX;
-//
 void main() 
 {
+	S_NodeInstance instance = instances.i[primitives.p[gl_InstanceIndex].NodeIndex];
+
 	// Get transformations out of the way
-	outWorldPos = inPos.xyz;
-	outDevicePos = ubo_sceneinfo.ProjMat * ubo_sceneinfo.ViewMat * inPos;
+	vec4 worldPos = instance.Model * inPos;
+	outWorldPos = worldPos.xyz;
+	outDevicePos = ubo_sceneinfo.ProjMat * ubo_sceneinfo.ViewMat * worldPos;
 	gl_Position = outDevicePos;
-	outOldDevicePos = ubo_sceneinfo.ProjMatPrev * ubo_sceneinfo.ViewMatPrev * inPos;
-//	outWorldPos = (MODELMATRIX * inPos).xyz;
-//	gl_Position = ubo_sceneinfo.ProjMat * ubo_sceneinfo.ViewMat * MODELMATRIX * inPos;
-//	outDevicePos = gl_Position;
-//	outOldDevicePos = ubo_sceneinfo.ProjMatPrev * ubo_sceneinfo.ViewMatPrev * PREVMODELMATRIX * inPos;
+	// Draws have no vertex offset, so the vertex index addresses the scene vertex buffer
+	vec4 oldPos = vec4(previousVertices.v[gl_VertexIndex * VERTEX_STRIDE].xyz, 1.0);
+	outOldDevicePos = ubo_sceneinfo.ProjMatPrev * ubo_sceneinfo.ViewMatPrev * instance.ModelPrev * oldPos;
 
 	outUV = inUV;
 
 	// Normal in world space
-	mat3 mNormal = transpose(inverse(mat3(1.0)));
+	mat3 mNormal = transpose(inverse(mat3(instance.Model)));
 	outNormal = mNormal * normalize(inNormal);	
 	outTangent = mNormal * normalize(inTangent);
 	
@@ -45,4 +54,5 @@ void main()
 	outColor = inColor;
 
 	outMeshId = inMeshId;
+	outMaterialId = inMaterialId;
 }
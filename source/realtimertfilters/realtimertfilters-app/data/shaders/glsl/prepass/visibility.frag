@@ -0,0 +1,10 @@
+#version 450
+
+layout (location = 0) flat in uint inFirstTriangle;	// Index of the draw's first triangle in the scene index buffer
+
+layout (location = 0) out uint outVisibility;		// Triangle id + 1, 0 is left for pixels without geometry
+
+void main() 
+{
+	outVisibility = inFirstTriangle + uint(gl_PrimitiveID) + 1;
+}
@@ -0,0 +1,19 @@
+#version 450
+
+layout (location = 0) in vec4 inPos;				// Vertex position before the node instance transform
+
+#define BIND_SCENEINFO 0
+#include "../ubo_definitions.glsl"
+
+// Draws pass their primitive as first instance, they are never instanced
+layout (set = 0, binding = 1) readonly buffer _Primitives { S_CullPrimitive p[]; } primitives;
+layout (set = 0, binding = 2) readonly buffer _Instances { S_NodeInstance i[]; } instances;
+
+layout (location = 0) flat out uint outFirstTriangle;	// Index of the draw's first triangle in the scene index buffer
+
+void main() 
+{
+	S_CullPrimitive primitive = primitives.p[gl_InstanceIndex];
+	gl_Position = ubo_sceneinfo.ProjMat * ubo_sceneinfo.ViewMat * instances.i[primitive.NodeIndex].Model * inPos;
+	outFirstTriangle = primitive.FirstIndex / 3;
+}
@@ -0,0 +1,12 @@
+/// This File defines DescriptorSet bindings for the ReSTIR DI shaders
+
+#define B_RESTIR_ACCELERATIONSTRUCTURE 0
+#define B_RESTIR_LIGHTS 1
+#define B_RESTIR_POSITION 2
+#define B_RESTIR_NORMAL 3
+#define B_RESTIR_MOTION 4
+#define B_RESTIR_RESERVOIRS 5
+#define B_RESTIR_TEMPORALRESERVOIRS 6
+#define B_RESTIR_DIRECT 7
+#define B_RESTIR_ALBEDO 8
+#define B_RESTIR_OUTPUT 9
@@ -0,0 +1,106 @@
+/// Resources and reservoir operations shared by the ReSTIR DI passes
+/// Requires binding.glsl, sampling.glsl, hitvertex.glsl, lightsampling.glsl, the light SSBO and the ReSTIR push constant
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = B_RESTIR_ACCELERATIONSTRUCTURE) uniform accelerationStructureEXT topLevelAS;
+layout(binding = B_RESTIR_POSITION, rgba16f) uniform readonly image2D imagePosition;
+layout(binding = B_RESTIR_NORMAL, rgba16f) uniform readonly image2D imageNormal;
+layout(binding = B_RESTIR_MOTION, rg32f) uniform readonly image2D imageMotion;
+// Final reservoirs, read by the temporal pass of the next frame
+layout(binding = B_RESTIR_RESERVOIRS) buffer _Reservoirs { S_Reservoir r[]; } reservoirs;
+// Reservoirs after initial sampling and temporal reuse, input of the spatial pass
+layout(binding = B_RESTIR_TEMPORALRESERVOIRS) buffer _TemporalReservoirs { S_Reservoir r[]; } temporalReservoirs;
+layout(binding = B_RESTIR_DIRECT, rgba16f) uniform writeonly image2D imageDirect;
+layout(binding = B_RESTIR_ALBEDO, rgba16f) uniform readonly image2D imageAlbedo;
+// Combined path tracer output, lacks the primary direct light until the spatial pass adds it
+layout(binding = B_RESTIR_OUTPUT, rgba16f) uniform image2D imageOutput;
+
+const float BIAS = 0.001;
+
+S_Reservoir emptyReservoir(in vec3 position, in vec3 normal)
+{
+	S_Reservoir reservoir;
+	reservoir.LightIndex = 0;
+	reservoir.WeightSum = 0.0;
+	reservoir.M = 0.0;
+	reservoir.W = 0.0;
+	reservoir.LightUV = vec2(0);
+	reservoir.Normal = octEncode(normal);
+	reservoir._RESERVED = 0;
+	reservoir.Position = position;
+	reservoir._RESERVED2 = 0;
+	return reservoir;
+}
+
+/*
+	Unshadowed contribution of a light sample at a surface, its luminance is the target function of the resampling
+*/
+vec3 evaluateSample(in uint lightIndex, in vec2 lightUV, in vec3 position, in vec3 normal, out vec3 lightDir, out float lightDistance)
+{
+	vec3 Li = evaluateLight(ssbo_lights.Lights[lightIndex], lightUV, position, lightDir, lightDistance);
+	return Li * max(dot(normal, lightDir), 0.0);
+}
+
+float targetFunction(in uint lightIndex, in vec2 lightUV, in vec3 position, in vec3 normal)
+{
+	vec3 lightDir;
+	float lightDistance;
+	return dot(evaluateSample(lightIndex, lightUV, position, normal, lightDir, lightDistance), vec3(0.2126, 0.7152, 0.0722));
+}
+
+/*
+	Weighted reservoir sampling: stream one candidate into the reservoir
+*/
+bool updateReservoir(inout S_Reservoir reservoir, in uint lightIndex, in vec2 lightUV, in float weight, in float M, inout uint seed)
+{
+	reservoir.WeightSum += weight;
+	reservoir.M += M;
+	if (weight > 0.0 && rnd(seed) * reservoir.WeightSum <= weight)
+	{
+		reservoir.LightIndex = lightIndex;
+		reservoir.LightUV = lightUV;
+		return true;
+	}
+	return false;
+}
+
+/*
+	Merge another reservoir by treating its sample as one candidate weighted by the target function at this pixel
+*/
+void mergeReservoir(inout S_Reservoir reservoir, in S_Reservoir other, in vec3 position, in vec3 normal, inout uint seed)
+{
+	float pHat = targetFunction(other.LightIndex, other.LightUV, position, normal);
+	updateReservoir(reservoir, other.LightIndex, other.LightUV, pHat * other.W * other.M, other.M, seed);
+}
+
+void finalizeReservoir(inout S_Reservoir reservoir, in vec3 position, in vec3 normal)
+{
+	float pHat = targetFunction(reservoir.LightIndex, reservoir.LightUV, position, normal);
+	reservoir.W = (pHat > 0.0 && reservoir.M > 0.0) ? reservoir.WeightSum / (reservoir.M * pHat) : 0.0;
+}
+
+bool traceShadow(in vec3 origin, in vec3 direction, in float tmin, in float tmax)
+{
+	rayQueryEXT rayQuery;
+	rayQueryInitializeEXT(rayQuery, topLevelAS, gl_RayFlagsTerminateOnFirstHitEXT | gl_RayFlagsOpaqueEXT, 0xFF, origin, tmin, direction, tmax);
+	while (rayQueryProceedEXT(rayQuery))
+	{
+	}
+	return rayQueryGetIntersectionTypeEXT(rayQuery, true) != gl_RayQueryCommittedIntersectionNoneEXT;
+}
+
+bool isVisible(in uint lightIndex, in vec2 lightUV, in vec3 position, in vec3 normal)
+{
+	vec3 lightDir;
+	float lightDistance;
+	evaluateLight(ssbo_lights.Lights[lightIndex], lightUV, position, lightDir, lightDistance);
+	return !traceShadow(position + normal * BIAS, lightDir, BIAS, lightDistance - BIAS);
+}
+
+// Surfaces only share samples if they lie in a similar plane
+bool isSimilarSurface(in vec3 position, in vec3 normal, in vec3 otherPosition, in vec3 otherNormal)
+{
+	float planeDistance = abs(dot(otherPosition - position, normal));
+	return dot(normal, otherNormal) > 0.9 && planeDistance < 0.05 * max(distance(position, otherPosition), 1.0);
+}
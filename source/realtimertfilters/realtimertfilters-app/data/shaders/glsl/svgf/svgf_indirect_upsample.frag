@@ -0,0 +1,92 @@
+#version 420
+
+// Reconstructs full resolution indirect light from the checkerboard or half resolution path tracer output.
+// Traced pixels are kept as they are, the others take a joint bilateral weighted average of the nearby traced pixels
+
+// GBUFFER INPUTS
+layout (set = 0, binding = 0) uniform sampler2D Tex_Position;			// GBuffer Worldspace Positions
+layout (set = 0, binding = 1) uniform sampler2D Tex_Normal;				// GBuffer Worldspace Normals
+
+// PATHTRACER INPUTS
+layout (set = 0, binding = 2) uniform sampler2D Tex_IndirectReduced;	// Reduced indirect light, alpha holds the traced pixel's offset
+
+// OUTPUT
+layout (location = 0) out vec4 Out_Indirect;							// Full resolution indirect light
+
+#include "../filter/filtercommon.glsl"
+
+#define BIND_REDUCEDINDIRECTCONFIG 0
+#define SET_REDUCEDINDIRECTCONFIG 1
+#include "../ubo_definitions.glsl"
+#include "../pathTracerShader/reducedindirect.glsl"
+
+void main()
+{
+	vec4 position = texelFetch(Tex_Position, Texel, 0);
+	if (position.w == 0)
+	{
+		Out_Indirect = vec4(0, 0, 0, 1);
+		return;
+	}
+	vec3 normal = texelFetch(Tex_Normal, Texel, 0).xyz;
+
+	const uint mode = uint(ubo_reducedindirectconfig.IndirectMode);
+	const ivec2 center = reducedIndirectTexel(Texel, mode);
+	const ivec2 reducedSize = mode == INDIRECT_MODE_HALF ? (iSCRDIM + 1) >> 1 : ivec2((iSCRDIM.x + 1) >> 1, iSCRDIM.y);
+
+	vec3 sum = vec3(0);
+	float weightSum = 0;
+	vec3 fallbackSum = vec3(0);
+	float fallbackCount = 0;
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+		{
+			ivec2 reducedTexel = center + ivec2(x, y);
+			if (any(lessThan(reducedTexel, ivec2(0))) || any(greaterThanEqual(reducedTexel, reducedSize)))
+			{
+				continue;
+			}
+
+			vec4 indirect = texelFetch(Tex_IndirectReduced, reducedTexel, 0);
+			ivec2 pixel = reducedIndirectPixel(reducedTexel, mode, indirect.a);
+			if (pixel == Texel)
+			{
+				Out_Indirect = vec4(indirect.rgb, 1);
+				return;
+			}
+			if (any(greaterThanEqual(pixel, iSCRDIM)))
+			{
+				continue;
+			}
+
+			vec4 samplePosition = texelFetch(Tex_Position, pixel, 0);
+			if (samplePosition.w == 0)
+			{
+				continue;
+			}
+			vec3 sampleNormal = texelFetch(Tex_Normal, pixel, 0).xyz;
+
+			vec2 pixelOffset = vec2(pixel - Texel);
+			vec3 positionOffset = samplePosition.xyz - position.xyz;
+			float weight = exp(-0.5 * dot(pixelOffset, pixelOffset))
+				* pow(max(dot(normal, sampleNormal), 0), ubo_reducedindirectconfig.NormalPower)
+				* exp(-dot(positionOffset, positionOffset) / ubo_reducedindirectconfig.PositionPhi);
+
+			sum += weight * indirect.rgb;
+			weightSum += weight;
+			fallbackSum += indirect.rgb;
+			fallbackCount += 1;
+		}
+	}
+
+	// No neighbour on the same surface, a plain average beats leaving a hole
+	if (weightSum > 1e-4)
+	{
+		Out_Indirect = vec4(sum / weightSum, 1);
+	}
+	else
+	{
+		Out_Indirect = vec4(fallbackCount > 0 ? fallbackSum / fallbackCount : vec3(0), 1);
+	}
+}
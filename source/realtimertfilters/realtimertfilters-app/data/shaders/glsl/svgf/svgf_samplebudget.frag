@@ -0,0 +1,39 @@
+#version 420
+
+// Turns the variance and history length of the SVGF accumulation into the per pixel sample count of the next frame
+
+// ACCUMULATION OUTPUTS
+layout (set = 0, binding = 0) uniform sampler2D Tex_NewMoments;			// Accumulated luminance moments, direct rg, indirect ba
+layout (set = 0, binding = 1) uniform isampler2D Tex_NewHistoryLength;	// Per pixel accumulated data age
+
+// OUTPUT
+layout (location = 0) out int Out_SampleBudget;							// Samples per pixel of the next frame
+
+#include "../filter/filtercommon.glsl"
+
+#define BIND_ADAPTIVESAMPLINGCONFIG 0
+#define SET_ADAPTIVESAMPLINGCONFIG 1
+#include "../ubo_definitions.glsl"
+
+void main()
+{
+	int historyLength = texelFetch(Tex_NewHistoryLength, Texel, 0).x;
+
+	// Disoccluded pixels have nothing to average with yet
+	if (historyLength <= 1)
+	{
+		Out_SampleBudget = ubo_adaptivesamplingconfig.MaxSamples;
+		return;
+	}
+
+	vec4 moments = texelFetch(Tex_NewMoments, Texel, 0);
+	vec2 mean = moments.rb;
+	vec2 variance = max(vec2(0), moments.ga - mean * mean);
+
+	// Relative standard error of the accumulated estimate. It falls with the square root of the sample count,
+	// so reaching the target takes (error / target)^2 times the samples of one frame
+	float relativeError = sqrt((variance.x + variance.y) / float(historyLength)) / (mean.x + mean.y + 0.001);
+	float ratio = relativeError / ubo_adaptivesamplingconfig.TargetError;
+
+	Out_SampleBudget = clamp(int(ceil(ratio * ratio)), ubo_adaptivesamplingconfig.MinSamples, ubo_adaptivesamplingconfig.MaxSamples);
+}
@@ -32,6 +32,69 @@ struct S_Light
 #endif
 
 
+/// LIGHT SSBO
+/// Size: 20 * 4 = 80 Byte per light
+/// Lights sampled by the path tracer: the enabled lights of the scene info UBO followed by the emissive triangles of the scene
+/// Position = Position in World Space (Point), direction (Directional) or first vertex (Triangle)
+/// Type = LIGHT_TYPE_POINT, LIGHT_TYPE_DIRECTIONAL or LIGHT_TYPE_TRIANGLE
+/// Color, RadiantFlux = See S_Light, for triangles Color * RadiantFlux is the emitted radiance
+/// Edge1, Edge2 = Triangle edges from Position to the second and third vertex
+/// SelectionPdf = Probability of choosing this light, proportional to its power
+/// AliasProbability, Alias = Alias table entry: keep this light with AliasProbability, otherwise choose Alias
+
+#define LIGHT_TYPE_POINT 1.0
+#define LIGHT_TYPE_DIRECTIONAL 2.0
+#define LIGHT_TYPE_TRIANGLE 3.0
+
+#ifdef __cplusplus
+
+struct S_SceneLight
+{
+	glm::vec3	Position;
+	float		Type;
+	glm::vec3	Color;
+	float		RadiantFlux;
+	glm::vec3	Edge1;
+	float		SelectionPdf;
+	glm::vec3	Edge2;
+	float		AliasProbability;
+	uint		Alias;
+	uint		_RESERVED;
+	uint		_RESERVED2;
+	uint		_RESERVED3;
+
+	S_SceneLight() : Position(), Type(LIGHT_TYPE_POINT), Color(), RadiantFlux(), Edge1(), SelectionPdf(), Edge2(), AliasProbability(1.f), Alias(0), _RESERVED(), _RESERVED2(), _RESERVED3() {}
+};
+
+#else
+struct S_SceneLight
+{
+	vec3		Position;
+	float		Type;
+	vec3		Color;
+	float		RadiantFlux;
+	vec3		Edge1;
+	float		SelectionPdf;
+	vec3		Edge2;
+	float		AliasProbability;
+	uint		Alias;
+	uint		_RESERVED;
+	uint		_RESERVED2;
+	uint		_RESERVED3;
+};
+#endif
+
+#ifdef BIND_LIGHTS
+#ifndef SET_LIGHTS
+#define SET_LIGHTS 0
+#endif
+layout(set = SET_LIGHTS, binding = BIND_LIGHTS) readonly buffer S_LightBuffer
+{
+	S_SceneLight Lights[];
+} ssbo_lights;
+#endif
+
+
 /// SCENEINFO UBO
 #define UBO_SCENEINFO_LIGHT_COUNT 3
 // Size: 32 * UBO_SCENEINFO_LIGHT_COUNT + 100 * 4
@@ -83,7 +146,22 @@ layout(set = SET_SCENEINFO, binding = BIND_SCENEINFO) uniform S_Sceneinfo
 #endif
 
 /// Pathtracer Config PushConstant
-/// Size: 9 * 4 = 36 Byte (Alignment is not important for push constants)
+/// Size: 16 * 4 = 64 Byte (Alignment is not important for push constants)
+/// LightCount = number of lights in the light SSBO
+/// SamplerType = generator of the path's random numbers, one of SAMPLER_TYPE_XXX
+/// AdaptiveSampling = if 1, the per pixel sample count is read from the sample budget image instead of PrimarySamplesPerPixel
+/// IndirectMode = resolution indirect light is traced at, one of INDIRECT_MODE_XXX
+/// HybridPrimary = if 1, paths start at the rasterized G-buffer surface instead of tracing primary rays
+/// RenderWidth, RenderHeight = dynamic resolution sub-rectangle of the attachments that is traced
+/// RestirDirect = if 1, ReSTIR DI computes the direct light of the primary hit, the path tracer only samples it at bounces
+
+#define SAMPLER_TYPE_RANDOM 0
+#define SAMPLER_TYPE_SOBOL 1
+#define SAMPLER_TYPE_BLUENOISE 2
+
+#define INDIRECT_MODE_FULL 0
+#define INDIRECT_MODE_CHECKERBOARD 1
+#define INDIRECT_MODE_HALF 2
 
 #ifdef __cplusplus
 
@@ -94,9 +172,16 @@ struct SPC_PathtracerConfig
 	uint		PrimarySamplesPerPixel;
 	uint		MaxBounceDepth;
 	uint		SecondarySamplesPerBounce;
-	uint		VertexSize;
-
-	SPC_PathtracerConfig() : ClearColor(), Frame(), PrimarySamplesPerPixel(1), MaxBounceDepth(3), SecondarySamplesPerBounce(1), VertexSize(0) {}
+	uint		LightCount;
+	uint		SamplerType;
+	uint		AdaptiveSampling;
+	uint		IndirectMode;
+	uint		HybridPrimary;
+	uint		RenderWidth;
+	uint		RenderHeight;
+	uint		RestirDirect;
+
+	SPC_PathtracerConfig() : ClearColor(), Frame(), PrimarySamplesPerPixel(1), MaxBounceDepth(3), SecondarySamplesPerBounce(1), LightCount(0), SamplerType(SAMPLER_TYPE_BLUENOISE), AdaptiveSampling(0), IndirectMode(INDIRECT_MODE_FULL), HybridPrimary(0), RenderWidth(0), RenderHeight(0), RestirDirect(0) {}
 };
 
 #endif
@@ -108,14 +193,293 @@ layout (push_constant) uniform SPC_PathtracerConfig
 	uint		PrimarySamplesPerPixel;
 	uint		MaxBounceDepth;
 	uint		SecondarySamplesPerBounce;
-	uint		VertexSize;
+	uint		LightCount;
+	uint		SamplerType;
+	uint		AdaptiveSampling;
+	uint		IndirectMode;
+	uint		HybridPrimary;
+	uint		RenderWidth;
+	uint		RenderHeight;
+	uint		RestirDirect;
 } config;
 #endif
 
-/// GUI BASE UBO
+/// ReSTIR Config PushConstant
+/// Size: 10 * 4 = 40 Byte
+/// Frame = frame index, seeds the random numbers
+/// LightCount = number of lights in the light SSBO
+/// InitialCandidates = number of lights resampled into the initial reservoir of a pixel
+/// SpatialNeighbours = number of neighbouring reservoirs merged in the spatial pass
+/// SpatialRadius = radius in pixels the spatial neighbours are picked from
+/// MaxHistory = the sample count M of the previous frame's reservoir is clamped to MaxHistory * InitialCandidates
+/// EnableTemporal, EnableSpatial = toggle temporal and spatial reuse
+/// RenderWidth, RenderHeight = dynamic resolution sub-rectangle of the attachments, also the row length of the reservoir buffers (cleared when it changes)
+
+#ifdef __cplusplus
+
+struct SPC_RestirConfig
+{
+	uint		Frame;
+	uint		LightCount;
+	uint		InitialCandidates;
+	uint		SpatialNeighbours;
+	float		SpatialRadius;
+	uint		MaxHistory;
+	uint		EnableTemporal;
+	uint		EnableSpatial;
+	uint		RenderWidth;
+	uint		RenderHeight;
+
+	SPC_RestirConfig() : Frame(0), LightCount(0), InitialCandidates(8), SpatialNeighbours(3), SpatialRadius(20.f), MaxHistory(20), EnableTemporal(1), EnableSpatial(1), RenderWidth(0), RenderHeight(0) {}
+};
+
+#endif
+#ifdef PUSHC_RESTIRCONFIG
+layout (push_constant) uniform SPC_RestirConfig
+{
+	uint		Frame;
+	uint		LightCount;
+	uint		InitialCandidates;
+	uint		SpatialNeighbours;
+	float		SpatialRadius;
+	uint		MaxHistory;
+	uint		EnableTemporal;
+	uint		EnableSpatial;
+	uint		RenderWidth;
+	uint		RenderHeight;
+} restir;
+#endif
+
+/// ReSTIR Reservoir SSBO entry
+/// Size: 12 * 4 = 48 Byte per pixel
+/// LightIndex, LightUV = selected light sample (index into the light SSBO, point on triangle lights)
+/// WeightSum = sum of the resampling weights of all candidates seen
+/// M = number of candidates seen
+/// W = unbiased contribution weight of the selected sample
+/// Normal = octahedral encoded normal of the pixel the reservoir was built for
+/// Position = world position of the pixel the reservoir was built for
+
+#ifdef __cplusplus
+
+struct S_Reservoir
+{
+	uint		LightIndex;
+	float		WeightSum;
+	float		M;
+	float		W;
+	glm::vec2	LightUV;
+	uint		Normal;
+	uint		_RESERVED;
+	glm::vec3	Position;
+	uint		_RESERVED2;
+};
+
+#else
+struct S_Reservoir
+{
+	uint		LightIndex;
+	float		WeightSum;
+	float		M;
+	float		W;
+	vec2		LightUV;
+	uint		Normal;
+	uint		_RESERVED;
+	vec3		Position;
+	uint		_RESERVED2;
+};
+#endif
+
+/// Skinning Config PushConstant
+/// Size: 3 * 4 = 12 Byte
+/// FirstVertex = first vertex of the skinned primitive in the scene vertex buffer
+/// VertexCount = number of vertices of the skinned primitive
+/// JointOffset = index of the first joint matrix of the primitive's skin in the joint matrix buffer
+
+#ifdef __cplusplus
+
+struct SPC_SkinningConfig
+{
+	uint		FirstVertex;
+	uint		VertexCount;
+	uint		JointOffset;
+
+	SPC_SkinningConfig() : FirstVertex(0), VertexCount(0), JointOffset(0) {}
+};
+
+#endif
+#ifdef PUSHC_SKINNINGCONFIG
+layout (push_constant) uniform SPC_SkinningConfig
+{
+	uint		FirstVertex;
+	uint		VertexCount;
+	uint		JointOffset;
+} skinning;
+#endif
+
+/// CULL CONFIG UBO
+/// Size: 12 * 16 = 192 byte
+/// FrustumPlanes = normalized planes of the current view frustum in world space, see vks::Frustum
+/// ViewProjPrev = view projection matrix of the previous frame, which the Hi-Z pyramid was built from
+/// PrimitiveCount = number of entries in the cull primitive SSBO
+/// EnableFrustum = if 0, primitives outside the view frustum are drawn as well
+/// EnableOcclusion = if 1, primitives behind the previous frame's depth are culled
+/// HiZLevelCount = number of mip levels of the Hi-Z pyramid
+/// RenderWidth, RenderHeight = render size of the previous frame, the pyramid covers this part of the depth attachment
+
+#ifdef __cplusplus
+
+struct S_CullConfig
+{
+	glm::vec4	FrustumPlanes[6];
+	glm::mat4	ViewProjPrev;
+	uint		PrimitiveCount;
+	uint		EnableFrustum;
+	uint		EnableOcclusion;
+	uint		HiZLevelCount;
+	uint		RenderWidth;
+	uint		RenderHeight;
+	uint		_RESERVED;
+	uint		_RESERVED2;
+
+	S_CullConfig() : FrustumPlanes(), ViewProjPrev(), PrimitiveCount(0), EnableFrustum(1), EnableOcclusion(0), HiZLevelCount(0), RenderWidth(0), RenderHeight(0), _RESERVED(0), _RESERVED2(0) {}
+};
+
+#endif
+#ifdef BIND_CULLCONFIG
+#ifndef SET_CULLCONFIG
+#define SET_CULLCONFIG 0
+#endif
+
+layout(set = SET_CULLCONFIG, binding = BIND_CULLCONFIG) uniform S_CullConfig
+{
+	vec4		FrustumPlanes[6];
+	mat4		ViewProjPrev;
+	uint		PrimitiveCount;
+	uint		EnableFrustum;
+	uint		EnableOcclusion;
+	uint		HiZLevelCount;
+	uint		RenderWidth;
+	uint		RenderHeight;
+	uint		_RESERVED;
+	uint		_RESERVED2;
+} ubo_cullconfig;
+#endif
+
+/// Cull Primitive SSBO entry, also read by the G-buffer shaders through the draws' first instance
+/// Size: 12 * 4 = 48 Byte per primitive
+/// Min, Max = bounding box of the primitive in the space of the rasterized vertices, before the node instance transform
+/// FirstIndex, IndexCount = index range of the primitive
+/// Flags = CULL_FLAG_XXX
+/// NodeIndex = entry of the node instance SSBO the primitive is transformed by
+
+#define CULL_FLAG_ALWAYS_VISIBLE 1
+
+#ifdef __cplusplus
+
+struct S_CullPrimitive
+{
+	glm::vec3	Min;
+	uint		FirstIndex;
+	glm::vec3	Max;
+	uint		IndexCount;
+	uint		Flags;
+	uint		NodeIndex;
+	uint		_RESERVED2;
+	uint		_RESERVED3;
+};
+
+#else
+struct S_CullPrimitive
+{
+	vec3		Min;
+	uint		FirstIndex;
+	vec3		Max;
+	uint		IndexCount;
+	uint		Flags;
+	uint		NodeIndex;
+	uint		_RESERVED2;
+	uint		_RESERVED3;
+};
+#endif
+
+/// Node Instance SSBO entry
+/// Size: 32 * 4 = 128 Byte per mesh node
+/// Model = transform from the rasterized vertex positions to the current node pose, identity for skinned nodes
+/// ModelPrev = Model of the previous frame
+
+#ifdef __cplusplus
+
+struct S_NodeInstance
+{
+	glm::mat4	Model;
+	glm::mat4	ModelPrev;
+};
+
+#else
+struct S_NodeInstance
+{
+	mat4		Model;
+	mat4		ModelPrev;
+};
+#endif
+
+/// Hi-Z Config PushConstant
 /// Size: 4 * 4 = 16 Byte
+/// SourceWidth, SourceHeight = size of the depth attachment or pyramid level that is reduced
+/// DestWidth, DestHeight = size of the written pyramid level, half the source rounded down
+
+#ifdef __cplusplus
+
+struct SPC_HiZConfig
+{
+	uint		SourceWidth;
+	uint		SourceHeight;
+	uint		DestWidth;
+	uint		DestHeight;
+
+	SPC_HiZConfig() : SourceWidth(0), SourceHeight(0), DestWidth(0), DestHeight(0) {}
+};
+
+#endif
+#ifdef PUSHC_HIZCONFIG
+layout (push_constant) uniform SPC_HiZConfig
+{
+	uint		SourceWidth;
+	uint		SourceHeight;
+	uint		DestWidth;
+	uint		DestHeight;
+} hiz;
+#endif
+
+/// Visibility Resolve PushConstant
+/// Size: 2 * 4 = 8 Byte
+/// RenderWidth, RenderHeight = render size the visibility buffer was rasterized at
+
+#ifdef __cplusplus
+
+struct SPC_VisibilityResolve
+{
+	uint		RenderWidth;
+	uint		RenderHeight;
+
+	SPC_VisibilityResolve() : RenderWidth(0), RenderHeight(0) {}
+};
+
+#endif
+#ifdef PUSHC_VISIBILITYRESOLVE
+layout (push_constant) uniform SPC_VisibilityResolve
+{
+	uint		RenderWidth;
+	uint		RenderHeight;
+} resolve;
+#endif
+
+/// GUI BASE UBO
+/// Size: 8 * 4 = 32 Byte
 /// AttachmentIndex = Index of attachment to show
 /// DoComposition = If true, AttachmentIndex is ignored, and instead the first 3 attachments are interpreted as worldpos, worldnormal and albedo respectively
+/// RenderScaleX, RenderScaleY = part of the attachments covered by the dynamic resolution render size
+/// OutputResolutionMask = bit i is set if attachment i is always rendered at output resolution
 
 #ifdef __cplusplus
 
@@ -127,11 +491,11 @@ struct S_Guibase
 	uint		WindowWidth;
 
 	uint		WindowHeight;
-	uint		_RESERVED;
-	uint		_RESERVED2;
-	uint        _RESERVED3;
+	float		RenderScaleX;
+	float		RenderScaleY;
+	uint		OutputResolutionMask;
 
-	S_Guibase() : SplitViewFactor(1.f), ImageLeft(0), ImageRight(0), WindowWidth(800), WindowHeight(600), _RESERVED(0), _RESERVED2(0), _RESERVED3() {}
+	S_Guibase() : SplitViewFactor(1.f), ImageLeft(0), ImageRight(0), WindowWidth(800), WindowHeight(600), RenderScaleX(1.f), RenderScaleY(1.f), OutputResolutionMask(0) {}
 };
 
 #endif
@@ -148,9 +512,9 @@ layout(set = SET_GUIBASE, binding = BIND_GUIBASE) uniform S_Guibase
 	uint		WindowWidth;
 
 	uint		WindowHeight;
-	uint        _RESERVED;
-	uint        _RESERVED2;
-	uint        _RESERVED3;
+	float		RenderScaleX;
+	float		RenderScaleY;
+	uint		OutputResolutionMask;
 } ubo_guibase;
 #endif
 
@@ -189,6 +553,117 @@ layout(set = SET_ACCUCONFIG, binding = BIND_ACCUCONFIG) uniform S_AccuConfig
 } ubo_accuconfig;
 #endif
 
+/// ADAPTIVE SAMPLING UBO
+/// Size: 16 byte
+/// EnableAdaptiveSampling = If 1, the path tracer takes its per pixel sample count from the sample budget (SVGF only)
+/// TargetError = relative standard error of the accumulated luminance a pixel is sampled towards
+/// MinSamples, MaxSamples = range of the per pixel budget, pixels without history get MaxSamples
+
+#define ADAPTIVE_SAMPLING_MAX_SAMPLES 16
+
+#ifdef __cplusplus
+
+struct S_AdaptiveSamplingConfig
+{
+	int			EnableAdaptiveSampling;
+	float		TargetError;
+	int			MinSamples;
+	int			MaxSamples;
+
+	S_AdaptiveSamplingConfig() : EnableAdaptiveSampling(0), TargetError(0.05f), MinSamples(1), MaxSamples(4) {}
+};
+
+#endif
+#ifdef BIND_ADAPTIVESAMPLINGCONFIG
+#ifndef SET_ADAPTIVESAMPLINGCONFIG
+#define SET_ADAPTIVESAMPLINGCONFIG 0
+#endif 
+
+layout(set = SET_ADAPTIVESAMPLINGCONFIG, binding = BIND_ADAPTIVESAMPLINGCONFIG) uniform S_AdaptiveSamplingConfig
+{
+	int			EnableAdaptiveSampling;
+	float		TargetError;
+	int			MinSamples;
+	int			MaxSamples;
+} ubo_adaptivesamplingconfig;
+#endif
+
+/// DYNAMIC RESOLUTION UBO
+/// Size: 8 * 4 = 32 byte
+/// EnableDynamicResolution = If 1, all passes in front of the temporal upscaling render at a fraction of the output size (SVGF only)
+/// TargetFrameTime = frame time budget in milliseconds, the render scale is adjusted towards it
+/// MinRenderScale = lower bound of the render scale
+/// HistoryWeight = weight of the reprojected previous output in the temporal upscaling
+/// RenderWidth, RenderHeight = current render size, set every frame
+
+#ifdef __cplusplus
+
+struct S_DynamicResolutionConfig
+{
+	int			EnableDynamicResolution;
+	float		TargetFrameTime;
+	float		MinRenderScale;
+	float		HistoryWeight;
+	int			RenderWidth;
+	int			RenderHeight;
+	int			_RESERVED;
+	int			_RESERVED2;
+
+	S_DynamicResolutionConfig() : EnableDynamicResolution(0), TargetFrameTime(33.3f), MinRenderScale(0.5f), HistoryWeight(0.85f), RenderWidth(0), RenderHeight(0), _RESERVED(0), _RESERVED2(0) {}
+};
+
+#endif
+#ifdef BIND_DYNAMICRESOLUTIONCONFIG
+#ifndef SET_DYNAMICRESOLUTIONCONFIG
+#define SET_DYNAMICRESOLUTIONCONFIG 0
+#endif 
+
+layout(set = SET_DYNAMICRESOLUTIONCONFIG, binding = BIND_DYNAMICRESOLUTIONCONFIG) uniform S_DynamicResolutionConfig
+{
+	int			EnableDynamicResolution;
+	float		TargetFrameTime;
+	float		MinRenderScale;
+	float		HistoryWeight;
+	int			RenderWidth;
+	int			RenderHeight;
+	int			_RESERVED;
+	int			_RESERVED2;
+} ubo_dynamicresolutionconfig;
+#endif
+
+/// REDUCED INDIRECT UBO
+/// Size: 16 byte
+/// IndirectMode = one of INDIRECT_MODE_XXX, reduced modes trace indirect light for a checkerboard or one pixel per 2x2 block (SVGF only)
+/// NormalPower = exponent of the normal similarity in the joint bilateral upsampling weights
+/// PositionPhi = squared world space distance at which the position weight of a traced pixel drops to 1/e
+
+#ifdef __cplusplus
+
+struct S_ReducedIndirectConfig
+{
+	int			IndirectMode;
+	float		NormalPower;
+	float		PositionPhi;
+	float		_RESERVED;
+
+	S_ReducedIndirectConfig() : IndirectMode(INDIRECT_MODE_FULL), NormalPower(32.f), PositionPhi(0.01f), _RESERVED() {}
+};
+
+#endif
+#ifdef BIND_REDUCEDINDIRECTCONFIG
+#ifndef SET_REDUCEDINDIRECTCONFIG
+#define SET_REDUCEDINDIRECTCONFIG 0
+#endif 
+
+layout(set = SET_REDUCEDINDIRECTCONFIG, binding = BIND_REDUCEDINDIRECTCONFIG) uniform S_ReducedIndirectConfig
+{
+	int			IndirectMode;
+	float		NormalPower;
+	float		PositionPhi;
+	float		_RESERVED;
+} ubo_reducedindirectconfig;
+#endif
+
 /// BMFR UBO
 /// Size: 8 * 4 + 4 * BMFR_MAX_FEATURE_BUFFERS bytes
 /// EnableAccumulation = See Accuconfig
@@ -20,10 +20,13 @@ namespace rtf
 		depth,
 		meshid,
 		motionvector,
+		visibility,
 		// PATHTRACER
 		rtoutput,
 		rtdirect,
 		rtindirect,
+		rtindirect_reduced,
+		sample_budget,
 		// TEMPORAL ACCUMULATION
 		prev_position,
 		prev_normal,
@@ -50,6 +53,9 @@ namespace rtf
 		// SVGF
 		atrous_output,
 		atrous_intermediate,
+		// TEMPORAL UPSCALING
+		upscaled_output,
+		upscale_history,
 
 		// add your attachment before this one
 		max_attachments,
@@ -72,9 +78,11 @@ namespace rtf
 		VkImageUsageFlags m_UsageFlags{};
 		VkExtent2D m_Size{};
 		VkImageLayout m_InitialLayout;
+		// Attachments without a fixed size follow the manager's size divided by this (rounded up)
+		VkExtent2D m_SizeDivisor{ 1, 1 };
 
 		AttachmentInitInfo() = default;
-		AttachmentInitInfo(Attachment attachmentid, VkFormat format, VkImageUsageFlags flags, VkImageLayout initialLayout = VK_IMAGE_LAYOUT_GENERAL, VkExtent2D size = VkExtent2D{ 0, 0 }) : m_AttachmentId(attachmentid), m_Format(format), m_UsageFlags(flags), m_Size(size), m_InitialLayout(initialLayout) {};
+		AttachmentInitInfo(Attachment attachmentid, VkFormat format, VkImageUsageFlags flags, VkImageLayout initialLayout = VK_IMAGE_LAYOUT_GENERAL, VkExtent2D size = VkExtent2D{ 0, 0 }, VkExtent2D sizeDivisor = VkExtent2D{ 1, 1 }) : m_AttachmentId(attachmentid), m_Format(format), m_UsageFlags(flags), m_Size(size), m_InitialLayout(initialLayout), m_SizeDivisor(sizeDivisor) {};
 	};
 
 	/// <summary>
@@ -100,10 +108,15 @@ namespace rtf
 			AttachmentInitInfo(Attachment::depth,  VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL),
 			AttachmentInitInfo(Attachment::meshid,  VK_FORMAT_R32_SINT, DEFAULTFLAGS),
 			AttachmentInitInfo(Attachment::motionvector,  VK_FORMAT_R32G32_SFLOAT, DEFAULTFLAGS),
+			// Triangle id + 1 of the visibility buffer mode, 0 where no geometry was rasterized
+			AttachmentInitInfo(Attachment::visibility,  VK_FORMAT_R32_UINT, DEFAULTFLAGS),
 			// Pathtracer
 			AttachmentInitInfo(Attachment::rtoutput,  DEFAULT_COLOR_FORMAT, DEFAULTFLAGS),
 			AttachmentInitInfo(Attachment::rtdirect,  DEFAULT_COLOR_FORMAT, DEFAULTFLAGS),
 			AttachmentInitInfo(Attachment::rtindirect,  DEFAULT_COLOR_FORMAT, DEFAULTFLAGS),
+			// Half width holds a checkerboard, the upper half also fits half resolution
+			AttachmentInitInfo(Attachment::rtindirect_reduced,  DEFAULT_COLOR_FORMAT, DEFAULTFLAGS, VK_IMAGE_LAYOUT_GENERAL, VkExtent2D{ 0, 0 }, VkExtent2D{ 2, 1 }),
+			AttachmentInitInfo(Attachment::sample_budget, VK_FORMAT_R32_SINT, DEFAULTFLAGS),
 			// Temporal Accumulation
 			AttachmentInitInfo(Attachment::prev_position, DEFAULT_GEOMETRY_FORMAT, DEFAULTFLAGS),
 			AttachmentInitInfo(Attachment::prev_normal, DEFAULT_GEOMETRY_FORMAT, DEFAULTFLAGS),
@@ -129,6 +142,9 @@ namespace rtf
 			// SVGF
 			AttachmentInitInfo(Attachment::atrous_output, DEFAULT_COLOR_FORMAT, DEFAULTFLAGS),
 			AttachmentInitInfo(Attachment::atrous_intermediate, DEFAULT_COLOR_FORMAT, DEFAULTFLAGS),
+			// Temporal Upscaling
+			AttachmentInitInfo(Attachment::upscaled_output, DEFAULT_COLOR_FORMAT, DEFAULTFLAGS),
+			AttachmentInitInfo(Attachment::upscale_history, DEFAULT_COLOR_FORMAT, DEFAULTFLAGS),
 			
 		};
 		std::array<AttachmentInitInfo, (size_t)Attachment::max_attachments> m_attachmentInits{};
@@ -140,6 +156,12 @@ namespace rtf
 		~Attachment_Manager();
 
 		inline VkExtent2D GetSize() const { return m_size; }
+		// Passes before the temporal upscaling render into the upper left sub-rectangle of this size
+		inline VkExtent2D GetRenderSize() const { return m_renderSize; }
+		inline float GetRenderScale() const { return m_renderScale; }
+
+		// Changes the render size only, attachments always keep the full size
+		void setRenderScale(float scale);
 
 		void createAttachment(VkCommandBuffer cmdBuffer, const AttachmentInitInfo& initInfo, FrameBufferAttachment* attachment);
 		FrameBufferAttachment* getAttachment(Attachment);
@@ -160,6 +182,8 @@ namespace rtf
 
 		// Keeping track of current attachment size
 		VkExtent2D m_size;
+		float m_renderScale = 1.0f;
+		VkExtent2D m_renderSize;
 
 		// List of managed Attachments
 		static const int m_maxAttachmentSize = (int)Attachment::max_attachments;
@@ -0,0 +1,28 @@
+#ifndef BlueNoise_h
+#define BlueNoise_h
+
+#include <cstdint>
+#include <vector>
+
+namespace rtf
+{
+	/// <summary>
+	/// Generates tileable blue noise with the void and cluster method (Ulichney 1993)
+	/// </summary>
+	class BlueNoise
+	{
+	public:
+		/// <summary>
+		/// Returns the rank of every pixel of a size x size tile as a threshold in [0, 255], row major.
+		/// Different seeds produce uncorrelated tiles
+		/// </summary>
+		static std::vector<uint8_t> generateTile(uint32_t size, uint32_t seed);
+
+		/// <summary>
+		/// Interleaves channelCount tiles per layer, layout is [layer][y][x][channel] as expected by a texture array upload
+		/// </summary>
+		static std::vector<uint8_t> generateTextureArray(uint32_t size, uint32_t layerCount, uint32_t channelCount);
+	};
+}
+
+#endif //BlueNoise_h
@@ -65,6 +65,9 @@ namespace rtf
 	using UBO_AccuConfig = ManagedUBO<S_AccuConfig>::Ptr;
 	using UBO_AtrousConfig = ManagedUBO<S_AtrousConfig>::Ptr;
 	using UBO_BMFRConfig = ManagedUBO<S_BMFRConfig>::Ptr;
+	using UBO_AdaptiveSamplingConfig = ManagedUBO<S_AdaptiveSamplingConfig>::Ptr;
+	using UBO_ReducedIndirectConfig = ManagedUBO<S_ReducedIndirectConfig>::Ptr;
+	using UBO_DynamicResolutionConfig = ManagedUBO<S_DynamicResolutionConfig>::Ptr;
 
 	template<typename T_UBO>
 	ManagedUBO<T_UBO>::ManagedUBO(vks::VulkanDevice* vulkanDevice)
@@ -38,6 +38,8 @@ namespace rtf
 	class RenderpassGbuffer;
 	class RenderpassGui;
 	class RenderpassPathTracer;
+	class RenderpassSkinning;
+	class RenderpassRestirDI;
 
 	class RTFilterDemo : public VulkanExampleBase
 	{
@@ -54,11 +56,16 @@ namespace rtf
 		friend RenderpassGbuffer;
 		friend RenderpassGui;
 		friend RenderpassPathTracer;
+		friend RenderpassSkinning;
+		friend RenderpassRestirDI;
 
 #pragma region Scene/Shared UBO
 
 		vkglTF::Model m_Scene{};
 
+		bool m_animateScene = true;
+		float m_animationTime = 0.0f;
+
 		int32_t m_enabledLightCount = 1;
 		bool m_animateLights[UBO_SCENEINFO_LIGHT_COUNT]{};
 
@@ -67,10 +74,21 @@ namespace rtf
 		UBO_AccuConfig m_UBO_AccuConfig{};
 		UBO_AtrousConfig m_UBO_AtrousConfig{};
 		UBO_BMFRConfig m_UBO_BMFRConfig{};
+		UBO_AdaptiveSamplingConfig m_UBO_AdaptiveSamplingConfig{};
+		UBO_ReducedIndirectConfig m_UBO_ReducedIndirectConfig{};
+		UBO_DynamicResolutionConfig m_UBO_DynamicResolutionConfig{};
+		// Frame time the render scale controller works on, in milliseconds
+		float m_smoothedFrameTime = 0.0f;
 		
 		bool m_ShowSceneControls = false;
 		bool m_ShowPathtracerControls = false;
 
+		// Trace with ray queries from compute instead of the ray tracing pipeline (--rayquery, or if the pipeline is unsupported)
+		bool m_useRayQueryPathTracer = false;
+
+		// Cook the color textures of the scene to BC7 (--compresstextures)
+		bool m_compressTextures = false;
+
 #pragma endregion
 
 		// One sampler for the frame buffer color attachments
@@ -102,6 +120,8 @@ namespace rtf
 
 		virtual void setupUBOs();
 		virtual void updateUBOs();
+		void updateSceneAnimation();
+		void updateDynamicResolution();
 
 		virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay) override;
 		virtual void ResetGUIState();
@@ -115,7 +135,8 @@ namespace rtf
 		bool saveScreenshot(const char* filename);
 
 		bool gui_rp_on = false;
-		const size_t m_semaphoreCount = 5;
+		// One less than the passes of the longest queue (SVGF: skinning, G-buffer, path tracer, ReSTIR, indirect upsampling, accumulation, sample budget, atrous, temporal upscaling, GUI)
+		const size_t m_semaphoreCount = 9;
 
 		VkPipelineShaderStageCreateInfo LoadShader(std::string shadername, VkShaderStageFlagBits stage);
 
@@ -124,11 +145,13 @@ namespace rtf
 
 		VkPhysicalDeviceRayTracingPipelineFeaturesKHR rayTracingPipelineFeatures{};
 		VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures{};
+		VkPhysicalDeviceRayQueryFeaturesKHR rayQueryFeatures{};
 		VkPhysicalDeviceVulkan12Features vulkan12Features;
 
 		// Enabled features and properties
 		VkPhysicalDeviceRayTracingPipelineFeaturesKHR enabledRayTracingPipelineFeatures{};
 		VkPhysicalDeviceAccelerationStructureFeaturesKHR enabledAccelerationStructureFeatures{};
+		VkPhysicalDeviceRayQueryFeaturesKHR enabledRayQueryFeatures{};
 		VkPhysicalDeviceVulkan12Features enabledPhysicalDeviceVulkan12Features{};
 
 	};
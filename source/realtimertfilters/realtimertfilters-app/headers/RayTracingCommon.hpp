@@ -29,7 +29,25 @@ namespace rtf
 			uint64_t deviceAddress = 0;
 			VkDeviceMemory memory;
 			VkBuffer buffer;
-		}m_bottomLevelAS, m_topLevelAS;
+		}m_topLevelAS;
+
+		/// <summary>
+		/// One bottom level acceleration structure per mesh node. The node's primitives occupy a contiguous range of the scene index buffer.
+		/// </summary>
+		struct BottomLevelInstance {
+			AccelerationStructure accelerationStructure{};
+			vkglTF::Node* node = nullptr;
+			uint32_t firstIndex = 0;
+			uint32_t indexCount = 0;
+			// Skinned structures are refit every frame from the animated vertex buffer and never compacted
+			bool skinned = false;
+		};
+		std::vector<BottomLevelInstance> m_bottomLevelAS{};
+		// Scratch memory for the per frame refit of skinned bottom level structures
+		ScratchBuffer m_bottomLevelScratchBuffer{};
+
+		// Persistently mapped instance data, rewritten every frame for TLAS updates
+		vks::Buffer m_instancesBuffer{};
 
 		struct ShaderBindingTables {
 			ShaderBindingTable raygen;
@@ -43,6 +61,16 @@ namespace rtf
 		/// </summary>
 		SPC_PathtracerConfig m_pathtracerconfig;
 
+		/// <summary>
+		/// Compact the bottom level acceleration structures after building them
+		/// </summary>
+		bool m_compactBottomLevelAS = true;
+
+		/// <summary>
+		/// Serialise the bottom level acceleration structures next to the scene and deserialise them on later runs
+		/// </summary>
+		bool m_cacheBottomLevelAS = true;
+
 		// ================ Struct types END ================
 
 	protected:
@@ -53,8 +81,15 @@ namespace rtf
 		Camera* m_camera{};
 		// set via setter after scene loaded
 		vkglTF::Model* m_Scene{};
-		std::vector<GltfShadeMaterial> m_materials;
-		vks::Buffer m_material_buffer;
+		// Lights sampled by the path tracer, rewritten together with their alias table when the scene info lights change
+		vks::Buffer m_light_buffer;
+		// Emissive triangles of the scene, built once at load time as they never change
+		std::vector<S_SceneLight> m_emissiveLights;
+		std::vector<float> m_emissiveLightWeights;
+		// Scene info lights the light buffer was last built from
+		std::vector<S_Light> m_bufferedSceneLights;
+		// Blue noise tiles of the blue noise sampler, two channels per layer
+		vks::Texture2DArray m_blueNoise;
 		std::vector<VkDescriptorImageInfo> m_textures;
 
 		PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR;
@@ -64,9 +99,15 @@ namespace rtf
 		PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddressKHR;
 		PFN_vkBuildAccelerationStructuresKHR vkBuildAccelerationStructuresKHR;
 		PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR;
-		PFN_vkCmdTraceRaysKHR vkCmdTraceRaysKHR;
-		PFN_vkGetRayTracingShaderGroupHandlesKHR vkGetRayTracingShaderGroupHandlesKHR;
-		PFN_vkCreateRayTracingPipelinesKHR vkCreateRayTracingPipelinesKHR;
+		// Ray tracing pipeline backend only, null with ray queries
+		PFN_vkCmdTraceRaysKHR vkCmdTraceRaysKHR{};
+		PFN_vkGetRayTracingShaderGroupHandlesKHR vkGetRayTracingShaderGroupHandlesKHR{};
+		PFN_vkCreateRayTracingPipelinesKHR vkCreateRayTracingPipelinesKHR{};
+		PFN_vkCmdWriteAccelerationStructuresPropertiesKHR vkCmdWriteAccelerationStructuresPropertiesKHR;
+		PFN_vkCmdCopyAccelerationStructureKHR vkCmdCopyAccelerationStructureKHR;
+		PFN_vkCmdCopyAccelerationStructureToMemoryKHR vkCmdCopyAccelerationStructureToMemoryKHR;
+		PFN_vkCmdCopyMemoryToAccelerationStructureKHR vkCmdCopyMemoryToAccelerationStructureKHR;
+		PFN_vkGetDeviceAccelerationStructureCompatibilityKHR vkGetDeviceAccelerationStructureCompatibilityKHR;
 
 	};
 }
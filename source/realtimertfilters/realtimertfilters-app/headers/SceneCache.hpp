@@ -0,0 +1,155 @@
+#ifndef SceneCache_h
+#define SceneCache_h
+
+#include <cstring>
+#include <type_traits>
+
+#include "VulkanglTFModel.h"
+
+namespace vkglTF
+{
+	/*
+		Binary cache of the scene built by Model::loadFromFile
+		Written next to the glTF file on the first load. Later loads map it, restore materials, nodes, skins and animations
+		from its scene description and upload the streams as they are, without parsing the glTF file at all
+	*/
+	class SceneCache {
+	public:
+		// Primitive table entry, in the order Model::loadNode creates the primitives
+		struct Primitive {
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			uint32_t firstVertex;
+			uint32_t vertexCount;
+			glm::vec3 min;
+			glm::vec3 max;
+		};
+
+		// Streams in their GPU layout, either owned by the loader or pointing into the mapped file
+		struct Streams {
+			const Vertex* vertices = nullptr;
+			const uint32_t* indices = nullptr;
+			const HitVertex* hitVertices = nullptr;
+			const HitTriangle* hitTriangles = nullptr;
+			const Model::EmissiveTriangle* emissiveTriangles = nullptr;
+			const Primitive* primitives = nullptr;
+			// Scene description written by Model::serializeScene, read back with a Reader
+			const uint8_t* scene = nullptr;
+			uint64_t sceneSize = 0;
+			uint32_t vertexCount = 0;
+			uint32_t indexCount = 0;
+			uint32_t emissiveTriangleCount = 0;
+			uint32_t primitiveCount = 0;
+		};
+
+		// Appends values, arrays of plain values and strings to the scene description
+		class Writer {
+		public:
+			std::vector<uint8_t> data;
+
+			template<typename T>
+			void write(const T& value) {
+				static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be written");
+				const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+				data.insert(data.end(), bytes, bytes + sizeof(T));
+			}
+			template<typename T>
+			void write(const std::vector<T>& values) {
+				static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be written");
+				write(static_cast<uint32_t>(values.size()));
+				const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values.data());
+				data.insert(data.end(), bytes, bytes + values.size() * sizeof(T));
+			}
+			void write(const std::string& value) {
+				write(static_cast<uint32_t>(value.size()));
+				data.insert(data.end(), value.begin(), value.end());
+			}
+		};
+
+		// Reads what a Writer wrote, every read fails instead of running past the end of the description
+		class Reader {
+		public:
+			Reader(const uint8_t* data, uint64_t size) : data(data), size(size) {};
+
+			template<typename T>
+			bool read(T& value) {
+				static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be read");
+				if (sizeof(T) > size - offset) {
+					return false;
+				}
+				memcpy(&value, data + offset, sizeof(T));
+				offset += sizeof(T);
+				return true;
+			}
+			template<typename T>
+			bool read(std::vector<T>& values) {
+				static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be read");
+				uint32_t count;
+				if (!read(count) || count > (size - offset) / sizeof(T)) {
+					return false;
+				}
+				values.resize(count);
+				if (count > 0) {
+					memcpy(values.data(), data + offset, count * sizeof(T));
+				}
+				offset += count * sizeof(T);
+				return true;
+			}
+			bool read(std::string& value) {
+				uint32_t length;
+				if (!read(length) || length > size - offset) {
+					return false;
+				}
+				value.assign(reinterpret_cast<const char*>(data + offset), length);
+				offset += length;
+				return true;
+			}
+			// Element count of a following list, each element takes at least one byte
+			bool readCount(uint32_t& count) {
+				return read(count) && count <= size - offset;
+			}
+			bool atEnd() const { return offset == size; }
+
+		private:
+			const uint8_t* data;
+			uint64_t size;
+			uint64_t offset = 0;
+		};
+
+		// FNV-1a offset basis, the start value for hashBytes
+		static const uint64_t HASH_SEED = 14695981039346656037ull;
+
+		SceneCache() {};
+		~SceneCache();
+
+		static uint64_t hashBytes(uint64_t hash, const void* data, size_t size);
+
+		/** @brief Hashes name, size and modification time of the glTF file and its buffers with the geometry loading parameters */
+		static uint64_t computeKey(const std::string& filename, uint32_t fileLoadingFlags, float scale);
+		static std::string cacheFilename(const std::string& filename);
+		/** @brief Writes the streams to a new cache file. A failed write only costs the next start-up */
+		static bool write(const std::string& filename, uint64_t key, const Streams& streams);
+
+		/** @brief Maps a cache file, fails if it is missing or was written for another key or vertex layout */
+		bool open(const std::string& filename, uint64_t key);
+		void close();
+
+		const Streams& streams() const { return data; }
+		Reader sceneReader() const { return Reader(data.scene, data.sceneSize); }
+		/** @brief Returns the next entry of the primitive table, nullptr once all have been used */
+		const Primitive* nextPrimitive();
+		uint32_t primitivesUsed() const { return primitiveCursor; }
+
+	private:
+		Streams data;
+		uint32_t primitiveCursor = 0;
+		const void* mapping = nullptr;
+		size_t mappingSize = 0;
+#if defined(_WIN32)
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#endif
+	};
+}
+
+#endif //SceneCache_h
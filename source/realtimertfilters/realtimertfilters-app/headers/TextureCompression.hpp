@@ -0,0 +1,49 @@
+#ifndef TextureCompression_h
+#define TextureCompression_h
+
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include <ktx.h>
+
+namespace vkglTF
+{
+	/*
+		Block compressed textures: KTX2 container reading and writing, and a BC7 encoder cooking decoded glTF images
+		Cooked images are stored as KTX2 files next to the scene cache, so only the first load pays for the encoding
+	*/
+	class TextureCompression {
+	public:
+		// Complete mip chain of a texture, levels are tightly packed blocks
+		struct Image {
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t mipLevels = 0;
+			std::vector<unsigned char> data;
+			// Offset of every level in data, aligned to the block size
+			std::vector<VkDeviceSize> levelOffsets;
+		};
+
+		/** @brief Format of a KTX1 texture, VK_FORMAT_UNDEFINED if its GL format has no Vulkan equivalent */
+		static VkFormat getKtxFormat(ktxTexture* texture);
+
+		/** @brief Reads a KTX2 file without supercompression, sourceKey receives the key of cooked files (0 otherwise) */
+		static bool loadKtx2(const std::string& filename, Image& image, uint64_t* sourceKey = nullptr);
+		/** @brief Writes a BC7 image as KTX2 file, sourceKey identifies the image it was cooked from */
+		static bool writeKtx2(const std::string& filename, const Image& image, uint64_t sourceKey);
+
+		/** @brief Builds the mip chain of an RGBA8 image and encodes every level to BC7 */
+		static void encodeBC7(const unsigned char* rgba, uint32_t width, uint32_t height, Image& image);
+
+		/** @brief Key of a cooked image, changes with the encoded source file and the encoder */
+		static uint64_t computeSourceKey(const unsigned char* data, size_t size);
+		static std::string cookedFilename(const std::string& sceneFilename, uint32_t imageIndex);
+
+		/** @brief Sampling from optimal tiled images of this format is supported */
+		static bool isFormatSupported(VkPhysicalDevice physicalDevice, VkFormat format);
+	};
+}
+
+#endif //TextureCompression_h
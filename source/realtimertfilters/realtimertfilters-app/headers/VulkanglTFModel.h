@@ -37,18 +37,11 @@
 
 namespace vkglTF
 {
-	enum DescriptorBindingFlags {
-		ImageBaseColor =		0x01,
-		ImageNormalMap =		0x02,
-		MetallicRoughnessMap =	0x04,
-	};
-
-	extern VkDescriptorSetLayout descriptorSetLayoutImage;
 	extern VkDescriptorSetLayout descriptorSetLayoutUbo;
 	extern VkMemoryPropertyFlags memoryPropertyFlags;
-	extern uint32_t descriptorBindingFlags;
 
 	struct Node;
+	class SceneCache;
 
 	/*
 		glTF texture loading class
@@ -66,7 +59,10 @@ namespace vkglTF
 		VkSampler sampler;
 		void updateDescriptor();
 		void destroy();
-		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue);
+		// Sampler and view for the image, once image and mipLevels are set
+		void createSamplerAndView(VkFormat format);
+		// Decodes an image kept as its encoded file (as_is) to RGBA8 in place, RGB is expanded to RGBA. Thread safe per image
+		static bool decodeImage(tinygltf::Image& gltfimage);
 	};
 
 	/*
@@ -81,20 +77,22 @@ namespace vkglTF
 		float roughnessFactor = 1.0f;
 		glm::vec4 baseColorFactor = glm::vec4(1.0f);
 		glm::vec4 emissiveFactor = glm::vec4(0.0f);
+		// Texture ids index Model::textures (one texture per glTF image), -1 if unused. The pointers are set by Model::bindMaterialTextures
 		vkglTF::Texture* baseColorTexture = nullptr;
 		int baseColorTextureId = -1;
 		vkglTF::Texture* metallicRoughnessTexture = nullptr;
+		int metallicRoughnessTextureId = -1;
 		vkglTF::Texture* normalTexture = nullptr;
+		int normalTextureId = -1;
 		vkglTF::Texture* occlusionTexture = nullptr;
+		int occlusionTextureId = -1;
 		vkglTF::Texture* emissiveTexture = nullptr;
+		int emissiveTextureId = -1;
 
 		vkglTF::Texture* specularGlossinessTexture = nullptr;
 		vkglTF::Texture* diffuseTexture = nullptr;
 
-		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-
 		Material(vks::VulkanDevice* device) : device(device) {};
-		void createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
 	};
 
 	/*
@@ -171,6 +169,8 @@ namespace vkglTF
 		glm::vec3 translation{};
 		glm::vec3 scale{ 1.0f };
 		glm::quat rotation{};
+		// Transform that has been baked into the vertex buffer at load time (pre-transform and/or flip)
+		glm::mat4 bakedMatrix = glm::mat4(1.0f);
 		glm::mat4 localMatrix();
 		glm::mat4 getMatrix();
 		void update();
@@ -235,16 +235,38 @@ namespace vkglTF
 		static VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);
 	};
 
+	/*
+		Compact vertex stream for hit shading in the path tracer (see shaders/glsl/hitvertex.glsl)
+		Positions are reconstructed from the ray, so only the normal (octahedral, snorm16x2) and uv (half2) are stored
+	*/
+	struct HitVertex {
+		uint32_t normal;
+		uint32_t uv;
+		static HitVertex pack(const Vertex& vertex);
+	};
+
+	/*
+		Per triangle data for hit shading, one entry per triangle of the index buffer
+		lodBias is the texture LOD term of the triangle for ray cone filtering, 0.5 * log2(uv area / world area)
+	*/
+	struct HitTriangle {
+		int32_t materialId;
+		float lodBias;
+		static HitTriangle create(const Vertex& v0, const Vertex& v1, const Vertex& v2);
+	};
+
 	enum FileLoadingFlags {
 		None = 0x00000000,
 		PreTransformVertices = 0x00000001,
 		PreMultiplyVertexColors = 0x00000002,
 		FlipY = 0x00000004,
-		DontLoadImages = 0x00000008
+		DontLoadImages = 0x00000008,
+		// Cooks jpg and png color images (base color, emissive) to BC7, cached next to the scene cache
+		CompressTextures = 0x00000010
 	};
 
+	// Materials are not bound by the model, the renderpasses index them bindlessly
 	enum RenderFlags {
-		BindImages = 0x00000001,
 		RenderOpaqueNodes = 0x00000002,
 		RenderAlphaMaskedNodes = 0x00000004,
 		RenderAlphaBlendedNodes = 0x00000008
@@ -257,7 +279,6 @@ namespace vkglTF
 	private:
 		vkglTF::Texture* getTexture(uint32_t index);
 		vkglTF::Texture emptyTexture;
-		VkDescriptorSet emptyDescriptorSet;
 		void createEmptyTexture(VkQueue transferQueue);
 	public:
 		vks::VulkanDevice* device;
@@ -273,6 +294,30 @@ namespace vkglTF
 			VkBuffer buffer;
 			VkDeviceMemory memory;
 		} indices;
+		// Hit shading stream, one HitVertex per vertex of the vertex buffer
+		struct HitVertices {
+			int count;
+			VkBuffer buffer;
+			VkDeviceMemory memory;
+		} hitVertices;
+		// Hit shading stream, one HitTriangle per triangle of the index buffer
+		struct HitTriangles {
+			int count;
+			VkBuffer buffer;
+			VkDeviceMemory memory;
+		} hitTriangles;
+		// GltfShadeMaterial per entry of materials, indexed by Vertex::materialId. Texture ids index textures
+		struct ShadeMaterials {
+			int count;
+			VkBuffer buffer;
+			VkDeviceMemory memory;
+		} shadeMaterials;
+		// Triangles with an emissive material, in the space of the vertex buffer (world space for pre transformed models)
+		struct EmissiveTriangle {
+			glm::vec3 p0, p1, p2;
+			glm::vec3 emission;
+		};
+		std::vector<EmissiveTriangle> emissiveTriangles;
 
 		std::vector<Node*> nodes;
 		std::vector<Node*> linearNodes;
@@ -291,24 +336,52 @@ namespace vkglTF
 			float radius;
 		} dimensions;
 
+		// Axis correction applied to all vertices at load time (FlipY)
+		glm::mat4 axisMatrix = glm::mat4(1.0f);
+
 		bool metallicRoughnessWorkflow = true;
 		bool buffersBound = false;
 		std::string path;
+		std::string filename;
+		// Hash of the glTF file, its buffers and the loading flags. Keys the caches derived from this model, 0 if caching is disabled
+		uint64_t cacheKey = 0;
 
 		Model() {};
 		~Model();
-		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale);
+		// glTF primitive whose geometry still has to be decoded into its range of the vertex and index buffers
+		struct PrimitiveSource {
+			const tinygltf::Primitive* primitive;
+			int meshIndex;
+			Node* node;
+			Primitive* target;
+		};
+
+		// Builds the node hierarchy and assigns buffer ranges, the geometry is decoded by loadPrimitives afterwards
+		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<PrimitiveSource>& primitiveSources, uint32_t& indexCount, uint32_t& vertexCount, float globalscale);
+		void loadPrimitive(const tinygltf::Model& model, const PrimitiveSource& source, Vertex* vertexBuffer, uint32_t* indexBuffer, uint32_t fileLoadingFlags);
+		void loadPrimitives(const tinygltf::Model& model, const std::vector<PrimitiveSource>& primitiveSources, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, uint32_t fileLoadingFlags);
 		void loadSkins(tinygltf::Model& gltfModel);
-		void loadImages(tinygltf::Model& gltfModel, vks::VulkanDevice* device, VkQueue transferQueue);
+		// Needs the materials, only images used as color by them are cooked
+		void loadImages(std::vector<tinygltf::Image>& images, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = FileLoadingFlags::None);
 		void loadMaterials(tinygltf::Model& gltfModel);
+		void bindMaterialTextures();
+		void createShadeMaterials();
 		void loadAnimations(tinygltf::Model& gltfModel);
 		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
+		/** @brief Describes images, materials, nodes, skins and animations for the scene cache. Images are passed as referenced by the glTF file */
+		std::vector<uint8_t> serializeScene(const std::vector<tinygltf::Image>& images);
+		/** @brief Restores the scene description of an opened cache, leaves the model empty and returns false if it does not fit the cache */
+		bool deserializeScene(SceneCache& sceneCache, std::vector<tinygltf::Image>& images);
 		void bindBuffers(VkCommandBuffer commandBuffer);
-		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
-		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		// Bind an alternative vertex buffer with the scene layout (e.g. skinned vertices) together with the scene index buffer
+		void bindBuffers(VkCommandBuffer commandBuffer, VkBuffer vertexBuffer);
+		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0);
+		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0);
 		void getNodeDimensions(Node* node, glm::vec3& min, glm::vec3& max);
 		void getSceneDimensions();
 		void updateAnimation(uint32_t index, float time);
+		/** @brief Returns the transform from the baked vertex buffer positions of a node to its current (animated) pose */
+		glm::mat4 getNodeInstanceMatrix(Node* node);
 		Node* findNode(Node* parent, uint32_t index);
 		Node* nodeFromIndex(uint32_t index);
 		void prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout);
@@ -33,6 +33,9 @@ namespace rtf
 		virtual void draw(const VkCommandBuffer*& out_commandBuffers, uint32_t& out_commandBufferCount) = 0;
 		virtual void cleanUp() = 0; // Cleanup any mess you made (is called from the destructor)
 		virtual void updateUniformBuffer() {};
+		// Called after the attachment manager reallocated its images (e.g. on window resize). Rewrites descriptors and
+		// framebuffers referencing attachments, pipelines are kept as viewport and scissor are dynamic
+		virtual void onAttachmentsChanged() {};
 
 	protected:
 		// Vulkan Environment
@@ -9,6 +9,8 @@ namespace rtf
 	class RenderpassGui;
 	class RenderpassPostProcess;
 	class RenderpassPathTracer;
+	class RenderpassSkinning;
+	class RenderpassRestirDI;
 
 	enum class SupportedQueueTemplates : int32_t
 	{
@@ -26,23 +28,33 @@ namespace rtf
 		virtual ~RenderpassManager();
 
 		void setQueueTemplate(SupportedQueueTemplates queueTemplate);
+		// Adds or removes the indirect light upsampling of the SVGF queue, the path tracer then traces indirect light at reduced resolution
+		void setReducedIndirect(bool reducedIndirect);
 		void prepare(RTFilterDemo* rtFilterDemo, size_t semaphorecount);
 		void draw(VkCommandBuffer baseCommandBuffer);
 		void updateUniformBuffer();
+		// Forwards a reallocation of the attachments to all renderpasses
+		void onAttachmentsChanged();
 
 		// RENDERPASSES ********
 
+		std::shared_ptr<RenderpassSkinning> m_RP_Skinning{};
 		std::shared_ptr<RenderpassGbuffer> m_RP_GBuffer{};
 		std::shared_ptr<RenderpassGui> m_RP_Gui{};
 		std::shared_ptr<RenderpassPathTracer> m_PT{};
 		
 		std::shared_ptr<RenderpassPostProcess> m_RPF_Gauss{};
 		std::shared_ptr<RenderpassPathTracer> m_RP_PT{};
+		// Only created if ray queries are supported
+		std::shared_ptr<RenderpassRestirDI> m_RP_RestirDI{};
 		std::shared_ptr<RenderpassPostProcess> m_RPF_DepthTest{};
 		std::shared_ptr<RenderpassPostProcess> m_RPF_TempAccu{};
+		std::shared_ptr<RenderpassPostProcess> m_RPF_IndirectUpsample{};
 		std::shared_ptr<RenderpassPostProcess> m_RPF_SVGF_Accumulation{};
 		std::shared_ptr<RenderpassPostProcess> m_RPF_SVGF_Atrous{};
+		std::shared_ptr<RenderpassPostProcess> m_RPF_SVGF_SampleBudget{};
 		std::shared_ptr<RenderpassPostProcess> m_RPF_Atrous{};
+		std::shared_ptr<RenderpassPostProcess> m_RPF_TemporalUpscale{};
 
 		std::shared_ptr<RenderpassGui> m_RPG_RasterOnly{};
 		std::shared_ptr<RenderpassGui> m_RPG_PathtracerOnly{};
@@ -60,8 +72,12 @@ namespace rtf
 
 		// The currently active queue template
 		QueueTemplatePtr m_QT_Active{};
+		SupportedQueueTemplates m_ActiveQueueTemplate = SupportedQueueTemplates::RasterizationOnly;
 		std::shared_ptr<RenderpassGui> m_RPG_Active{};
 
+		// Indirect light is traced at checkerboard or half resolution and upsampled (SVGF only)
+		bool m_ReducedIndirect = false;
+
 		friend bmfr::RenderPasses;
 
 		// BMFR specialized stuff
@@ -84,6 +100,8 @@ namespace rtf
 
 		VkDevice m_device{};
 		VkSubmitInfo m_submitInfo{};
+		// Passes may consume previous results in any stage (e.g. skinned vertices in vertex input or AS builds)
+		VkPipelineStageFlags m_waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
 		VkQueue m_queue{};
 	};
 }
\ No newline at end of file
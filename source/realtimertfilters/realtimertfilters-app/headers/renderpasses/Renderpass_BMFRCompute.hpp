@@ -32,9 +32,11 @@ namespace bmfr
 
 		virtual void prepare() override; // Setup pipelines, passes, descriptorsets, etc.
 		void AllocateAndWriteDescriptorSet();
+		void WriteDescriptorSet();
 		void CreateDescriptorSetLayoutAndPipeline();
 		virtual void draw(const VkCommandBuffer*& out_commandBuffers, uint32_t& out_commandBufferCount) override;
 		virtual void cleanUp () override; // Cleanup any mess you made (is called from the destructor)
+		virtual void onAttachmentsChanged() override;
 
 		VkExtent2D m_Blocks;
 
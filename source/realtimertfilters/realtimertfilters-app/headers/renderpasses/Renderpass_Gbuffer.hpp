@@ -6,6 +6,7 @@
 #include "../VulkanglTFModel.h"
 #include "Renderpass.hpp"
 #include "../Attachment_Manager.hpp"
+#include "../ManagedUBO.hpp"
 
 namespace rtf
 {
@@ -21,12 +22,100 @@ namespace rtf
 		FrameBufferAttachment* m_MotionAttachment = nullptr;
 		FrameBufferAttachment* m_MeshIdAttachment = nullptr;
 		FrameBufferAttachment* m_DepthAttachment = nullptr;
+		FrameBufferAttachment* m_VisibilityAttachment = nullptr;
 
 		VkDescriptorSet m_DescriptorSetAttachments = nullptr;
 		VkDescriptorSet m_DescriptorSetScene = nullptr;
+		// Material buffer and texture array of the scene, bound once for all draws
+		VkDescriptorSetLayout m_MaterialDescriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet m_DescriptorSetMaterials = nullptr;
 		VkCommandBuffer m_CmdBuffer = nullptr;
+		// Render size the command buffer was recorded for
+		VkExtent2D m_RecordedSize{};
+
+		// CPU driven fallback, used when GPU culling is disabled or unsupported: the primitives are split into chunks
+		// which the job system records in parallel into secondary command buffers, executed by the primary one.
+		// With GPU culling the primary records the indirect count draw itself and the chunks are not used.
+		// Range of m_DrawPrimitives recorded into a secondary command buffer by one job
+		struct DrawChunk
+		{
+			// Pool per chunk, as pools must not be used from two threads at once
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+			uint32_t firstPrimitive = 0;
+			uint32_t primitiveCount = 0;
+			// State the chunk was recorded with, it is only recorded again when this changes
+			VkExtent2D recordedSize{};
+			VkBuffer recordedVertexBuffer = VK_NULL_HANDLE;
+			bool recordedVisibilityBuffer = false;
+		};
+		// Smallest number of primitives worth a secondary command buffer of their own
+		static const uint32_t MIN_PRIMITIVES_PER_CHUNK = 64;
+		std::vector<DrawChunk> m_DrawChunks;
+		std::vector<VkCommandBuffer> m_SecondaryCmdBuffers;
 		VkPipelineCache m_PipelineCache;
 
+		// GPU driven path, the default where supported: a compute pass frustum (and optionally Hi-Z occlusion) culls
+		// the primitives and the survivors are drawn with a single indirect count draw. Needs the drawIndirectCount
+		// feature, otherwise the secondary command buffer chunks above are recorded instead
+		bool m_GpuCulling = true;
+		bool m_OcclusionCulling = false;
+		// Path the command buffer was recorded for
+		bool m_RecordedGpuCulling = false;
+
+		// Mesh nodes of the scene, entry i of the node instance buffer belongs to m_DrawNodes[i]
+		std::vector<vkglTF::Node*> m_DrawNodes;
+		// Every primitive of the scene sorted by first index. Draws pass their index as first instance,
+		// so the G-buffer shaders find the node instance transform of the primitive
+		std::vector<S_CullPrimitive> m_DrawPrimitives;
+		uint32_t m_CullPrimitiveCount = 0;
+		vks::Buffer m_CullPrimitives{};
+		// Persistently mapped S_NodeInstance per mesh node, rewritten every frame
+		vks::Buffer m_NodeInstances{};
+		std::vector<S_NodeInstance> m_NodeInstanceData;
+		vks::Buffer m_DrawCommands{};
+		vks::Buffer m_DrawCount{};
+		ManagedUBO<S_CullConfig>::Ptr m_UBO_CullConfig;
+
+		VkDescriptorPool m_CullDescriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout m_CullDescriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet m_CullDescriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout m_CullPipelineLayout = VK_NULL_HANDLE;
+		VkPipeline m_CullPipeline = VK_NULL_HANDLE;
+
+		// Farthest depth pyramid of the previous frame, level 0 is half the render size
+		static const uint32_t MAX_HIZ_LEVELS = 16;
+		struct HiZPyramid
+		{
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			std::vector<VkImageView> levelViews;
+			std::vector<VkDescriptorSet> descriptorSets;
+			uint32_t levelCount = 0;
+		} m_HiZ;
+		VkSampler m_HiZSampler = VK_NULL_HANDLE;
+		VkDescriptorSetLayout m_HiZDescriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout m_HiZPipelineLayout = VK_NULL_HANDLE;
+		VkPipeline m_HiZPipeline = VK_NULL_HANDLE;
+		// Set once a frame recorded with the current size has built the pyramid
+		bool m_HiZValid = false;
+
+		// Visibility buffer mode: only triangle ids and depth are rasterized, a compute pass resolves the G-buffer
+		// attachments from them. Overdraw only costs a 32 bit write. Needs the geometryShader feature for gl_PrimitiveID
+		bool m_VisibilityBuffer = false;
+		// Mode the command buffer was recorded for
+		bool m_RecordedVisibilityBuffer = false;
+		VkRenderPass m_VisibilityRenderpass = VK_NULL_HANDLE;
+		VkFramebuffer m_VisibilityFrameBuffer = VK_NULL_HANDLE;
+		VkPipeline m_VisibilityPipeline = VK_NULL_HANDLE;
+		VkDescriptorSetLayout m_ResolveDescriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet m_ResolveDescriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout m_ResolvePipelineLayout = VK_NULL_HANDLE;
+		VkPipeline m_ResolvePipeline = VK_NULL_HANDLE;
+		// Vertex buffer the resolve descriptor set was written with
+		VkBuffer m_ResolveVertexBuffer = VK_NULL_HANDLE;
+
 		vkglTF::Model* m_Scene = nullptr;
 
 		RenderpassGbuffer();
@@ -35,15 +124,37 @@ namespace rtf
 		// Inherited via Renderpass
 		virtual void prepare() override;
 		void prepareRenderpass();
+		void prepareFramebuffer();
 		void prepareAttachments();
 		void setupDescriptorPool();
 		void setupDescriptorSetLayout();
 		void setupDescriptorSet();
+		void prepareDrawPrimitives();
+		void updateNodeInstances();
+		void prepareDrawChunks();
+		void recordDrawChunk(DrawChunk& chunk, VkExtent2D size, VkBuffer vertexBuffer);
 		void buildCommandBuffer();
 		void preparePipeline();
 
+		bool isGpuCullingSupported() const;
+		void prepareGpuCulling();
+		void prepareCullPipelines();
+		void prepareHiZ();
+		void destroyHiZ();
+		void recordCulling(VkCommandBuffer cmdBuffer);
+		void recordIndirectDraws(VkCommandBuffer cmdBuffer, VkExtent2D size, VkBuffer vertexBuffer);
+		void recordHiZBuild(VkCommandBuffer cmdBuffer, VkExtent2D size);
+
+		bool isVisibilityBufferSupported() const;
+		void prepareVisibilityRenderpass();
+		void prepareVisibilityResolve();
+		void updateResolveDescriptorSet(VkBuffer vertexBuffer);
+		void recordVisibilityResolve(VkCommandBuffer cmdBuffer, VkExtent2D size);
+
 		virtual void draw(const VkCommandBuffer*& out_commandBuffers, uint32_t& out_commandBufferCount) override;
 		virtual void cleanUp() override;
+		virtual void updateUniformBuffer() override;
+		virtual void onAttachmentsChanged() override;
 	};
 }
 
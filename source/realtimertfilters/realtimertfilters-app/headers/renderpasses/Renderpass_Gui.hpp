@@ -18,9 +18,11 @@ namespace rtf
 		Attachment m_AttachmentId{};
 		FrameBufferAttachment* m_Attachment = nullptr;
 		std::string m_Displayname = "Generic Attachment";
+		// Written at output resolution, not at the dynamic resolution render size
+		bool m_OutputResolution = false;
 
 		GuiAttachmentBinding() = default;
-		GuiAttachmentBinding(Attachment attachmentId, const std::string& display) : m_AttachmentId(attachmentId), m_Displayname(display) {}
+		GuiAttachmentBinding(Attachment attachmentId, const std::string& display, bool outputResolution = false) : m_AttachmentId(attachmentId), m_Displayname(display), m_OutputResolution(outputResolution) {}
 	};
 
 	/// <summary>
@@ -37,6 +39,7 @@ namespace rtf
 
 		std::vector<GuiAttachmentBinding> m_attachments{};
 		std::vector<std::string> m_dropoutOptions{};
+		uint32_t m_outputResolutionMask = 0;
 
 
 		vkglTF::Model* m_Scene = nullptr;
@@ -54,6 +57,7 @@ namespace rtf
 		void setupDescriptorSetLayout();
 		void setupDescriptorPool();
 		void setupDescriptorSet();
+		void writeAttachmentDescriptors();
 
 		void prepareRenderpass();
 		void preparePipelines();
@@ -65,11 +69,13 @@ namespace rtf
 
 		void setAttachmentBindings(std::vector<GuiAttachmentBinding> attachmentBindings);
 		inline std::vector<std::string>& getDropoutOptions() { return m_dropoutOptions; }
+		inline uint32_t getOutputResolutionMask() const { return m_outputResolutionMask; }
 
 		void buildCommandBuffer();
 		virtual void prepare() override;
 		virtual void draw(const VkCommandBuffer*& out_commandBuffers, uint32_t& out_commandBufferCount) override;
 		virtual void cleanUp() override;
+		virtual void onAttachmentsChanged() override;
 	};
 }
 
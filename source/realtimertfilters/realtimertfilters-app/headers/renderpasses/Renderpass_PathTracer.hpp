@@ -19,6 +19,12 @@ namespace rtf
 		void prepare() override;
 		void draw(const VkCommandBuffer*& out_commandBuffers, uint32_t& out_commandBufferCount) override;
 		void cleanUp() override;
+		void updateUniformBuffer() override;
+		void onAttachmentsChanged() override;
+
+		// Scene resources shared with the passes that trace or sample lights on their own
+		VkAccelerationStructureKHR getTopLevelAccelerationStructure() const { return m_topLevelAS.handle; }
+		VkBuffer getLightBuffer() const { return m_light_buffer.buffer; }
 
 	protected:
 		// Init 
@@ -27,22 +33,42 @@ namespace rtf
 		
 		// Build
 		void buildCommandBuffer();
+		virtual void recordTrace(VkCommandBuffer commandBuffer);
 		
 		// Create Methods
 		void createStorageImage(VkFormat format, VkExtent3D extent);
 		//void createUniformBuffer();
-		void createRayTracingPipeline();
-		void createShaderBindingTables();
+		void createPipelineLayout(VkShaderStageFlags raygenStages, VkShaderStageFlags hitStages, VkShaderStageFlags missStages);
+		virtual void createRayTracingPipeline();
+		virtual void createShaderBindingTables();
 		void createShaderBindingTable(ShaderBindingTable& table, uint32_t);
 		void createDescriptorSets();
+		void writeAttachmentDescriptors();
 		void createDescriptorImageInfos();
-		void createMaterialBuffer();
+		void createLightBuffer();
+		void createBlueNoiseTexture();
 		ScratchBuffer createScratchBuffer(VkDeviceSize);
 
 		void createAccelerationStructure(AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo);
 		void createBottomLevelAccelerationStructure();
+		void compactBottomLevelAccelerationStructures(VkQueryPool queryPool, const std::vector<uint32_t>& blasIndices);
+		// Acceleration structure cache, keyed by the scene cache key
+		std::string getAccelerationStructureCacheFilename();
+		bool loadBottomLevelAccelerationStructures();
+		void saveBottomLevelAccelerationStructures();
 		void createTopLevelAccelerationStructure();
 
+		// Bottom level acceleration structure updates (skinned meshes)
+		VkAccelerationStructureGeometryKHR getBottomLevelGeometry();
+		VkBuildAccelerationStructureFlagsKHR getBottomLevelBuildFlags(const BottomLevelInstance& blas);
+		void updateBottomLevelAccelerationStructures(VkCommandBuffer commandBuffer);
+
+		// Top level acceleration structure updates
+		VkAccelerationStructureGeometryKHR getTopLevelGeometry();
+		void updateInstances();
+		void buildTopLevelAccelerationStructure(VkCommandBuffer commandBuffer, VkBuildAccelerationStructureModeKHR mode);
+		void updateTopLevelAccelerationStructure(VkCommandBuffer commandBuffer);
+
 		// Delete methods
 		void deleteStorageImage();
 		void deleteScratchBuffer(ScratchBuffer&);
@@ -50,16 +76,22 @@ namespace rtf
 
 		void updatePushConstants();
 
+		// Light sampling
+		void updateLights();
+		static void buildLightAliasTable(std::vector<S_SceneLight>& lights, const std::vector<float>& weights);
+
 		// Helper 
 		VkStridedDeviceAddressRegionKHR getSbtEntryStridedDeviceAddressRegion(VkBuffer, uint32_t);
 		//VkPhysicalDeviceAccelerationStructureFeaturesKHR* getEnabledFeatures();
-		void handleResize(uint32_t width, uint32_t height);
 		uint64_t getBufferDeviceAddress(VkBuffer buffer);
+		VkBuffer getSceneVertexBuffer();
 		
 	private:
-		FrameBufferAttachment* m_Rtoutput, *m_Direct, *m_Indirect;
+		FrameBufferAttachment* m_Rtoutput, *m_Direct, *m_Indirect, *m_SampleBudget, *m_IndirectReduced;
 		float m_timer{};
 		VkCommandBuffer m_commandBuffer{};
+		bool m_dynamicTopLevelAS = false;
+		bool m_skinnedBottomLevelAS = false;
 	};
 }
 
@@ -0,0 +1,25 @@
+#ifndef Renderpass_PTRayQuery_h
+#define Renderpass_PTRayQuery_h
+
+#include "Renderpass_PathTracer.hpp"
+
+namespace rtf
+{
+	/// <summary>
+	/// Path tracer backend tracing inline with ray queries from a compute shader.
+	/// Shares acceleration structures, descriptors and the path tracing loop with the ray tracing pipeline backend,
+	/// but needs neither a shader binding table nor VK_KHR_ray_tracing_pipeline.
+	/// </summary>
+	class RenderpassPathTracerRayQuery : public RenderpassPathTracer
+	{
+	public:
+		RenderpassPathTracerRayQuery() {}
+
+	protected:
+		void createRayTracingPipeline() override;
+		void createShaderBindingTables() override;
+		void recordTrace(VkCommandBuffer commandBuffer) override;
+	};
+}
+
+#endif //Renderpass_PTRayQuery_h
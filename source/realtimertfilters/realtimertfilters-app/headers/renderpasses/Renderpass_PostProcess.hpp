@@ -21,9 +21,13 @@ namespace rtf
 		void Push_PastRenderpass_BufferCopy(Attachment sourceAttachment, Attachment destinationAttachment);
 		void PushUBO(const UBOPtr& ubo);
 
+		// Render at the full attachment size instead of the (dynamic) render size, e.g. for upscaling
+		bool m_OutputResolution = false;
+
 		virtual void prepare() override;
 		virtual void draw(const VkCommandBuffer*& out_commandBuffers, uint32_t& out_commandBufferCount) override;
 		virtual void cleanUp() override;
+		virtual void onAttachmentsChanged() override;
 
 		/// <summary>
 		/// Manages static information to be used by all postprocess renderpasses
@@ -61,6 +65,11 @@ namespace rtf
 
 		VkFramebuffer m_Framebuffer = nullptr;
 		VkCommandBuffer m_CmdBuffer = nullptr;
+		// Size the command buffer was recorded for
+		VkExtent2D m_RecordedSize{};
+		// Dynamic resolution render size of the last frame, a change resets the temporal histories for one frame
+		VkExtent2D m_LastRenderSize{};
+		bool m_HistoryReset = false;
 
 		// [0] = Attachments/Storage Images, [1] = UBOs
 		uint32_t DESCRIPTORSET_IMAGES = 0;
@@ -72,6 +81,7 @@ namespace rtf
 		{
 			uint32_t SCR_WIDTH = 0;
 			uint32_t SCR_HEIGHT = 0;
+			uint32_t HISTORY_RESET = 0;
 		};
 		PushConstantsContainer m_PushConstants{};
 
@@ -82,6 +92,7 @@ namespace rtf
 		virtual void setupPipeline();
 		virtual void setupFramebuffer();
 		virtual void buildCommandBuffer();
+		VkExtent2D getRenderSize() const;
 
 		std::vector<UBOPtr> m_UBOs{};
 		inline size_t getUboCount() { return m_UBOs.size(); }
@@ -0,0 +1,57 @@
+#ifndef Renderpass_RestirDI_h
+#define Renderpass_RestirDI_h
+
+#include "Renderpass.hpp"
+#include "../VulkanglTFModel.h"
+#include "../../data/shaders/glsl/ubo_definitions.glsl"
+
+namespace rtf
+{
+	struct FrameBufferAttachment;
+
+	/// <summary>
+	/// ReSTIR DI: resamples the direct lighting of the path tracer with per pixel reservoirs, reused over time
+	/// (reprojected with the motion vectors) and between neighbouring pixels, then writes the rtdirect attachment and adds it to rtoutput.
+	/// Runs between the path tracer, which skips the primary direct light meanwhile, and the SVGF accumulation.
+	/// Traces its visibility rays with ray queries.
+	/// </summary>
+	class RenderpassRestirDI : public Renderpass
+	{
+	public:
+		RenderpassRestirDI() = default;
+		virtual ~RenderpassRestirDI() { cleanUp(); }
+
+		virtual void prepare() override;
+		virtual void draw(const VkCommandBuffer*& out_commandBuffers, uint32_t& out_commandBufferCount) override;
+		virtual void cleanUp() override;
+		virtual void onAttachmentsChanged() override;
+
+		/// <summary>
+		/// Push constant configuring the resampling
+		/// </summary>
+		SPC_RestirConfig m_config{};
+
+	protected:
+		void createReservoirBuffers();
+		void setupDescriptors();
+		void writeDescriptorSet();
+		void preparePipelines();
+		void buildCommandBuffer();
+
+		FrameBufferAttachment* m_Direct = nullptr;
+		VkExtent2D m_Size{};
+
+		// Final reservoirs of the last frame, and the output of the temporal pass
+		vks::Buffer m_Reservoirs{};
+		vks::Buffer m_TemporalReservoirs{};
+		// Render size the reservoirs were written at, they are cleared when it changes
+		VkExtent2D m_ReservoirSize{};
+
+		// m_pipeline runs initial sampling and temporal reuse, this one spatial reuse and shading
+		VkPipeline m_SpatialPipeline = VK_NULL_HANDLE;
+
+		VkCommandBuffer m_CmdBuffer = nullptr;
+	};
+}
+
+#endif //Renderpass_RestirDI_h
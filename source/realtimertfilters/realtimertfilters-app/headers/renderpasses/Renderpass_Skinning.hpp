@@ -0,0 +1,64 @@
+#ifndef Renderpass_Skinning_h
+#define Renderpass_Skinning_h
+
+#include "Renderpass.hpp"
+#include "../VulkanglTFModel.h"
+#include "../../data/shaders/glsl/ubo_definitions.glsl"
+
+namespace rtf
+{
+	/// <summary>
+	/// Compute pass skinning all skinned primitives of the scene into an animated copy of the vertex buffer.
+	/// The G-buffer rasterizes from this buffer and the path tracer refits its skinned BLASes from it.
+	/// Before a vertex is overwritten, its position is moved to a second copy holding the previous frame's pose.
+	/// If the scene has no skins, no buffer is created and the scene vertex buffer is used directly.
+	/// </summary>
+	class RenderpassSkinning : public Renderpass
+	{
+	public:
+		RenderpassSkinning() = default;
+		virtual ~RenderpassSkinning() { cleanUp(); }
+
+		virtual void prepare() override;
+		virtual void draw(const VkCommandBuffer*& out_commandBuffers, uint32_t& out_commandBufferCount) override;
+		virtual void cleanUp() override;
+		virtual void updateUniformBuffer() override;
+
+		/// <summary>
+		/// Vertex buffer holding the current (skinned) pose of the scene
+		/// </summary>
+		VkBuffer getVertexBuffer() const;
+		/// <summary>
+		/// Vertex buffer holding the pose of the previous frame, for motion vectors
+		/// </summary>
+		VkBuffer getPreviousVertexBuffer() const;
+		inline bool isActive() const { return !m_SkinnedNodes.empty(); }
+
+	protected:
+		struct SkinnedNode
+		{
+			vkglTF::Node* node = nullptr;
+			uint32_t jointOffset = 0;
+		};
+
+		void createBuffers();
+		void setupDescriptors();
+		void preparePipeline();
+		void buildCommandBuffer();
+
+		vkglTF::Model* m_Scene = nullptr;
+		std::vector<SkinnedNode> m_SkinnedNodes{};
+		uint32_t m_JointCount = 0;
+
+		// Animated copy of the scene vertex buffer
+		vks::Buffer m_AnimatedVertices{};
+		// Copy of the scene vertex buffer whose positions trail m_AnimatedVertices by one frame
+		vks::Buffer m_PreviousVertices{};
+		// Joint matrices of all skins, rewritten every frame
+		vks::Buffer m_JointMatrices{};
+
+		VkCommandBuffer m_CmdBuffer = nullptr;
+	};
+}
+
+#endif //Renderpass_Skinning_h
@@ -1,9 +1,10 @@
 #include "../headers/Attachment_Manager.hpp"
+#include <algorithm>
 
 namespace rtf
 {
 	Attachment_Manager::Attachment_Manager(vks::VulkanDevice* vulkanDevice, VkQueue graphicsQueue, uint32_t width, uint32_t height)
-		: m_size{ width, height }, m_vulkanDevice(vulkanDevice), m_queue(graphicsQueue)
+		: m_size{ width, height }, m_renderSize{ width, height }, m_vulkanDevice(vulkanDevice), m_queue(graphicsQueue)
 	{
 		//create neccessary Attachments
 		createAllAttachments();
@@ -58,9 +59,19 @@ namespace rtf
 			return;
 		}
 		m_size = newsize;
+		setRenderScale(m_renderScale);
+		// Renderpasses have to rebind the new images via Renderpass::onAttachmentsChanged
+		destroyAllAttachments();
 		createAllAttachments();
 	}
 
+	void Attachment_Manager::setRenderScale(float scale)
+	{
+		m_renderScale = std::min(std::max(scale, 0.0f), 1.0f);
+		m_renderSize.width = std::max(1U, static_cast<uint32_t>(m_size.width * m_renderScale + 0.5f));
+		m_renderSize.height = std::max(1U, static_cast<uint32_t>(m_size.height * m_renderScale + 0.5f));
+	}
+
 	// Create a frame buffer attachment
 	void Attachment_Manager::createAttachment(VkCommandBuffer cmdBuffer, const AttachmentInitInfo& initInfo, FrameBufferAttachment* attachment)
 	{
@@ -86,7 +97,8 @@ namespace rtf
 		VkExtent3D extent;
 		if (initInfo.m_Size.width == 0 || initInfo.m_Size.height == 0)
 		{
-			extent = VkExtent3D{ m_size.width, m_size.height, 1 };
+			const VkExtent2D& divisor = initInfo.m_SizeDivisor;
+			extent = VkExtent3D{ (m_size.width + divisor.width - 1) / divisor.width, (m_size.height + divisor.height - 1) / divisor.height, 1 };
 		}
 		else
 		{
@@ -145,5 +157,8 @@ namespace rtf
 		vkDestroyImageView(m_vulkanDevice->logicalDevice, attachment->view, nullptr);
 		vkDestroyImage(m_vulkanDevice->logicalDevice, attachment->image, nullptr);
 		vkFreeMemory(m_vulkanDevice->logicalDevice, attachment->mem, nullptr);
+		attachment->view = VK_NULL_HANDLE;
+		attachment->image = VK_NULL_HANDLE;
+		attachment->mem = VK_NULL_HANDLE;
 	}
 }
@@ -0,0 +1,175 @@
+#include "../headers/BlueNoise.hpp"
+
+#include <cmath>
+#include <random>
+
+namespace rtf
+{
+	namespace
+	{
+		/// <summary>
+		/// Energy of a binary pattern, the sum of a gaussian around every set pixel with wrap around
+		/// </summary>
+		class EnergyField
+		{
+		public:
+			EnergyField(uint32_t size) : m_Size(size), m_Energy(size * size, 0.0f)
+			{
+				// Beyond 3 sigma the gaussian is negligible, so updates only touch a window around the pixel
+				const float sigma = 1.9f;
+				m_Radius = static_cast<int32_t>(std::ceil(3.0f * sigma));
+				const int32_t width = 2 * m_Radius + 1;
+				m_Kernel.resize(width * width);
+				for (int32_t y = -m_Radius; y <= m_Radius; y++)
+				{
+					for (int32_t x = -m_Radius; x <= m_Radius; x++)
+					{
+						m_Kernel[(y + m_Radius) * width + x + m_Radius] = std::exp(-static_cast<float>(x * x + y * y) / (2.0f * sigma * sigma));
+					}
+				}
+			}
+
+			void splat(uint32_t index, float sign)
+			{
+				const int32_t size = static_cast<int32_t>(m_Size);
+				const int32_t px = static_cast<int32_t>(index % m_Size);
+				const int32_t py = static_cast<int32_t>(index / m_Size);
+				const int32_t width = 2 * m_Radius + 1;
+				for (int32_t y = -m_Radius; y <= m_Radius; y++)
+				{
+					const int32_t wy = (py + y + size) % size;
+					for (int32_t x = -m_Radius; x <= m_Radius; x++)
+					{
+						const int32_t wx = (px + x + size) % size;
+						m_Energy[wy * size + wx] += sign * m_Kernel[(y + m_Radius) * width + x + m_Radius];
+					}
+				}
+			}
+
+			// Set pixel with the highest energy
+			uint32_t tightestCluster(const std::vector<uint8_t>& pattern) const
+			{
+				uint32_t best = 0;
+				float bestEnergy = -1.0f;
+				for (uint32_t i = 0; i < m_Energy.size(); i++)
+				{
+					if (pattern[i] && m_Energy[i] > bestEnergy)
+					{
+						bestEnergy = m_Energy[i];
+						best = i;
+					}
+				}
+				return best;
+			}
+
+			// Empty pixel with the lowest energy
+			uint32_t largestVoid(const std::vector<uint8_t>& pattern) const
+			{
+				uint32_t best = 0;
+				float bestEnergy = INFINITY;
+				for (uint32_t i = 0; i < m_Energy.size(); i++)
+				{
+					if (!pattern[i] && m_Energy[i] < bestEnergy)
+					{
+						bestEnergy = m_Energy[i];
+						best = i;
+					}
+				}
+				return best;
+			}
+
+		private:
+			uint32_t m_Size;
+			int32_t m_Radius;
+			std::vector<float> m_Kernel;
+			std::vector<float> m_Energy;
+		};
+	}
+
+	std::vector<uint8_t> BlueNoise::generateTile(uint32_t size, uint32_t seed)
+	{
+		const uint32_t pixelCount = size * size;
+		const uint32_t initialCount = pixelCount / 10;
+
+		// Random initial pattern
+		std::mt19937 random(seed);
+		std::uniform_int_distribution<uint32_t> distribution(0, pixelCount - 1);
+		std::vector<uint8_t> pattern(pixelCount, 0);
+		EnergyField energy(size);
+		for (uint32_t count = 0; count < initialCount;)
+		{
+			uint32_t index = distribution(random);
+			if (!pattern[index])
+			{
+				pattern[index] = 1;
+				energy.splat(index, 1.0f);
+				count++;
+			}
+		}
+
+		// Move the tightest cluster into the largest void until that no longer changes the pattern
+		for (uint32_t iteration = 0; iteration < pixelCount; iteration++)
+		{
+			uint32_t cluster = energy.tightestCluster(pattern);
+			pattern[cluster] = 0;
+			energy.splat(cluster, -1.0f);
+			uint32_t gap = energy.largestVoid(pattern);
+			pattern[gap] = 1;
+			energy.splat(gap, 1.0f);
+			if (gap == cluster)
+			{
+				break;
+			}
+		}
+
+		std::vector<uint32_t> ranks(pixelCount, 0);
+
+		// Phase 1: rank the initial pattern by removing its tightest clusters
+		{
+			std::vector<uint8_t> prototype = pattern;
+			EnergyField prototypeEnergy = energy;
+			for (uint32_t rank = initialCount; rank > 0; rank--)
+			{
+				uint32_t cluster = prototypeEnergy.tightestCluster(prototype);
+				prototype[cluster] = 0;
+				prototypeEnergy.splat(cluster, -1.0f);
+				ranks[cluster] = rank - 1;
+			}
+		}
+
+		// Phase 2 and 3: fill the largest voids. The energy of the inverted pattern is a constant minus this one,
+		// so its tightest cluster is the largest void here and both phases reduce to the same step
+		for (uint32_t rank = initialCount; rank < pixelCount; rank++)
+		{
+			uint32_t gap = energy.largestVoid(pattern);
+			pattern[gap] = 1;
+			energy.splat(gap, 1.0f);
+			ranks[gap] = rank;
+		}
+
+		std::vector<uint8_t> tile(pixelCount);
+		for (uint32_t i = 0; i < pixelCount; i++)
+		{
+			tile[i] = static_cast<uint8_t>((ranks[i] * 256) / pixelCount);
+		}
+		return tile;
+	}
+
+	std::vector<uint8_t> BlueNoise::generateTextureArray(uint32_t size, uint32_t layerCount, uint32_t channelCount)
+	{
+		const uint32_t pixelCount = size * size;
+		std::vector<uint8_t> data(static_cast<size_t>(pixelCount) * layerCount * channelCount);
+		for (uint32_t layer = 0; layer < layerCount; layer++)
+		{
+			for (uint32_t channel = 0; channel < channelCount; channel++)
+			{
+				std::vector<uint8_t> tile = generateTile(size, layer * channelCount + channel + 1);
+				for (uint32_t i = 0; i < pixelCount; i++)
+				{
+					data[(static_cast<size_t>(layer) * pixelCount + i) * channelCount + channel] = tile[i];
+				}
+			}
+		}
+		return data;
+	}
+}
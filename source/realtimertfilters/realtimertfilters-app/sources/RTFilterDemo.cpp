@@ -13,6 +13,7 @@
 //All Filter render passes here
 #include "../headers/renderpasses/Renderpass_PostProcess.hpp"
 #include "../headers/renderpasses/Renderpass_PathTracer.hpp"
+#include "../headers/renderpasses/Renderpass_RestirDI.hpp"
 
 namespace rtf
 {
@@ -39,6 +40,9 @@ namespace rtf
 		enabledInstanceExtensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
 		apiVersion = VK_API_VERSION_1_2;
 
+		m_useRayQueryPathTracer = commandLineParser.isSet("rayquery");
+		m_compressTextures = commandLineParser.isSet("compresstextures");
+
 		enableExtensions(enabledDeviceExtensions);
 
 #ifdef _WIN32
@@ -70,24 +74,46 @@ namespace rtf
 		{
 			enabledFeatures.vertexPipelineStoresAndAtomics = VK_TRUE;
 		}
+		// Optional, the G-buffer falls back to CPU recorded draws without GPU culling
+		if (deviceFeatures.multiDrawIndirect)
+		{
+			enabledFeatures.multiDrawIndirect = VK_TRUE;
+		}
+		if (deviceFeatures.drawIndirectFirstInstance)
+		{
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+		}
+		// Block compressed scene textures, see vkglTF::FileLoadingFlags::CompressTextures
+		if (deviceFeatures.textureCompressionBC)
+		{
+			enabledFeatures.textureCompressionBC = VK_TRUE;
+		}
+		if (deviceFeatures.textureCompressionASTC_LDR)
+		{
+			enabledFeatures.textureCompressionASTC_LDR = VK_TRUE;
+		}
+		if (deviceFeatures.textureCompressionETC2)
+		{
+			enabledFeatures.textureCompressionETC2 = VK_TRUE;
+		}
+		// Optional, the visibility buffer reads gl_PrimitiveID in the fragment shader
+		if (deviceFeatures.geometryShader)
+		{
+			enabledFeatures.geometryShader = VK_TRUE;
+		}
 
 		deviceCreatepNextChain = getEnabledFeaturesRayTracing();
 	}
 
 	VkPhysicalDeviceAccelerationStructureFeaturesKHR* RTFilterDemo::getEnabledFeaturesRayTracing()
 	{
-		// Get properties and features for Ray Tracer
-		rayTracingPipelineProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
-		rayTracingPipelineProperties.pNext = nullptr;
-		VkPhysicalDeviceProperties2 deviceProperties2{};
-		deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
-		deviceProperties2.pNext = &rayTracingPipelineProperties;
-		vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
-
+		// Get features for Ray Tracer
 		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
 		vulkan12Features.pNext = nullptr;
+		rayQueryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR;
+		rayQueryFeatures.pNext = &vulkan12Features;
 		rayTracingPipelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
-		rayTracingPipelineFeatures.pNext = &vulkan12Features;
+		rayTracingPipelineFeatures.pNext = &rayQueryFeatures;
 		accelerationStructureFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
 		accelerationStructureFeatures.pNext = &rayTracingPipelineFeatures;
 
@@ -120,16 +146,49 @@ namespace rtf
 		enabledPhysicalDeviceVulkan12Features.descriptorIndexing = VK_TRUE;
 		enabledPhysicalDeviceVulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
 		enabledPhysicalDeviceVulkan12Features.separateDepthStencilLayouts = VK_TRUE;
+		enabledPhysicalDeviceVulkan12Features.drawIndirectCount = vulkan12Features.drawIndirectCount;
 		enabledPhysicalDeviceVulkan12Features.pNext = nullptr;
 
+		if (rayTracingPipelineFeatures.rayTracingPipeline != VK_TRUE && rayQueryFeatures.rayQuery != VK_TRUE)
+		{
+			throw std::runtime_error("RTFilterDemo::getEnabledFeaturesRayTracing: missing rayTracingPipeline and rayQuery feature");
+		}
 		if (rayTracingPipelineFeatures.rayTracingPipeline != VK_TRUE)
 		{
-			throw std::runtime_error("RTFilterDemo::getEnabledFeaturesRayTracing: missing rayTracingPipeline feature");
+			std::cout << "Ray tracing pipeline not supported, falling back to ray queries" << std::endl;
+			m_useRayQueryPathTracer = true;
+		}
+		else if (rayQueryFeatures.rayQuery != VK_TRUE)
+		{
+			m_useRayQueryPathTracer = false;
 		}
 
-		enabledRayTracingPipelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
-		enabledRayTracingPipelineFeatures.rayTracingPipeline = VK_TRUE;
-		enabledRayTracingPipelineFeatures.pNext = &enabledPhysicalDeviceVulkan12Features;
+		// The pipeline extension is only enabled for its backend, ray queries whenever supported (ReSTIR DI traces with them)
+		void* pNextTracing = &enabledPhysicalDeviceVulkan12Features;
+		if (rayQueryFeatures.rayQuery == VK_TRUE)
+		{
+			enabledRayQueryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR;
+			enabledRayQueryFeatures.rayQuery = VK_TRUE;
+			enabledRayQueryFeatures.pNext = pNextTracing;
+			pNextTracing = &enabledRayQueryFeatures;
+			enabledDeviceExtensions.push_back(VK_KHR_RAY_QUERY_EXTENSION_NAME);
+		}
+		if (!m_useRayQueryPathTracer)
+		{
+			// Shader group handle sizes for the shader binding table
+			rayTracingPipelineProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
+			rayTracingPipelineProperties.pNext = nullptr;
+			VkPhysicalDeviceProperties2 deviceProperties2{};
+			deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			deviceProperties2.pNext = &rayTracingPipelineProperties;
+			vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+
+			enabledRayTracingPipelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
+			enabledRayTracingPipelineFeatures.rayTracingPipeline = VK_TRUE;
+			enabledRayTracingPipelineFeatures.pNext = pNextTracing;
+			pNextTracing = &enabledRayTracingPipelineFeatures;
+			enabledDeviceExtensions.push_back(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME);
+		}
 
 		if (accelerationStructureFeatures.accelerationStructure != VK_TRUE)
 		{
@@ -138,7 +197,7 @@ namespace rtf
 
 		enabledAccelerationStructureFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
 		enabledAccelerationStructureFeatures.accelerationStructure = VK_TRUE;
-		enabledAccelerationStructureFeatures.pNext = &enabledRayTracingPipelineFeatures;
+		enabledAccelerationStructureFeatures.pNext = pNextTracing;
 
 		return &enabledAccelerationStructureFeatures;
 	}
@@ -147,15 +206,15 @@ namespace rtf
 	{
 		// Ray tracing related extensions required by this sample
 
+		// VK_KHR_ray_tracing_pipeline or VK_KHR_ray_query is added by getEnabledFeaturesRayTracing depending on the path tracer backend
 		enabledDeviceExtensions.push_back(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME);
-		enabledDeviceExtensions.push_back(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME);
 
 		// Required by VK_KHR_acceleration_structure
 		enabledDeviceExtensions.push_back(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
 		enabledDeviceExtensions.push_back(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
 		enabledDeviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
 
-		// Required for VK_KHR_ray_tracing_pipeline
+		// Required for VK_KHR_ray_tracing_pipeline and VK_KHR_ray_query
 		enabledDeviceExtensions.push_back(VK_KHR_SPIRV_1_4_EXTENSION_NAME);
 
 		// Required by VK_KHR_spirv_1_4
@@ -216,13 +275,16 @@ namespace rtf
 	void RTFilterDemo::loadAssets()
 	{
 
-		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
+		uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
+		if (m_compressTextures)
+		{
+			glTFLoadingFlags |= vkglTF::FileLoadingFlags::CompressTextures;
+		}
 
 		// raytracing: we need to set additional buffer creation flags, before loading the scene:
 		// Instead of a simple triangle, we'll be loading a more complex scene for this example
 		// The shaders are accessing the vertex and index buffers of the scene, so the proper usage flag has to be set on the vertex and index buffers for the scene
 		vkglTF::memoryPropertyFlags = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-		vkglTF::descriptorBindingFlags |= vkglTF::DescriptorBindingFlags::ImageNormalMap;
 
 		//m_Scene.loadFromFile(getAssetPath() + "glTF-Sample-Models/2.0/Sponza/glTF/Sponza.gltf", vulkanDevice, queue, glTFLoadingFlags);
 		m_Scene.loadFromFile(getAssetPath() + MODEL_NAME, vulkanDevice, queue, glTFLoadingFlags);
@@ -244,6 +306,8 @@ namespace rtf
 	{
 		if (!prepared)
 			return;
+		updateSceneAnimation();
+		updateDynamicResolution();
 		updateUBOs();
 		m_renderpassManager->updateUniformBuffer();
 
@@ -258,12 +322,12 @@ namespace rtf
 
 	void RTFilterDemo::windowResized()
 	{
-		// update attachment manager width height
+		// update attachment manager width height, the base class already waited for the device to be idle
 		m_attachmentManager->resize({width, height});
-		// rebuild command buffer
-		m_renderpassManager->m_RPG_Active->prepare();
+		// rebind the new attachments, pipelines and scene resources are kept
+		m_renderpassManager->onAttachmentsChanged();
+		// the gui records into the swapchain command buffers, only the active one may rebuild them
 		m_renderpassManager->m_RPG_Active->buildCommandBuffer();
-		m_renderpassManager->prepare(this, m_semaphoreCount);
 	}
 
 	void RTFilterDemo::setupUBOs()
@@ -299,6 +363,15 @@ namespace rtf
 		m_UBO_BMFRConfig = std::make_shared<ManagedUBO<S_BMFRConfig>>(vulkanDevice);
 		m_UBO_BMFRConfig->prepare();
 
+		m_UBO_AdaptiveSamplingConfig = std::make_shared<ManagedUBO<S_AdaptiveSamplingConfig>>(vulkanDevice);
+		m_UBO_AdaptiveSamplingConfig->prepare();
+
+		m_UBO_ReducedIndirectConfig = std::make_shared<ManagedUBO<S_ReducedIndirectConfig>>(vulkanDevice);
+		m_UBO_ReducedIndirectConfig->prepare();
+
+		m_UBO_DynamicResolutionConfig = std::make_shared<ManagedUBO<S_DynamicResolutionConfig>>(vulkanDevice);
+		m_UBO_DynamicResolutionConfig->prepare();
+
 		updateUBOs();
 	}
 
@@ -330,11 +403,73 @@ namespace rtf
 		m_UBO_Guibase->UBO().WindowHeight = height;
 		m_UBO_Guibase->UBO().WindowWidth = width;
 
+		// Attachments rendered at the dynamic resolution render size are scaled up for display
+		VkExtent2D attachmentSize = m_attachmentManager->GetSize();
+		VkExtent2D renderSize = m_attachmentManager->GetRenderSize();
+		m_UBO_Guibase->UBO().RenderScaleX = static_cast<float>(renderSize.width) / attachmentSize.width;
+		m_UBO_Guibase->UBO().RenderScaleY = static_cast<float>(renderSize.height) / attachmentSize.height;
+		m_UBO_Guibase->UBO().OutputResolutionMask = m_renderpassManager->m_RPG_Active ? m_renderpassManager->m_RPG_Active->getOutputResolutionMask() : 0;
+		m_UBO_DynamicResolutionConfig->UBO().RenderWidth = static_cast<int>(renderSize.width);
+		m_UBO_DynamicResolutionConfig->UBO().RenderHeight = static_cast<int>(renderSize.height);
+
 		m_UBO_SceneInfo->update();
 		m_UBO_Guibase->update();
 		m_UBO_AccuConfig->update();
 		m_UBO_AtrousConfig->update();
 		m_UBO_BMFRConfig->update();
+		m_UBO_AdaptiveSamplingConfig->update();
+		m_UBO_ReducedIndirectConfig->update();
+		m_UBO_DynamicResolutionConfig->update();
+	}
+
+	void RTFilterDemo::updateSceneAnimation()
+	{
+		if (!m_animateScene || m_Scene.animations.empty())
+		{
+			return;
+		}
+		const vkglTF::Animation& animation = m_Scene.animations[0];
+		m_animationTime += frameTimer;
+		if (m_animationTime > animation.end)
+		{
+			m_animationTime -= animation.end;
+		}
+		// Updates the node matrices, the path tracer refits its TLAS and the G-buffer its node instances from them
+		m_Scene.updateAnimation(0, m_animationTime);
+	}
+
+	void RTFilterDemo::updateDynamicResolution()
+	{
+		// Only the SVGF queue ends in the temporal upscaling
+		const S_DynamicResolutionConfig& config = m_UBO_DynamicResolutionConfig->UBO();
+		if (!config.EnableDynamicResolution || m_renderpassManager->m_QT_Active != m_renderpassManager->m_QT_SVGF)
+		{
+			m_smoothedFrameTime = config.TargetFrameTime;
+			m_attachmentManager->setRenderScale(1.0f);
+			return;
+		}
+
+		// Smoothed so single slow frames do not change the resolution
+		m_smoothedFrameTime += (frameTimer * 1000.0f - m_smoothedFrameTime) * 0.1f;
+
+		// Keep the scale within a band around the budget, changes take a few frames to show in the frame time
+		const float scale = m_attachmentManager->GetRenderScale();
+		if (m_smoothedFrameTime < config.TargetFrameTime * 1.05f && m_smoothedFrameTime > config.TargetFrameTime * 0.85f)
+		{
+			return;
+		}
+
+		// Frame time grows roughly with the pixel count, i.e. with the square of the scale.
+		// Steps of 1/32 avoid re-recording the command buffers for tiny changes
+		float targetScale = scale * std::sqrt(config.TargetFrameTime / std::max(m_smoothedFrameTime, 0.1f));
+		targetScale = std::round(targetScale * 32.0f) / 32.0f;
+		targetScale = std::min(std::max(targetScale, config.MinRenderScale), 1.0f);
+		if (targetScale != scale)
+		{
+			m_attachmentManager->setRenderScale(targetScale);
+			// Wait for the new scale to take effect before judging it
+			m_smoothedFrameTime = config.TargetFrameTime;
+		}
 	}
 
 	void RTFilterDemo::OnUpdateUIOverlay(vks::UIOverlay* overlay)
@@ -397,6 +532,27 @@ namespace rtf
 		overlay->checkBox("Show Scene Controls", &m_ShowSceneControls);
 		if (m_ShowSceneControls)
 		{
+			if (!m_Scene.animations.empty())
+			{
+				overlay->checkBox("Animate Scene", &m_animateScene);
+			}
+			RenderpassGbuffer* gbuffer = m_renderpassManager->m_RP_GBuffer.get();
+			if (gbuffer->isGpuCullingSupported())
+			{
+				overlay->checkBox("GPU Culling", &gbuffer->m_GpuCulling);
+				if (gbuffer->m_GpuCulling)
+				{
+					overlay->checkBox("Occlusion Culling", &gbuffer->m_OcclusionCulling);
+				}
+			}
+			if (!gbuffer->m_GpuCulling)
+			{
+				overlay->text("Secondary Command Buffers: %u", static_cast<uint32_t>(gbuffer->m_SecondaryCmdBuffers.size()));
+			}
+			if (gbuffer->isVisibilityBufferSupported())
+			{
+				overlay->checkBox("Visibility Buffer", &gbuffer->m_VisibilityBuffer);
+			}
 			if (overlay->sliderInt("Light Sources", &m_enabledLightCount, 1, UBO_SCENEINFO_LIGHT_COUNT))
 			{
 				for (int i = 0; i < UBO_SCENEINFO_LIGHT_COUNT; i++)
@@ -456,15 +612,86 @@ namespace rtf
 		if (m_ShowPathtracerControls)
 		{
 			SPC_PathtracerConfig& pathtracerConfig = m_renderpassManager->m_RP_PT->m_pathtracerconfig;
+			S_AdaptiveSamplingConfig& adaptiveConfig = m_UBO_AdaptiveSamplingConfig->UBO();
 			int32_t samplesPerPixel = static_cast<int32_t>(pathtracerConfig.PrimarySamplesPerPixel);
 			int32_t bounceDepth = static_cast<int32_t>(pathtracerConfig.MaxBounceDepth);
 			int32_t samplesPerBounce = static_cast<int32_t>(pathtracerConfig.SecondarySamplesPerBounce);
-			overlay->sliderInt("Samples per Pixel", &samplesPerPixel, 1, 16);
+			int32_t samplerType = static_cast<int32_t>(pathtracerConfig.SamplerType);
+			bool hybridPrimary = pathtracerConfig.HybridPrimary != 0;
+			// The sample budget is written by the SVGF accumulation
+			if (m_renderpassManager->m_QT_Active == m_renderpassManager->m_QT_SVGF)
+			{
+				overlay->checkBox("Adaptive Sampling", &adaptiveConfig.EnableAdaptiveSampling);
+			}
+			if (adaptiveConfig.EnableAdaptiveSampling && m_renderpassManager->m_QT_Active == m_renderpassManager->m_QT_SVGF)
+			{
+				overlay->sliderFloat("Target Error", &adaptiveConfig.TargetError, 0.005f, 0.5f);
+				overlay->sliderInt("Min Samples", &adaptiveConfig.MinSamples, 1, ADAPTIVE_SAMPLING_MAX_SAMPLES);
+				overlay->sliderInt("Max Samples", &adaptiveConfig.MaxSamples, adaptiveConfig.MinSamples, ADAPTIVE_SAMPLING_MAX_SAMPLES);
+				adaptiveConfig.MaxSamples = std::max(adaptiveConfig.MaxSamples, adaptiveConfig.MinSamples);
+			}
+			else
+			{
+				overlay->sliderInt("Samples per Pixel", &samplesPerPixel, 1, 16);
+			}
 			overlay->sliderInt("Bounce Depth", &bounceDepth, 1, 6);
-			overlay->sliderInt("Samples per Bounce", &samplesPerBounce, 1, 8);
+			overlay->sliderInt("Indirect Paths", &samplesPerBounce, 1, 8);
+			overlay->comboBox("Sampler", &samplerType, { "Random", "Sobol (Owen scrambled)", "Blue Noise" });
+			overlay->checkBox("Primary Hits from G-Buffer", &hybridPrimary);
 			pathtracerConfig.PrimarySamplesPerPixel = static_cast<uint>(samplesPerPixel);
 			pathtracerConfig.MaxBounceDepth = static_cast<uint>(bounceDepth);
 			pathtracerConfig.SecondarySamplesPerBounce = static_cast<uint>(samplesPerBounce);
+			pathtracerConfig.SamplerType = static_cast<uint>(samplerType);
+			pathtracerConfig.HybridPrimary = hybridPrimary ? 1 : 0;
+
+			// The SVGF queue ends in the temporal upscaling
+			if (m_renderpassManager->m_QT_Active == m_renderpassManager->m_QT_SVGF)
+			{
+				S_DynamicResolutionConfig& dynamicResolutionConfig = m_UBO_DynamicResolutionConfig->UBO();
+				overlay->checkBox("Dynamic Resolution", &dynamicResolutionConfig.EnableDynamicResolution);
+				if (dynamicResolutionConfig.EnableDynamicResolution)
+				{
+					overlay->sliderFloat("Frame Time Budget (ms)", &dynamicResolutionConfig.TargetFrameTime, 4.0f, 100.0f);
+					overlay->sliderFloat("Min Render Scale", &dynamicResolutionConfig.MinRenderScale, 0.25f, 1.0f);
+					overlay->sliderFloat("Upscale History Weight", &dynamicResolutionConfig.HistoryWeight, 0.0f, 0.98f);
+					overlay->text("Render Scale: %.2f", m_attachmentManager->GetRenderScale());
+				}
+			}
+
+			// Reduced indirect light is upsampled in front of the SVGF accumulation
+			if (m_renderpassManager->m_QT_Active == m_renderpassManager->m_QT_SVGF)
+			{
+
+				S_ReducedIndirectConfig& reducedConfig = m_UBO_ReducedIndirectConfig->UBO();
+				if (overlay->comboBox("Indirect Resolution", &reducedConfig.IndirectMode, { "Full", "Checkerboard", "Half" }))
+				{
+					m_renderpassManager->setReducedIndirect(reducedConfig.IndirectMode != INDIRECT_MODE_FULL);
+				}
+				if (reducedConfig.IndirectMode != INDIRECT_MODE_FULL)
+				{
+					overlay->sliderFloat("Upsample Normal Power", &reducedConfig.NormalPower, 1.0f, 128.0f);
+					overlay->sliderFloat("Upsample Position Phi", &reducedConfig.PositionPhi, 0.001f, 0.1f);
+				}
+			}
+
+			// ReSTIR only runs in the SVGF queue
+			if (m_renderpassManager->m_RP_RestirDI && m_renderpassManager->m_QT_Active == m_renderpassManager->m_QT_SVGF)
+			{
+				SPC_RestirConfig& restirConfig = m_renderpassManager->m_RP_RestirDI->m_config;
+				int32_t initialCandidates = static_cast<int32_t>(restirConfig.InitialCandidates);
+				int32_t spatialNeighbours = static_cast<int32_t>(restirConfig.SpatialNeighbours);
+				bool enableTemporal = restirConfig.EnableTemporal != 0;
+				bool enableSpatial = restirConfig.EnableSpatial != 0;
+				overlay->sliderInt("ReSTIR Candidates", &initialCandidates, 1, 32);
+				overlay->checkBox("ReSTIR Temporal Reuse", &enableTemporal);
+				overlay->checkBox("ReSTIR Spatial Reuse", &enableSpatial);
+				overlay->sliderInt("ReSTIR Neighbours", &spatialNeighbours, 1, 8);
+				overlay->sliderFloat("ReSTIR Radius", &restirConfig.SpatialRadius, 1.0f, 40.0f);
+				restirConfig.InitialCandidates = static_cast<uint>(initialCandidates);
+				restirConfig.SpatialNeighbours = static_cast<uint>(spatialNeighbours);
+				restirConfig.EnableTemporal = enableTemporal ? 1 : 0;
+				restirConfig.EnableSpatial = enableSpatial ? 1 : 0;
+			}
 		}
 		if (overlay->button("Screenshot"))
 		{
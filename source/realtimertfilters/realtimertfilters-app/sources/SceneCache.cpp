@@ -0,0 +1,307 @@
+#include "../headers/SceneCache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const uint32_t CACHE_MAGIC = 0x43465452; // "RTFC"
+	// Bump whenever the cooked layout or the geometry processing of Model::loadFromFile changes
+	const uint32_t CACHE_VERSION = 4;
+	const uint64_t SECTION_ALIGNMENT = 16;
+
+	struct FileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		// Element sizes, a cache from a build with another vertex layout is rejected
+		uint32_t vertexSize;
+		uint32_t hitVertexSize;
+		uint32_t hitTriangleSize;
+		uint32_t emissiveTriangleSize;
+		uint32_t primitiveSize;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t emissiveTriangleCount;
+		uint32_t primitiveCount;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t hitVertexOffset;
+		uint64_t hitTriangleOffset;
+		uint64_t emissiveTriangleOffset;
+		uint64_t primitiveOffset;
+		uint64_t sceneOffset;
+		uint64_t sceneSize;
+		uint64_t fileSize;
+	};
+
+	uint64_t alignSection(uint64_t offset)
+	{
+		return (offset + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+	}
+
+	bool sectionInFile(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize)
+	{
+		return offset % SECTION_ALIGNMENT == 0 && offset <= fileSize && count * elementSize <= fileSize - offset;
+	}
+}
+
+vkglTF::SceneCache::~SceneCache()
+{
+	close();
+}
+
+// FNV-1a, 64 bit words at a time so hashing the glTF buffers stays cheap next to loading them
+uint64_t vkglTF::SceneCache::hashBytes(uint64_t hash, const void* data, size_t size)
+{
+	const uint64_t prime = 1099511628211ull;
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof(word));
+		hash = (hash ^ word) * prime;
+	}
+	for (; i < size; i++) {
+		hash = (hash ^ bytes[i]) * prime;
+	}
+	return hash;
+}
+
+namespace
+{
+	uint64_t hashFileIdentity(uint64_t hash, const std::filesystem::path& path)
+	{
+		std::error_code error;
+		const std::string name = path.filename().string();
+		const uint64_t size = std::filesystem::file_size(path, error);
+		const int64_t modified = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+		hash = vkglTF::SceneCache::hashBytes(hash, name.data(), name.size());
+		hash = vkglTF::SceneCache::hashBytes(hash, &size, sizeof(size));
+		return vkglTF::SceneCache::hashBytes(hash, &modified, sizeof(modified));
+	}
+}
+
+uint64_t vkglTF::SceneCache::computeKey(const std::string& filename, uint32_t fileLoadingFlags, float scale)
+{
+	// File identity instead of contents, so the key is known before anything is parsed.
+	// The buffers are referenced from the JSON, every .bin file next to the glTF file stands in for them
+	uint64_t hash = HASH_SEED;
+	const std::filesystem::path gltfPath(filename);
+	hash = hashFileIdentity(hash, gltfPath);
+	std::vector<std::filesystem::path> binaries;
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(gltfPath.parent_path().empty() ? "." : gltfPath.parent_path(), error)) {
+		if (entry.path().extension() == ".bin") {
+			binaries.push_back(entry.path());
+		}
+	}
+	// Directory iteration order is unspecified
+	std::sort(binaries.begin(), binaries.end());
+	for (const std::filesystem::path& binary : binaries) {
+		hash = hashFileIdentity(hash, binary);
+	}
+
+	// Only flags changing the geometry, image flags must not throw away the cache
+	const uint32_t geometryFlags = fileLoadingFlags & (FileLoadingFlags::PreTransformVertices | FileLoadingFlags::PreMultiplyVertexColors | FileLoadingFlags::FlipY);
+	hash = hashBytes(hash, &geometryFlags, sizeof(geometryFlags));
+	hash = hashBytes(hash, &scale, sizeof(scale));
+	return hash;
+}
+
+std::string vkglTF::SceneCache::cacheFilename(const std::string& filename)
+{
+	return filename + ".rtfcache";
+}
+
+bool vkglTF::SceneCache::write(const std::string& filename, uint64_t key, const Streams& streams)
+{
+	FileHeader header{};
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.key = key;
+	header.vertexSize = sizeof(Vertex);
+	header.hitVertexSize = sizeof(HitVertex);
+	header.hitTriangleSize = sizeof(HitTriangle);
+	header.emissiveTriangleSize = sizeof(Model::EmissiveTriangle);
+	header.primitiveSize = sizeof(Primitive);
+	header.vertexCount = streams.vertexCount;
+	header.indexCount = streams.indexCount;
+	header.emissiveTriangleCount = streams.emissiveTriangleCount;
+	header.primitiveCount = streams.primitiveCount;
+	header.sceneSize = streams.sceneSize;
+
+	struct Section {
+		uint64_t* offset;
+		const void* data;
+		uint64_t size;
+	};
+	const Section sections[] = {
+		{ &header.vertexOffset, streams.vertices, uint64_t(streams.vertexCount) * sizeof(Vertex) },
+		{ &header.indexOffset, streams.indices, uint64_t(streams.indexCount) * sizeof(uint32_t) },
+		{ &header.hitVertexOffset, streams.hitVertices, uint64_t(streams.vertexCount) * sizeof(HitVertex) },
+		{ &header.hitTriangleOffset, streams.hitTriangles, uint64_t(streams.indexCount / 3) * sizeof(HitTriangle) },
+		{ &header.emissiveTriangleOffset, streams.emissiveTriangles, uint64_t(streams.emissiveTriangleCount) * sizeof(Model::EmissiveTriangle) },
+		{ &header.primitiveOffset, streams.primitives, uint64_t(streams.primitiveCount) * sizeof(Primitive) },
+		{ &header.sceneOffset, streams.scene, streams.sceneSize },
+	};
+	uint64_t offset = alignSection(sizeof(FileHeader));
+	for (const Section& section : sections) {
+		*section.offset = offset;
+		offset = alignSection(offset + section.size);
+	}
+	header.fileSize = offset;
+
+	// Written under a temporary name, so an interrupted write never leaves a truncated cache behind
+	const std::string tempFilename = filename + ".tmp";
+	{
+		std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			std::cerr << "Could not write scene cache \"" << filename << "\"" << std::endl;
+			return false;
+		}
+		const char padding[SECTION_ALIGNMENT]{};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(padding, alignSection(sizeof(header)) - sizeof(header));
+		for (const Section& section : sections) {
+			if (section.size > 0) {
+				file.write(static_cast<const char*>(section.data), section.size);
+			}
+			file.write(padding, alignSection(section.size) - section.size);
+		}
+		if (!file.good()) {
+			file.close();
+			std::remove(tempFilename.c_str());
+			std::cerr << "Could not write scene cache \"" << filename << "\"" << std::endl;
+			return false;
+		}
+	}
+	std::remove(filename.c_str());
+	if (std::rename(tempFilename.c_str(), filename.c_str()) != 0) {
+		std::remove(tempFilename.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool vkglTF::SceneCache::open(const std::string& filename, uint64_t key)
+{
+	close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	HANDLE fileMapping = nullptr;
+	if (GetFileSizeEx(file, &size) && size.QuadPart >= static_cast<LONGLONG>(sizeof(FileHeader))) {
+		fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+	if (!fileMapping) {
+		CloseHandle(file);
+		return false;
+	}
+	fileHandle = file;
+	mappingHandle = fileMapping;
+	mapping = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+	mappingSize = static_cast<size_t>(size.QuadPart);
+#else
+	int file = ::open(filename.c_str(), O_RDONLY);
+	if (file < 0) {
+		return false;
+	}
+	struct stat fileStat;
+	if (fstat(file, &fileStat) == 0 && fileStat.st_size >= static_cast<off_t>(sizeof(FileHeader))) {
+		void* fileMapping = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (fileMapping != MAP_FAILED) {
+			mapping = fileMapping;
+			mappingSize = static_cast<size_t>(fileStat.st_size);
+		}
+	}
+	// The mapping stays valid after closing the descriptor
+	::close(file);
+#endif
+	if (!mapping) {
+		close();
+		return false;
+	}
+
+	FileHeader header;
+	memcpy(&header, mapping, sizeof(header));
+	const bool valid = header.magic == CACHE_MAGIC && header.version == CACHE_VERSION && header.key == key
+		&& header.vertexSize == sizeof(Vertex) && header.hitVertexSize == sizeof(HitVertex) && header.hitTriangleSize == sizeof(HitTriangle)
+		&& header.emissiveTriangleSize == sizeof(Model::EmissiveTriangle) && header.primitiveSize == sizeof(Primitive)
+		&& header.fileSize == mappingSize
+		&& sectionInFile(header.vertexOffset, header.vertexCount, sizeof(Vertex), mappingSize)
+		&& sectionInFile(header.indexOffset, header.indexCount, sizeof(uint32_t), mappingSize)
+		&& sectionInFile(header.hitVertexOffset, header.vertexCount, sizeof(HitVertex), mappingSize)
+		&& sectionInFile(header.hitTriangleOffset, header.indexCount / 3, sizeof(HitTriangle), mappingSize)
+		&& sectionInFile(header.emissiveTriangleOffset, header.emissiveTriangleCount, sizeof(Model::EmissiveTriangle), mappingSize)
+		&& sectionInFile(header.primitiveOffset, header.primitiveCount, sizeof(Primitive), mappingSize)
+		&& sectionInFile(header.sceneOffset, header.sceneSize, 1, mappingSize);
+	if (!valid) {
+		close();
+		return false;
+	}
+
+	const uint8_t* base = static_cast<const uint8_t*>(mapping);
+	data.vertices = reinterpret_cast<const Vertex*>(base + header.vertexOffset);
+	data.indices = reinterpret_cast<const uint32_t*>(base + header.indexOffset);
+	data.hitVertices = reinterpret_cast<const HitVertex*>(base + header.hitVertexOffset);
+	data.hitTriangles = reinterpret_cast<const HitTriangle*>(base + header.hitTriangleOffset);
+	data.emissiveTriangles = reinterpret_cast<const Model::EmissiveTriangle*>(base + header.emissiveTriangleOffset);
+	data.primitives = reinterpret_cast<const Primitive*>(base + header.primitiveOffset);
+	data.scene = base + header.sceneOffset;
+	data.sceneSize = header.sceneSize;
+	data.vertexCount = header.vertexCount;
+	data.indexCount = header.indexCount;
+	data.emissiveTriangleCount = header.emissiveTriangleCount;
+	data.primitiveCount = header.primitiveCount;
+	return true;
+}
+
+void vkglTF::SceneCache::close()
+{
+#if defined(_WIN32)
+	if (mapping) {
+		UnmapViewOfFile(mapping);
+	}
+	if (mappingHandle) {
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle) {
+		CloseHandle(fileHandle);
+	}
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+#else
+	if (mapping) {
+		munmap(const_cast<void*>(mapping), mappingSize);
+	}
+#endif
+	mapping = nullptr;
+	mappingSize = 0;
+	data = Streams{};
+	primitiveCursor = 0;
+}
+
+const vkglTF::SceneCache::Primitive* vkglTF::SceneCache::nextPrimitive()
+{
+	if (primitiveCursor >= data.primitiveCount) {
+		return nullptr;
+	}
+	return &data.primitives[primitiveCursor++];
+}
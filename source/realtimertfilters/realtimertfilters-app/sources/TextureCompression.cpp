@@ -0,0 +1,527 @@
+#include "../headers/TextureCompression.hpp"
+#include "../headers/SceneCache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <jobsystem.hpp>
+// GL to Vulkan format tables of libktx, header only
+#include "../../external/ktx/lib/vk_format.h"
+
+namespace
+{
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+	// Key/value entry holding the source key of cooked images
+	const char SOURCE_KEY_NAME[] = "rtf.sourceKey";
+	// Bump whenever the output of encodeBC7 changes
+	const uint32_t ENCODER_VERSION = 1;
+	const uint32_t BC_BLOCK_SIZE = 16;
+
+	struct Ktx2Header {
+		uint8_t identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+
+	struct Ktx2Level {
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	uint64_t alignOffset(uint64_t offset, uint64_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	uint32_t levelSizeBC(uint32_t width, uint32_t height)
+	{
+		return ((width + 3) / 4) * ((height + 3) / 4) * BC_BLOCK_SIZE;
+	}
+
+	/*
+		BC7 mode 6: a single RGBA line with 7 bit endpoints, a shared low bit per endpoint and 4 bit indices
+		The line is fitted with the principal axis of the block and refined once by least squares
+	*/
+	const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct EndpointsBC7 {
+		int quantized[2][4];
+		int pBit[2];
+		int color[2][4];
+	};
+
+	// Picks the low bit that represents the endpoint best, color receives the decoded endpoint
+	void quantizeEndpoint(const float value[4], int quantized[4], int& pBit, int color[4])
+	{
+		float bestError = -1.0f;
+		for (int p = 0; p < 2; p++) {
+			int candidate[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; c++) {
+				candidate[c] = std::min(127, std::max(0, static_cast<int>(std::floor((value[c] - p) * 0.5f + 0.5f))));
+				const float difference = static_cast<float>((candidate[c] << 1) | p) - value[c];
+				error += difference * difference;
+			}
+			if (bestError < 0.0f || error < bestError) {
+				bestError = error;
+				pBit = p;
+				for (int c = 0; c < 4; c++) {
+					quantized[c] = candidate[c];
+					color[c] = (candidate[c] << 1) | p;
+				}
+			}
+		}
+	}
+
+	EndpointsBC7 quantizeEndpoints(const float endpoints[2][4])
+	{
+		EndpointsBC7 result;
+		for (int e = 0; e < 2; e++) {
+			quantizeEndpoint(endpoints[e], result.quantized[e], result.pBit[e], result.color[e]);
+		}
+		return result;
+	}
+
+	// Nearest palette entry for every pixel, returns the summed squared error
+	uint32_t assignIndices(const uint8_t pixels[16][4], const EndpointsBC7& endpoints, uint8_t indices[16])
+	{
+		int palette[16][4];
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 4; c++) {
+				palette[i][c] = ((64 - BC7_WEIGHTS[i]) * endpoints.color[0][c] + BC7_WEIGHTS[i] * endpoints.color[1][c] + 32) >> 6;
+			}
+		}
+		uint32_t totalError = 0;
+		for (int p = 0; p < 16; p++) {
+			uint32_t bestError = UINT32_MAX;
+			for (int i = 0; i < 16; i++) {
+				uint32_t error = 0;
+				for (int c = 0; c < 4; c++) {
+					const int difference = palette[i][c] - pixels[p][c];
+					error += difference * difference;
+				}
+				if (error < bestError) {
+					bestError = error;
+					indices[p] = static_cast<uint8_t>(i);
+				}
+			}
+			totalError += bestError;
+		}
+		return totalError;
+	}
+
+	void encodeBlockBC7(const uint8_t pixels[16][4], uint8_t* block)
+	{
+		// Principal axis by power iteration on the covariance, starting from the bounding box diagonal
+		float mean[4] = {};
+		float minimum[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+		float maximum[4] = {};
+		for (int p = 0; p < 16; p++) {
+			for (int c = 0; c < 4; c++) {
+				mean[c] += pixels[p][c] / 16.0f;
+				minimum[c] = std::min(minimum[c], static_cast<float>(pixels[p][c]));
+				maximum[c] = std::max(maximum[c], static_cast<float>(pixels[p][c]));
+			}
+		}
+		float covariance[4][4] = {};
+		for (int p = 0; p < 16; p++) {
+			for (int i = 0; i < 4; i++) {
+				for (int j = 0; j < 4; j++) {
+					covariance[i][j] += (pixels[p][i] - mean[i]) * (pixels[p][j] - mean[j]);
+				}
+			}
+		}
+		float axis[4];
+		for (int c = 0; c < 4; c++) {
+			axis[c] = maximum[c] - minimum[c];
+		}
+		for (int iteration = 0; iteration < 8; iteration++) {
+			float next[4] = {};
+			for (int i = 0; i < 4; i++) {
+				for (int j = 0; j < 4; j++) {
+					next[i] += covariance[i][j] * axis[j];
+				}
+			}
+			const float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+			if (length < 1e-6f) {
+				break;
+			}
+			for (int c = 0; c < 4; c++) {
+				axis[c] = next[c] / length;
+			}
+		}
+		const float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3]);
+
+		float endpoints[2][4];
+		if (axisLength < 1e-6f) {
+			// Uniform block
+			for (int c = 0; c < 4; c++) {
+				endpoints[0][c] = endpoints[1][c] = mean[c];
+			}
+		}
+		else {
+			float projectionMin = FLT_MAX;
+			float projectionMax = -FLT_MAX;
+			for (int p = 0; p < 16; p++) {
+				float projection = 0.0f;
+				for (int c = 0; c < 4; c++) {
+					projection += (pixels[p][c] - mean[c]) * axis[c] / axisLength;
+				}
+				projectionMin = std::min(projectionMin, projection);
+				projectionMax = std::max(projectionMax, projection);
+			}
+			for (int c = 0; c < 4; c++) {
+				endpoints[0][c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] / axisLength * projectionMin));
+				endpoints[1][c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] / axisLength * projectionMax));
+			}
+		}
+
+		EndpointsBC7 best = quantizeEndpoints(endpoints);
+		uint8_t bestIndices[16];
+		uint32_t bestError = assignIndices(pixels, best, bestIndices);
+
+		// Least squares endpoints for the chosen indices
+		float a = 0.0f, b = 0.0f, d = 0.0f;
+		float lowSum[4] = {};
+		float highSum[4] = {};
+		for (int p = 0; p < 16; p++) {
+			const float w = BC7_WEIGHTS[bestIndices[p]] / 64.0f;
+			a += (1.0f - w) * (1.0f - w);
+			b += (1.0f - w) * w;
+			d += w * w;
+			for (int c = 0; c < 4; c++) {
+				lowSum[c] += (1.0f - w) * pixels[p][c];
+				highSum[c] += w * pixels[p][c];
+			}
+		}
+		const float determinant = a * d - b * b;
+		if (std::abs(determinant) > 1e-6f) {
+			float refined[2][4];
+			for (int c = 0; c < 4; c++) {
+				refined[0][c] = std::min(255.0f, std::max(0.0f, (d * lowSum[c] - b * highSum[c]) / determinant));
+				refined[1][c] = std::min(255.0f, std::max(0.0f, (a * highSum[c] - b * lowSum[c]) / determinant));
+			}
+			EndpointsBC7 candidate = quantizeEndpoints(refined);
+			uint8_t candidateIndices[16];
+			const uint32_t candidateError = assignIndices(pixels, candidate, candidateIndices);
+			if (candidateError < bestError) {
+				best = candidate;
+				memcpy(bestIndices, candidateIndices, sizeof(bestIndices));
+			}
+		}
+
+		// The first index is stored without its high bit, so the line is flipped if it is set
+		if (bestIndices[0] & 8) {
+			std::swap(best.quantized[0], best.quantized[1]);
+			std::swap(best.pBit[0], best.pBit[1]);
+			for (int p = 0; p < 16; p++) {
+				bestIndices[p] = 15 - bestIndices[p];
+			}
+		}
+
+		memset(block, 0, BC_BLOCK_SIZE);
+		uint32_t bit = 0;
+		auto write = [&](uint32_t value, uint32_t bitCount) {
+			for (uint32_t i = 0; i < bitCount; i++, bit++) {
+				if ((value >> i) & 1) {
+					block[bit >> 3] |= static_cast<uint8_t>(1 << (bit & 7));
+				}
+			}
+		};
+		write(1 << 6, 7);
+		for (int c = 0; c < 4; c++) {
+			write(best.quantized[0][c], 7);
+			write(best.quantized[1][c], 7);
+		}
+		write(best.pBit[0], 1);
+		write(best.pBit[1], 1);
+		write(bestIndices[0], 3);
+		for (int p = 1; p < 16; p++) {
+			write(bestIndices[p], 4);
+		}
+	}
+
+	void encodeLevelBC7(const unsigned char* rgba, uint32_t width, uint32_t height, unsigned char* blocks)
+	{
+		const uint32_t blocksX = (width + 3) / 4;
+		const uint32_t blocksY = (height + 3) / 4;
+		vks::JobSystem::shared().parallelFor(blocksY, 4, [&](uint32_t begin, uint32_t end) {
+			uint8_t pixels[16][4];
+			for (uint32_t by = begin; by < end; by++) {
+				for (uint32_t bx = 0; bx < blocksX; bx++) {
+					// Blocks reaching over the edge repeat the last row and column
+					for (uint32_t p = 0; p < 16; p++) {
+						const uint32_t x = std::min(bx * 4 + p % 4, width - 1);
+						const uint32_t y = std::min(by * 4 + p / 4, height - 1);
+						memcpy(pixels[p], rgba + (static_cast<size_t>(y) * width + x) * 4, 4);
+					}
+					encodeBlockBC7(pixels, blocks + (static_cast<size_t>(by) * blocksX + bx) * BC_BLOCK_SIZE);
+				}
+			}
+		});
+	}
+
+	// 2x2 box filter, odd sizes repeat the last row and column
+	void downsample(const std::vector<unsigned char>& source, uint32_t width, uint32_t height, std::vector<unsigned char>& destination)
+	{
+		const uint32_t destWidth = std::max(1u, width / 2);
+		const uint32_t destHeight = std::max(1u, height / 2);
+		destination.resize(static_cast<size_t>(destWidth) * destHeight * 4);
+		for (uint32_t y = 0; y < destHeight; y++) {
+			const uint32_t y0 = std::min(y * 2, height - 1);
+			const uint32_t y1 = std::min(y * 2 + 1, height - 1);
+			for (uint32_t x = 0; x < destWidth; x++) {
+				const uint32_t x0 = std::min(x * 2, width - 1);
+				const uint32_t x1 = std::min(x * 2 + 1, width - 1);
+				for (uint32_t c = 0; c < 4; c++) {
+					const uint32_t sum = source[(static_cast<size_t>(y0) * width + x0) * 4 + c] + source[(static_cast<size_t>(y0) * width + x1) * 4 + c]
+						+ source[(static_cast<size_t>(y1) * width + x0) * 4 + c] + source[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+					destination[(static_cast<size_t>(y) * destWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	// Basic data format descriptor of BC7 (Khronos Data Format Specification 1.3), required in every KTX2 file
+	std::vector<uint32_t> descriptorBC7()
+	{
+		const uint32_t KHR_DF_MODEL_BC7 = 134;
+		const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+		const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+		return {
+			44,											// dfdTotalSize
+			0,											// vendorId, descriptorType
+			2 | (40 << 16),								// versionNumber, descriptorBlockSize
+			KHR_DF_MODEL_BC7 | (KHR_DF_PRIMARIES_BT709 << 8) | (KHR_DF_TRANSFER_LINEAR << 16),
+			3 | (3 << 8),								// texelBlockDimension 4x4
+			BC_BLOCK_SIZE,								// bytesPlane0
+			0,
+			127 << 16,									// One sample covering all 128 bits
+			0,
+			0,
+			0xFFFFFFFF
+		};
+	}
+}
+
+VkFormat vkglTF::TextureCompression::getKtxFormat(ktxTexture* texture)
+{
+	VkFormat format = vkGetFormatFromOpenGLInternalFormat(texture->glInternalformat);
+	if (format == VK_FORMAT_UNDEFINED) {
+		format = vkGetFormatFromOpenGLFormat(texture->glFormat, texture->glType);
+	}
+	return format;
+}
+
+bool vkglTF::TextureCompression::loadKtx2(const std::string& filename, Image& image, uint64_t* sourceKey)
+{
+	if (sourceKey) {
+		*sourceKey = 0;
+	}
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+	std::vector<uint8_t> fileData((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	Ktx2Header header;
+	if (fileData.size() < sizeof(header)) {
+		return false;
+	}
+	memcpy(&header, fileData.data(), sizeof(header));
+	if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+		return false;
+	}
+	if (header.supercompressionScheme != 0 || header.vkFormat == VK_FORMAT_UNDEFINED) {
+		// Basis Universal and Zstandard payloads have to be transcoded, there is no transcoder in this build
+		std::cerr << "KTX2 file \"" << filename << "\" is supercompressed, only KTX2 files with a Vulkan format are supported" << std::endl;
+		return false;
+	}
+	if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || header.pixelWidth == 0 || header.pixelHeight == 0) {
+		std::cerr << "KTX2 file \"" << filename << "\" is not a single 2D texture" << std::endl;
+		return false;
+	}
+
+	image.format = static_cast<VkFormat>(header.vkFormat);
+	image.width = header.pixelWidth;
+	image.height = header.pixelHeight;
+	image.mipLevels = std::max(1u, header.levelCount);
+	if (sizeof(header) + static_cast<uint64_t>(image.mipLevels) * sizeof(Ktx2Level) > fileData.size()) {
+		return false;
+	}
+	std::vector<Ktx2Level> levels(image.mipLevels);
+	memcpy(levels.data(), fileData.data() + sizeof(header), levels.size() * sizeof(Ktx2Level));
+
+	uint64_t dataSize = 0;
+	for (const Ktx2Level& level : levels) {
+		if (level.byteOffset > fileData.size() || level.byteLength > fileData.size() - level.byteOffset) {
+			return false;
+		}
+		dataSize = alignOffset(dataSize, BC_BLOCK_SIZE) + level.byteLength;
+	}
+	image.data.resize(dataSize);
+	image.levelOffsets.resize(levels.size());
+	uint64_t offset = 0;
+	for (size_t i = 0; i < levels.size(); i++) {
+		offset = alignOffset(offset, BC_BLOCK_SIZE);
+		memcpy(image.data.data() + offset, fileData.data() + levels[i].byteOffset, levels[i].byteLength);
+		image.levelOffsets[i] = offset;
+		offset += levels[i].byteLength;
+	}
+
+	// Key/value entries: length, key, terminating zero, value, padded to four bytes
+	if (sourceKey && header.kvdByteLength > 0 && header.kvdByteOffset <= fileData.size() && header.kvdByteLength <= fileData.size() - header.kvdByteOffset) {
+		uint64_t entry = header.kvdByteOffset;
+		const uint64_t end = header.kvdByteOffset + header.kvdByteLength;
+		while (entry + sizeof(uint32_t) <= end) {
+			uint32_t length;
+			memcpy(&length, fileData.data() + entry, sizeof(length));
+			const uint64_t keyOffset = entry + sizeof(uint32_t);
+			if (length > end - keyOffset) {
+				break;
+			}
+			if (length == sizeof(SOURCE_KEY_NAME) + sizeof(uint64_t) && memcmp(fileData.data() + keyOffset, SOURCE_KEY_NAME, sizeof(SOURCE_KEY_NAME)) == 0) {
+				memcpy(sourceKey, fileData.data() + keyOffset + sizeof(SOURCE_KEY_NAME), sizeof(uint64_t));
+			}
+			entry = alignOffset(keyOffset + length, 4);
+		}
+	}
+	return true;
+}
+
+bool vkglTF::TextureCompression::writeKtx2(const std::string& filename, const Image& image, uint64_t sourceKey)
+{
+	assert(image.format == VK_FORMAT_BC7_UNORM_BLOCK);
+	const std::vector<uint32_t> descriptor = descriptorBC7();
+	std::vector<uint8_t> keyValueData(sizeof(uint32_t) + sizeof(SOURCE_KEY_NAME) + sizeof(uint64_t));
+	const uint32_t keyValueLength = sizeof(SOURCE_KEY_NAME) + sizeof(uint64_t);
+	memcpy(keyValueData.data(), &keyValueLength, sizeof(keyValueLength));
+	memcpy(keyValueData.data() + sizeof(uint32_t), SOURCE_KEY_NAME, sizeof(SOURCE_KEY_NAME));
+	memcpy(keyValueData.data() + sizeof(uint32_t) + sizeof(SOURCE_KEY_NAME), &sourceKey, sizeof(sourceKey));
+	keyValueData.resize(alignOffset(keyValueData.size(), 4), 0);
+
+	Ktx2Header header{};
+	memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.vkFormat = image.format;
+	header.typeSize = 1;
+	header.pixelWidth = image.width;
+	header.pixelHeight = image.height;
+	header.faceCount = 1;
+	header.levelCount = image.mipLevels;
+	header.dfdByteOffset = static_cast<uint32_t>(sizeof(header) + image.mipLevels * sizeof(Ktx2Level));
+	header.dfdByteLength = static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t));
+	header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+	header.kvdByteLength = static_cast<uint32_t>(keyValueData.size());
+
+	// The file stores the smallest level first
+	std::vector<Ktx2Level> levels(image.mipLevels);
+	uint64_t offset = header.kvdByteOffset + header.kvdByteLength;
+	for (int32_t i = static_cast<int32_t>(image.mipLevels) - 1; i >= 0; i--) {
+		const uint64_t levelEnd = (i + 1 < static_cast<int32_t>(image.mipLevels)) ? image.levelOffsets[i + 1] : image.data.size();
+		offset = alignOffset(offset, BC_BLOCK_SIZE);
+		levels[i].byteOffset = offset;
+		levels[i].byteLength = levelEnd - image.levelOffsets[i];
+		levels[i].uncompressedByteLength = levels[i].byteLength;
+		offset += levels[i].byteLength;
+	}
+
+	// Written under a temporary name like the scene cache, so an interrupted write never leaves a truncated file behind
+	const std::string tempFilename = filename + ".tmp";
+	{
+		std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			std::cerr << "Could not write cooked texture \"" << filename << "\"" << std::endl;
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(Ktx2Level));
+		file.write(reinterpret_cast<const char*>(descriptor.data()), descriptor.size() * sizeof(uint32_t));
+		file.write(reinterpret_cast<const char*>(keyValueData.data()), keyValueData.size());
+		uint64_t position = header.kvdByteOffset + header.kvdByteLength;
+		const char padding[BC_BLOCK_SIZE]{};
+		for (int32_t i = static_cast<int32_t>(image.mipLevels) - 1; i >= 0; i--) {
+			file.write(padding, levels[i].byteOffset - position);
+			file.write(reinterpret_cast<const char*>(image.data.data() + image.levelOffsets[i]), levels[i].byteLength);
+			position = levels[i].byteOffset + levels[i].byteLength;
+		}
+		if (!file.good()) {
+			file.close();
+			std::remove(tempFilename.c_str());
+			std::cerr << "Could not write cooked texture \"" << filename << "\"" << std::endl;
+			return false;
+		}
+	}
+	std::remove(filename.c_str());
+	if (std::rename(tempFilename.c_str(), filename.c_str()) != 0) {
+		std::remove(tempFilename.c_str());
+		return false;
+	}
+	return true;
+}
+
+void vkglTF::TextureCompression::encodeBC7(const unsigned char* rgba, uint32_t width, uint32_t height, Image& image)
+{
+	image.format = VK_FORMAT_BC7_UNORM_BLOCK;
+	image.width = width;
+	image.height = height;
+	image.mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+	image.levelOffsets.resize(image.mipLevels);
+	VkDeviceSize dataSize = 0;
+	for (uint32_t level = 0; level < image.mipLevels; level++) {
+		image.levelOffsets[level] = dataSize;
+		dataSize += levelSizeBC(std::max(1u, width >> level), std::max(1u, height >> level));
+	}
+	image.data.resize(dataSize);
+
+	std::vector<unsigned char> current(rgba, rgba + static_cast<size_t>(width) * height * 4);
+	std::vector<unsigned char> next;
+	uint32_t levelWidth = width;
+	uint32_t levelHeight = height;
+	for (uint32_t level = 0; level < image.mipLevels; level++) {
+		encodeLevelBC7(current.data(), levelWidth, levelHeight, image.data.data() + image.levelOffsets[level]);
+		if (level + 1 < image.mipLevels) {
+			downsample(current, levelWidth, levelHeight, next);
+			current.swap(next);
+			levelWidth = std::max(1u, levelWidth / 2);
+			levelHeight = std::max(1u, levelHeight / 2);
+		}
+	}
+}
+
+uint64_t vkglTF::TextureCompression::computeSourceKey(const unsigned char* data, size_t size)
+{
+	uint64_t key = SceneCache::hashBytes(SceneCache::HASH_SEED, &ENCODER_VERSION, sizeof(ENCODER_VERSION));
+	return SceneCache::hashBytes(key, data, size);
+}
+
+std::string vkglTF::TextureCompression::cookedFilename(const std::string& sceneFilename, uint32_t imageIndex)
+{
+	return SceneCache::cacheFilename(sceneFilename) + ".image" + std::to_string(imageIndex) + ".ktx2";
+}
+
+bool vkglTF::TextureCompression::isFormatSupported(VkPhysicalDevice physicalDevice, VkFormat format)
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+	const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+	return (formatProperties.optimalTilingFeatures & required) == required;
+}
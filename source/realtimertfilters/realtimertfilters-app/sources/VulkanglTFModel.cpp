@@ -12,11 +12,57 @@
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 
 #include "../headers/VulkanglTFModel.h"
+#include "../headers/SceneCache.hpp"
+#include "../headers/TextureCompression.hpp"
+#include "../data/shaders/glsl/pathTracerShader/gltf.glsl"
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <jobsystem.hpp>
 
-VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
-uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor;
+
+static bool isKtxImage(const tinygltf::Image& gltfimage)
+{
+	const size_t extension = gltfimage.uri.find_last_of(".");
+	return extension != std::string::npos && gltfimage.uri.substr(extension + 1) == "ktx";
+}
+
+static bool isKtx2Image(const tinygltf::Image& gltfimage)
+{
+	const size_t extension = gltfimage.uri.find_last_of(".");
+	return extension != std::string::npos && gltfimage.uri.substr(extension + 1) == "ktx2";
+}
+
+/*
+	Reads a ktx file with all its levels, returns nullptr on failure. Thread safe
+*/
+static ktxTexture* loadKtxFile(const std::string& filename)
+{
+	ktxTexture* ktxTexture = nullptr;
+	ktxResult result = KTX_SUCCESS;
+#if defined(__ANDROID__)
+	AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+	if (!asset) {
+		return nullptr;
+	}
+	size_t size = AAsset_getLength(asset);
+	assert(size > 0);
+	ktx_uint8_t* textureData = new ktx_uint8_t[size];
+	AAsset_read(asset, textureData, size);
+	AAsset_close(asset);
+	result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+	delete[] textureData;
+#else
+	if (!vks::tools::fileExists(filename)) {
+		return nullptr;
+	}
+	result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+#endif
+	return result == KTX_SUCCESS ? ktxTexture : nullptr;
+}
 
 /*
 	We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
@@ -24,13 +70,14 @@ uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageB
 bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
 {
 	// KTX files will be handled by our own code
-	if (image->uri.find_last_of(".") != std::string::npos) {
-		if (image->uri.substr(image->uri.find_last_of(".") + 1) == "ktx") {
-			return true;
-		}
+	if (isKtxImage(*image) || isKtx2Image(*image)) {
+		return true;
 	}
 
-	return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, userData);
+	// Only keep the encoded file, images are decoded in parallel by Model::loadImages (or Texture::decodeImage)
+	image->as_is = true;
+	image->image.assign(bytes, bytes + size);
+	return true;
 }
 
 bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData) 
@@ -62,340 +109,44 @@ void vkglTF::Texture::destroy()
 	}
 }
 
-void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue)
+bool vkglTF::Texture::decodeImage(tinygltf::Image& gltfimage)
 {
-	this->device = device;
-
-	bool isKtx = false;
-	// Image points to an external ktx file
-	if (gltfimage.uri.find_last_of(".") != std::string::npos) {
-		if (gltfimage.uri.substr(gltfimage.uri.find_last_of(".") + 1) == "ktx") {
-			isKtx = true;
+	if (gltfimage.as_is) {
+		int width = 0, height = 0, component = 0;
+		// Vulkan devices rarely support RGB only, so always decode to RGBA
+		stbi_uc* pixels = stbi_load_from_memory(gltfimage.image.data(), static_cast<int>(gltfimage.image.size()), &width, &height, &component, 4);
+		if (!pixels) {
+			return false;
 		}
+		gltfimage.width = width;
+		gltfimage.height = height;
+		gltfimage.component = 4;
+		gltfimage.bits = 8;
+		gltfimage.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+		gltfimage.image.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+		gltfimage.as_is = false;
+		stbi_image_free(pixels);
 	}
-
-	VkFormat format;
-
-	if (!isKtx) {
-		// Texture was loaded using STB_Image
-
-		unsigned char* buffer = nullptr;
-		VkDeviceSize bufferSize = 0;
-		bool deleteBuffer = false;
-		if (gltfimage.component == 3) {
-			// Most devices don't support RGB only on Vulkan so convert if necessary
-			// TODO: Check actual format support and transform only if required
-			bufferSize = gltfimage.width * gltfimage.height * 4;
-			buffer = new unsigned char[bufferSize];
-			unsigned char* rgba = buffer;
-			unsigned char* rgb = &gltfimage.image[0];
-			for (size_t i = 0; i < gltfimage.width * gltfimage.height; ++i) {
-				for (int32_t j = 0; j < 3; ++j) {
-					rgba[j] = rgb[j];
-				}
-				rgba += 4;
-				rgb += 3;
-			}
-			deleteBuffer = true;
-		}
-		else {
-			buffer = &gltfimage.image[0];
-			bufferSize = gltfimage.image.size();
-		}
-
-		format = VK_FORMAT_R8G8B8A8_UNORM;
-
-		VkFormatProperties formatProperties;
-
-		width = gltfimage.width;
-		height = gltfimage.height;
-		mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
-
-		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
-
-		VkMemoryAllocateInfo memAllocInfo{};
-		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		VkMemoryRequirements memReqs{};
-
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo{};
-		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferCreateInfo.size = bufferSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, buffer, bufferSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
-
-		VkImageCreateInfo imageCreateInfo{};
-		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageCreateInfo.format = format;
-		imageCreateInfo.mipLevels = mipLevels;
-		imageCreateInfo.arrayLayers = 1;
-		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageCreateInfo.extent = { width, height, 1 };
-		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		VkImageSubresourceRange subresourceRange = {};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.levelCount = 1;
-		subresourceRange.layerCount = 1;
-
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = 0;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
-
-		VkBufferImageCopy bufferCopyRegion = {};
-		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		bufferCopyRegion.imageSubresource.mipLevel = 0;
-		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-		bufferCopyRegion.imageSubresource.layerCount = 1;
-		bufferCopyRegion.imageExtent.width = width;
-		bufferCopyRegion.imageExtent.height = height;
-		bufferCopyRegion.imageExtent.depth = 1;
-
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
-
-		device->flushCommandBuffer(copyCmd, copyQueue, true);
-
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
-		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-		VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		for (uint32_t i = 1; i < mipLevels; i++) {
-			VkImageBlit imageBlit{};
-
-			imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.srcSubresource.layerCount = 1;
-			imageBlit.srcSubresource.mipLevel = i - 1;
-			imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
-			imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
-			imageBlit.srcOffsets[1].z = 1;
-
-			imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.dstSubresource.layerCount = 1;
-			imageBlit.dstSubresource.mipLevel = i;
-			imageBlit.dstOffsets[1].x = int32_t(width >> i);
-			imageBlit.dstOffsets[1].y = int32_t(height >> i);
-			imageBlit.dstOffsets[1].z = 1;
-
-			VkImageSubresourceRange mipSubRange = {};
-			mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			mipSubRange.baseMipLevel = i;
-			mipSubRange.levelCount = 1;
-			mipSubRange.layerCount = 1;
-
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = 0;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
-
-			vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
-
-			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-			}
+	else if (gltfimage.component == 3) {
+		// Decoded by someone else
+		std::vector<unsigned char> rgba(static_cast<size_t>(gltfimage.width) * gltfimage.height * 4);
+		unsigned char* dst = rgba.data();
+		const unsigned char* src = gltfimage.image.data();
+		for (size_t i = 0; i < static_cast<size_t>(gltfimage.width) * gltfimage.height; ++i) {
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+			dst += 4;
+			src += 3;
 		}
-
-		subresourceRange.levelCount = mipLevels;
-		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
-
-		device->flushCommandBuffer(blitCmd, copyQueue, true);
-	}
-	else {
-		// Texture is stored in an external ktx file
-		std::string filename = path + "/" + gltfimage.uri;
-
-		ktxTexture* ktxTexture;
-
-		ktxResult result = KTX_SUCCESS;
-#if defined(__ANDROID__)
-		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-		if (!asset) {
-			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
-		}
-		size_t size = AAsset_getLength(asset);
-		assert(size > 0);
-		ktx_uint8_t* textureData = new ktx_uint8_t[size];
-		AAsset_read(asset, textureData, size);
-		AAsset_close(asset);
-		result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-		delete[] textureData;
-#else
-		if (!vks::tools::fileExists(filename)) {
-			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
-		}
-		result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-#endif		
-		assert(result == KTX_SUCCESS);
-
-		this->device = device;
-		width = ktxTexture->baseWidth;
-		height = ktxTexture->baseHeight;
-		mipLevels = ktxTexture->numLevels;
-
-		ktx_uint8_t* ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
-		// @todo: Use ktxTexture_GetVkFormat(ktxTexture)
-		format = VK_FORMAT_R8G8B8A8_UNORM;
-
-		// Get device properties for the requested texture format
-		VkFormatProperties formatProperties;
-		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
-
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = ktxTextureSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
-
-		std::vector<VkBufferImageCopy> bufferCopyRegions;
-		for (uint32_t i = 0; i < mipLevels; i++)
-		{
-			ktx_size_t offset;
-			KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
-			assert(result == KTX_SUCCESS);
-			VkBufferImageCopy bufferCopyRegion = {};
-			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			bufferCopyRegion.imageSubresource.mipLevel = i;
-			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-			bufferCopyRegion.imageSubresource.layerCount = 1;
-			bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
-			bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
-			bufferCopyRegion.imageExtent.depth = 1;
-			bufferCopyRegion.bufferOffset = offset;
-			bufferCopyRegions.push_back(bufferCopyRegion);
-		}
-
-		// Create optimal tiled target image
-		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageCreateInfo.format = format;
-		imageCreateInfo.mipLevels = mipLevels;
-		imageCreateInfo.arrayLayers = 1;
-		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageCreateInfo.extent = { width, height, 1 };
-		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-		VkImageSubresourceRange subresourceRange = {};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.baseMipLevel = 0;
-		subresourceRange.levelCount = mipLevels;
-		subresourceRange.layerCount = 1;
-
-		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
-		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-		device->flushCommandBuffer(copyCmd, copyQueue);
-		this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
-		ktxTexture_Destroy(ktxTexture);
+		gltfimage.image.swap(rgba);
+		gltfimage.component = 4;
 	}
+	return true;
+}
 
+void vkglTF::Texture::createSamplerAndView(VkFormat format)
+{
 	VkSamplerCreateInfo samplerInfo{};
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 	samplerInfo.magFilter = VK_FILTER_LINEAR;
@@ -429,56 +180,6 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 	descriptor.imageLayout = imageLayout;
 }
 
-/*
-	glTF material
-*/
-void vkglTF::Material::createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags)
-{
-	VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-	descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	descriptorSetAllocInfo.descriptorPool = descriptorPool;
-	descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
-	descriptorSetAllocInfo.descriptorSetCount = 1;
-	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &descriptorSet));
-	std::vector<VkDescriptorImageInfo> imageDescriptors{};
-	std::vector<VkWriteDescriptorSet> writeDescriptorSets{};
-	if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
-		imageDescriptors.push_back(baseColorTexture->descriptor);
-		VkWriteDescriptorSet writeDescriptorSet{};
-		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.dstSet = descriptorSet;
-		writeDescriptorSet.dstBinding = static_cast<uint32_t>(writeDescriptorSets.size());
-		writeDescriptorSet.pImageInfo = &baseColorTexture->descriptor;
-		writeDescriptorSets.push_back(writeDescriptorSet);
-	}
-	if (normalTexture && descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
-		imageDescriptors.push_back(normalTexture->descriptor);
-		VkWriteDescriptorSet writeDescriptorSet{};
-		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.dstSet = descriptorSet;
-		writeDescriptorSet.dstBinding = static_cast<uint32_t>(writeDescriptorSets.size());
-		writeDescriptorSet.pImageInfo = &normalTexture->descriptor;
-		writeDescriptorSets.push_back(writeDescriptorSet);
-	}
-	if (metallicRoughnessTexture && descriptorBindingFlags & DescriptorBindingFlags::MetallicRoughnessMap) {
-		imageDescriptors.push_back(metallicRoughnessTexture->descriptor);
-		VkWriteDescriptorSet writeDescriptorSet{};
-		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.dstSet = descriptorSet;
-		writeDescriptorSet.dstBinding = static_cast<uint32_t>(writeDescriptorSets.size());
-		writeDescriptorSet.pImageInfo = &metallicRoughnessTexture->descriptor;
-		writeDescriptorSets.push_back(writeDescriptorSet);
-	}
-	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
-}
-
-
 /*
 	glTF primitive
 */
@@ -622,6 +323,36 @@ VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputStat
 	return &pipelineVertexInputStateCreateInfo;
 }
 
+/*
+	Compact hit shading vertex
+*/
+
+vkglTF::HitVertex vkglTF::HitVertex::pack(const Vertex& vertex) {
+	// Octahedral normal encoding, has to match octDecode in hitvertex.glsl
+	glm::vec3 n = vertex.normal / (std::abs(vertex.normal.x) + std::abs(vertex.normal.y) + std::abs(vertex.normal.z) + 1e-20f);
+	glm::vec2 oct = glm::vec2(n);
+	if (n.z < 0.0f) {
+		const glm::vec2 signNotZero(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+		oct = (glm::vec2(1.0f) - glm::abs(glm::vec2(n.y, n.x))) * signNotZero;
+	}
+	HitVertex hitVertex;
+	hitVertex.normal = glm::packSnorm2x16(oct);
+	hitVertex.uv = glm::packHalf2x16(vertex.uv);
+	return hitVertex;
+}
+
+vkglTF::HitTriangle vkglTF::HitTriangle::create(const Vertex& v0, const Vertex& v1, const Vertex& v2) {
+	HitTriangle hitTriangle;
+	hitTriangle.materialId = v0.materialId;
+	// Twice the areas, the factor cancels in the ratio. Degenerate triangles get no bias
+	const float worldArea = glm::length(glm::cross(v1.pos - v0.pos, v2.pos - v0.pos));
+	const glm::vec2 uv1 = v1.uv - v0.uv;
+	const glm::vec2 uv2 = v2.uv - v0.uv;
+	const float uvArea = std::abs(uv1.x * uv2.y - uv1.y * uv2.x);
+	hitTriangle.lodBias = (worldArea > 0.0f && uvArea > 0.0f) ? 0.5f * std::log2(uvArea / worldArea) : 0.0f;
+	return hitTriangle;
+}
+
 vkglTF::Texture* vkglTF::Model::getTexture(uint32_t index)
 {
 
@@ -744,6 +475,12 @@ vkglTF::Model::~Model()
 	vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
 	vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
 	vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
+	vkDestroyBuffer(device->logicalDevice, hitVertices.buffer, nullptr);
+	vkFreeMemory(device->logicalDevice, hitVertices.memory, nullptr);
+	vkDestroyBuffer(device->logicalDevice, hitTriangles.buffer, nullptr);
+	vkFreeMemory(device->logicalDevice, hitTriangles.memory, nullptr);
+	vkDestroyBuffer(device->logicalDevice, shadeMaterials.buffer, nullptr);
+	vkFreeMemory(device->logicalDevice, shadeMaterials.memory, nullptr);
 	for (auto texture : textures) {
 		texture.destroy();
 	}
@@ -754,15 +491,11 @@ vkglTF::Model::~Model()
 		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutUbo, nullptr);
 		descriptorSetLayoutUbo = VK_NULL_HANDLE;
 	}
-	if (descriptorSetLayoutImage != VK_NULL_HANDLE) {
-		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutImage, nullptr);
-		descriptorSetLayoutImage = VK_NULL_HANDLE;
-	}
 	vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
 	emptyTexture.destroy();
 }
 
-void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, uint32_t nodeIndex, const tinygltf::Model &model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale)
+void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, uint32_t nodeIndex, const tinygltf::Model &model, std::vector<PrimitiveSource>& primitiveSources, uint32_t& indexCount, uint32_t& vertexCount, float globalscale)
 {
 	vkglTF::Node *newNode = new Node{};
 	newNode->index = nodeIndex;
@@ -797,13 +530,13 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 	// Node with children
 	if (node.children.size() > 0) {
 		for (auto i = 0; i < node.children.size(); i++) {
-			loadNode(newNode, model.nodes[node.children[i]], node.children[i], model, indexBuffer, vertexBuffer, globalscale);
+			loadNode(newNode, model.nodes[node.children[i]], node.children[i], model, primitiveSources, indexCount, vertexCount, globalscale);
 		}
 	}
 
 	// Node contains mesh data
 	if (node.mesh > -1) {
-		const tinygltf::Mesh mesh = model.meshes[node.mesh];
+		const tinygltf::Mesh &mesh = model.meshes[node.mesh];
 		Mesh *newMesh = new Mesh(device, newNode->matrix);
 		newMesh->name = mesh.name;
 		for (size_t j = 0; j < mesh.primitives.size(); j++) {
@@ -811,158 +544,205 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 			if (primitive.indices < 0) {
 				continue;
 			}
-			uint32_t indexStart = static_cast<uint32_t>(indexBuffer.size());
-			uint32_t vertexStart = static_cast<uint32_t>(vertexBuffer.size());
-			uint32_t indexCount = 0;
-			uint32_t vertexCount = 0;
-			glm::vec3 posMin{};
-			glm::vec3 posMax{};
-			bool hasSkin = false;
-			// Vertices
-			{
-				const float *bufferPos = nullptr;
-				const float *bufferNormals = nullptr;
-				const float *bufferTexCoords = nullptr;
-				const float* bufferColors = nullptr;
-				const float *bufferTangents = nullptr;
-				uint32_t numColorComponents;
-				const uint16_t *bufferJoints = nullptr;
-				const float *bufferWeights = nullptr;
-
-				// Position attribute is required
-				assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
-
-				const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
-				const tinygltf::BufferView &posView = model.bufferViews[posAccessor.bufferView];
-				bufferPos = reinterpret_cast<const float *>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
-				posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
-				posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
-
-				if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-					const tinygltf::Accessor &normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-					const tinygltf::BufferView &normView = model.bufferViews[normAccessor.bufferView];
-					bufferNormals = reinterpret_cast<const float *>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
-				}
 
-				if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferTexCoords = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-				}
+			// Position attribute is required
+			assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
+			const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
+			const tinygltf::Accessor &indexAccessor = model.accessors[primitive.indices];
+			if (indexAccessor.componentType != TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT && indexAccessor.componentType != TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT && indexAccessor.componentType != TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE) {
+				std::cerr << "Index component type " << indexAccessor.componentType << " not supported!" << std::endl;
+				continue;
+			}
 
-				if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
-				{
-					const tinygltf::Accessor& colorAccessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
-					const tinygltf::BufferView& colorView = model.bufferViews[colorAccessor.bufferView];
-					// Color buffer are either of type vec3 or vec4
-					numColorComponents = colorAccessor.type == TINYGLTF_PARAMETER_TYPE_FLOAT_VEC3 ? 3 : 4;
-					bufferColors = reinterpret_cast<const float*>(&(model.buffers[colorView.buffer].data[colorAccessor.byteOffset + colorView.byteOffset]));
-				}
+			// Only the buffer ranges are assigned here, loadPrimitives decodes the geometry into them
+			Primitive *newPrimitive = new Primitive(indexCount, static_cast<uint32_t>(indexAccessor.count), primitive.material > -1 ? materials[primitive.material] : materials.back());
+			newPrimitive->firstVertex = vertexCount;
+			newPrimitive->vertexCount = static_cast<uint32_t>(posAccessor.count);
+			newPrimitive->setDimensions(
+				glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]),
+				glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]));
+			newMesh->primitives.push_back(newPrimitive);
+			primitiveSources.push_back({ &primitive, node.mesh, newNode, newPrimitive });
+			indexCount += newPrimitive->indexCount;
+			vertexCount += newPrimitive->vertexCount;
+		}
+		newNode->mesh = newMesh;
+	}
+	if (parent) {
+		parent->children.push_back(newNode);
+	} else {
+		nodes.push_back(newNode);
+	}
+	linearNodes.push_back(newNode);
+}
 
-				if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
-				{
-					const tinygltf::Accessor &tangentAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
-					const tinygltf::BufferView &tangentView = model.bufferViews[tangentAccessor.bufferView];
-					bufferTangents = reinterpret_cast<const float *>(&(model.buffers[tangentView.buffer].data[tangentAccessor.byteOffset + tangentView.byteOffset]));
-				}
+/*
+	Decodes a primitive into its range of the vertex and index buffers and applies the requested pre-calculations
+	Only reads shared state, so primitives can be loaded concurrently
+*/
+void vkglTF::Model::loadPrimitive(const tinygltf::Model &model, const PrimitiveSource &source, Vertex *vertexBuffer, uint32_t *indexBuffer, uint32_t fileLoadingFlags)
+{
+	const tinygltf::Primitive &primitive = *source.primitive;
+	Primitive *target = source.target;
 
-				// Skinning
-				// Joints
-				if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
-					const tinygltf::BufferView &jointView = model.bufferViews[jointAccessor.bufferView];
-					bufferJoints = reinterpret_cast<const uint16_t *>(&(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]));
-				}
+	// Vertices
+	{
+		const float *bufferPos = nullptr;
+		const float *bufferNormals = nullptr;
+		const float *bufferTexCoords = nullptr;
+		const float* bufferColors = nullptr;
+		const float *bufferTangents = nullptr;
+		uint32_t numColorComponents;
+		const uint16_t *bufferJoints = nullptr;
+		const float *bufferWeights = nullptr;
+
+		const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
+		const tinygltf::BufferView &posView = model.bufferViews[posAccessor.bufferView];
+		bufferPos = reinterpret_cast<const float *>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
+
+		if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
+			const tinygltf::Accessor &normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
+			const tinygltf::BufferView &normView = model.bufferViews[normAccessor.bufferView];
+			bufferNormals = reinterpret_cast<const float *>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
+		}
 
-				if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
-					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferWeights = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-				}
+		if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
+			const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
+			const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
+			bufferTexCoords = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
+		}
 
-				// MeshId / Material Id
-				
+		if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
+		{
+			const tinygltf::Accessor& colorAccessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
+			const tinygltf::BufferView& colorView = model.bufferViews[colorAccessor.bufferView];
+			// Color buffer are either of type vec3 or vec4
+			numColorComponents = colorAccessor.type == TINYGLTF_PARAMETER_TYPE_FLOAT_VEC3 ? 3 : 4;
+			bufferColors = reinterpret_cast<const float*>(&(model.buffers[colorView.buffer].data[colorAccessor.byteOffset + colorView.byteOffset]));
+		}
 
-				hasSkin = (bufferJoints && bufferWeights);
-
-				vertexCount = static_cast<uint32_t>(posAccessor.count);
-
-				for (size_t v = 0; v < posAccessor.count; v++) {
-					Vertex vert{};
-					vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * 3]), 1.0f);
-					vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * 3]) : glm::vec3(0.0f)));
-					vert.uv = bufferTexCoords ? glm::make_vec2(&bufferTexCoords[v * 2]) : glm::vec3(0.0f);
-					if (bufferColors) {
-						switch (numColorComponents) {
-							case 3: 
-								vert.color = glm::vec4(glm::make_vec3(&bufferColors[v * 3]), 1.0f);
-							case 4:
-								vert.color = glm::make_vec4(&bufferColors[v * 4]);
-						}
-					}
-					else {
-						vert.color = glm::vec4(1.0f);
-					}
-					vert.tangent = bufferTangents ? glm::vec4(glm::make_vec4(&bufferTangents[v * 4])) : glm::vec4(0.0f);
-					vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * 4])) : glm::vec4(0.0f);
-					vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * 4]) : glm::vec4(0.0f);
-					vert.materialId = primitive.material;
-					vert.meshId = node.mesh;
-					vertexBuffer.push_back(vert);
-				}
-			}
-			// Indices
-			{
-				const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
-				const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
+		if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
+		{
+			const tinygltf::Accessor &tangentAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
+			const tinygltf::BufferView &tangentView = model.bufferViews[tangentAccessor.bufferView];
+			bufferTangents = reinterpret_cast<const float *>(&(model.buffers[tangentView.buffer].data[tangentAccessor.byteOffset + tangentView.byteOffset]));
+		}
 
-				indexCount = static_cast<uint32_t>(accessor.count);
+		// Skinning
+		// Joints
+		if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
+			const tinygltf::Accessor &jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
+			const tinygltf::BufferView &jointView = model.bufferViews[jointAccessor.bufferView];
+			bufferJoints = reinterpret_cast<const uint16_t *>(&(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]));
+		}
 
-				switch (accessor.componentType) {
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-					uint32_t *buf = new uint32_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint32_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-					break;
-				}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-					uint16_t *buf = new uint16_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint16_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-					break;
-				}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-					uint8_t *buf = new uint8_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint8_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-					break;
-				}
-				default:
-					std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
-					return;
+		if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
+			const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
+			const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
+			bufferWeights = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
+		}
+
+		const bool hasSkin = (bufferJoints && bufferWeights);
+
+		// Pre-Calculations for requested features
+		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+		const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
+		const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
+		const glm::mat4 localMatrix = source.node->getMatrix();
+
+		Vertex *vertices = vertexBuffer + target->firstVertex;
+		for (size_t v = 0; v < target->vertexCount; v++) {
+			Vertex& vert = vertices[v];
+			vert = Vertex{};
+			vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * 3]), 1.0f);
+			vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * 3]) : glm::vec3(0.0f)));
+			vert.uv = bufferTexCoords ? glm::make_vec2(&bufferTexCoords[v * 2]) : glm::vec3(0.0f);
+			if (bufferColors) {
+				switch (numColorComponents) {
+					case 3: 
+						vert.color = glm::vec4(glm::make_vec3(&bufferColors[v * 3]), 1.0f);
+						break;
+					case 4:
+						vert.color = glm::make_vec4(&bufferColors[v * 4]);
+						break;
 				}
 			}
-			Primitive *newPrimitive = new Primitive(indexStart, indexCount, primitive.material > -1 ? materials[primitive.material] : materials.back());
-			newPrimitive->firstVertex = vertexStart;
-			newPrimitive->vertexCount = vertexCount;
-			newPrimitive->setDimensions(posMin, posMax);
-			newMesh->primitives.push_back(newPrimitive);
+			else {
+				vert.color = glm::vec4(1.0f);
+			}
+			vert.tangent = bufferTangents ? glm::vec4(glm::make_vec4(&bufferTangents[v * 4])) : glm::vec4(0.0f);
+			vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * 4])) : glm::vec4(0.0f);
+			vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * 4]) : glm::vec4(0.0f);
+			vert.materialId = primitive.material;
+			vert.meshId = source.meshIndex;
+			// Pre-transform vertex positions by node-hierarchy
+			if (preTransform) {
+				vert.pos = glm::vec3(localMatrix * glm::vec4(vert.pos, 1.0f));
+				vert.normal = glm::normalize(glm::mat3(localMatrix) * vert.normal);
+			}
+			// Flip Y-Axis of vertex positions
+			if (flipY) {
+				vert.pos.y *= -1.0f;
+				vert.normal.y *= -1.0f;
+			}
+			// Pre-Multiply vertex colors with material base color
+			if (preMultiplyColor) {
+				vert.color = target->material.baseColorFactor * vert.color;
+			}
 		}
-		newNode->mesh = newMesh;
 	}
-	if (parent) {
-		parent->children.push_back(newNode);
-	} else {
-		nodes.push_back(newNode);
+	// Indices
+	{
+		const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
+		const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
+		const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
+		const unsigned char *data = &buffer.data[accessor.byteOffset + bufferView.byteOffset];
+
+		uint32_t *indices = indexBuffer + target->firstIndex;
+		switch (accessor.componentType) {
+		case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
+			const uint32_t *buf = reinterpret_cast<const uint32_t *>(data);
+			for (size_t index = 0; index < accessor.count; index++) {
+				indices[index] = buf[index] + target->firstVertex;
+			}
+			break;
+		}
+		case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
+			const uint16_t *buf = reinterpret_cast<const uint16_t *>(data);
+			for (size_t index = 0; index < accessor.count; index++) {
+				indices[index] = buf[index] + target->firstVertex;
+			}
+			break;
+		}
+		case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
+			for (size_t index = 0; index < accessor.count; index++) {
+				indices[index] = data[index] + target->firstVertex;
+			}
+			break;
+		}
+		}
 	}
-	linearNodes.push_back(newNode);
+}
+
+/*
+	Decodes all primitives laid out by loadNode on the job system
+	Sorted largest first, idle workers steal the remaining ranges so a few big meshes don't serialize the load
+*/
+void vkglTF::Model::loadPrimitives(const tinygltf::Model &model, const std::vector<PrimitiveSource> &primitiveSources, std::vector<uint32_t> &indexBuffer, std::vector<Vertex> &vertexBuffer, uint32_t fileLoadingFlags)
+{
+	std::vector<size_t> order(primitiveSources.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&primitiveSources](size_t a, size_t b) {
+		return primitiveSources[a].target->vertexCount > primitiveSources[b].target->vertexCount;
+	});
+
+	vks::JobSystem::shared().parallelFor(static_cast<uint32_t>(order.size()), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			loadPrimitive(model, primitiveSources[order[i]], vertexBuffer.data(), indexBuffer.data(), fileLoadingFlags);
+		}
+	});
 }
 
 void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
@@ -997,13 +777,473 @@ void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 	}
 }
 
-void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
+namespace
 {
-	for (tinygltf::Image &image : gltfModel.images) {
-		vkglTF::Texture texture;
-		texture.fromglTfImage(image, path, device, transferQueue);
-		textures.push_back(texture);
+	/*
+		Pixel data of one glTF image prepared by the loader threads, referencing the decoded glTF image, a ktx file or block compressed levels
+	*/
+	struct TextureSource {
+		ktxTexture* ktx = nullptr;
+		// KTX2 files and cooked images
+		vkglTF::TextureCompression::Image compressed;
+		VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+		const unsigned char* data = nullptr;
+		VkDeviceSize size = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipLevels = 1;
+		// Levels other than the base level are blitted from it (jpg and png have no mip chain)
+		bool generateMips = false;
+		// Buffer offsets relative to data
+		std::vector<VkBufferImageCopy> regions;
+	};
+
+	void useCompressedImage(TextureSource& source)
+	{
+		const vkglTF::TextureCompression::Image& image = source.compressed;
+		source.format = image.format;
+		source.data = image.data.data();
+		source.size = image.data.size();
+		source.width = image.width;
+		source.height = image.height;
+		source.mipLevels = image.mipLevels;
+		for (uint32_t i = 0; i < image.mipLevels; i++) {
+			VkBufferImageCopy region{};
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+			region.imageExtent = { std::max(1u, image.width >> i), std::max(1u, image.height >> i), 1 };
+			region.bufferOffset = image.levelOffsets[i];
+			source.regions.push_back(region);
+		}
+	}
+
+	bool readImageFile(const std::string& filename, std::vector<unsigned char>& data)
+	{
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) {
+			return false;
+		}
+		const std::streamsize size = file.tellg();
+		if (size <= 0) {
+			return false;
+		}
+		data.resize(static_cast<size_t>(size));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(data.data()), size);
+		return file.good();
+	}
+
+	/*
+		Reads a texture file, or decodes a glTF image. With a cooked filename, decoded images are replaced
+		by their BC7 version, which is encoded and written on the first load
+	*/
+	bool loadTextureSource(tinygltf::Image& gltfimage, const std::string& path, const std::string& cookedFilename, TextureSource& source)
+	{
+		if (isKtx2Image(gltfimage)) {
+			if (!vkglTF::TextureCompression::loadKtx2(path + "/" + gltfimage.uri, source.compressed)) {
+				return false;
+			}
+			useCompressedImage(source);
+			return true;
+		}
+
+		if (isKtxImage(gltfimage)) {
+			source.ktx = loadKtxFile(path + "/" + gltfimage.uri);
+			if (!source.ktx) {
+				return false;
+			}
+			source.format = vkglTF::TextureCompression::getKtxFormat(source.ktx);
+			source.data = ktxTexture_GetData(source.ktx);
+			source.size = ktxTexture_GetSize(source.ktx);
+			source.width = source.ktx->baseWidth;
+			source.height = source.ktx->baseHeight;
+			source.mipLevels = source.ktx->numLevels;
+			for (uint32_t i = 0; i < source.mipLevels; i++) {
+				ktx_size_t offset;
+				if (ktxTexture_GetImageOffset(source.ktx, i, 0, 0, &offset) != KTX_SUCCESS) {
+					return false;
+				}
+				VkBufferImageCopy region{};
+				region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+				region.imageExtent = { std::max(1u, source.width >> i), std::max(1u, source.height >> i), 1 };
+				region.bufferOffset = offset;
+				source.regions.push_back(region);
+			}
+			return true;
+		}
+
+		// Images restored from the scene cache are only referenced, their file is read here on the loader threads
+		if (gltfimage.as_is && gltfimage.image.empty() && !readImageFile(path + "/" + gltfimage.uri, gltfimage.image)) {
+			return false;
+		}
+
+		uint64_t sourceKey = 0;
+		if (!cookedFilename.empty() && gltfimage.as_is) {
+			sourceKey = vkglTF::TextureCompression::computeSourceKey(gltfimage.image.data(), gltfimage.image.size());
+			uint64_t cookedKey = 0;
+			if (vkglTF::TextureCompression::loadKtx2(cookedFilename, source.compressed, &cookedKey) && cookedKey == sourceKey) {
+				std::vector<unsigned char>().swap(gltfimage.image);
+				useCompressedImage(source);
+				return true;
+			}
+			source.compressed = vkglTF::TextureCompression::Image();
+		}
+
+		if (!vkglTF::Texture::decodeImage(gltfimage)) {
+			return false;
+		}
+		if (sourceKey != 0) {
+			vkglTF::TextureCompression::encodeBC7(gltfimage.image.data(), gltfimage.width, gltfimage.height, source.compressed);
+			// A failed write only costs the encoding on the next start-up
+			vkglTF::TextureCompression::writeKtx2(cookedFilename, source.compressed, sourceKey);
+			std::vector<unsigned char>().swap(gltfimage.image);
+			useCompressedImage(source);
+			return true;
+		}
+		source.data = gltfimage.image.data();
+		source.size = gltfimage.image.size();
+		source.width = gltfimage.width;
+		source.height = gltfimage.height;
+		source.mipLevels = static_cast<uint32_t>(floor(log2(std::max(source.width, source.height))) + 1.0);
+		source.generateMips = true;
+		VkBufferImageCopy region{};
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.imageExtent = { source.width, source.height, 1 };
+		source.regions.push_back(region);
+		return true;
+	}
+
+	/*
+		Persistently mapped staging buffer used as a ring of segments. Each segment records its copies into its own command buffer
+		and is submitted once full, it is only refilled after its fence signaled. So the next segment is filled while the copies
+		of the previous one execute, instead of one staging buffer and one blocking submit per texture
+	*/
+	class StagingRing {
+	public:
+		StagingRing(vks::VulkanDevice* device, VkQueue queue, uint32_t queueFamilyIndex, VkDeviceSize segmentSize)
+			: device(device), queue(queue), segmentSize((segmentSize + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+		{
+			commandPool = device->createCommandPool(queueFamilyIndex);
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				this->segmentSize * SEGMENT_COUNT,
+				&buffer,
+				&memory));
+			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, memory, 0, VK_WHOLE_SIZE, 0, (void**)&mapped));
+			for (Segment& segment : segments) {
+				segment.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool, false);
+				VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+				VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceInfo, nullptr, &segment.fence));
+			}
+		}
+
+		~StagingRing()
+		{
+			finish();
+			vkUnmapMemory(device->logicalDevice, memory);
+			vkDestroyBuffer(device->logicalDevice, buffer, nullptr);
+			vkFreeMemory(device->logicalDevice, memory, nullptr);
+			for (Segment& segment : segments) {
+				vkDestroyFence(device->logicalDevice, segment.fence, nullptr);
+			}
+			vkDestroyCommandPool(device->logicalDevice, commandPool, nullptr);
+		}
+
+		// Reserves size bytes (at most the segment size), returns the command buffer the copies from them have to be recorded to
+		VkCommandBuffer allocate(VkDeviceSize size, VkDeviceSize& offset, unsigned char*& data)
+		{
+			assert(size <= segmentSize);
+			if (recording && used + size > segmentSize) {
+				submit();
+			}
+			if (!recording) {
+				begin();
+			}
+			offset = current * segmentSize + used;
+			data = mapped + offset;
+			used = (used + size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+			return segments[current].commandBuffer;
+		}
+
+		VkBuffer getBuffer() const { return buffer; }
+
+		// Submits the pending copies and waits for all of them
+		void finish()
+		{
+			submit();
+			for (Segment& segment : segments) {
+				VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &segment.fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			}
+		}
+
+	private:
+		static const uint32_t SEGMENT_COUNT = 2;
+		// Satisfies the buffer offset alignment of copies for RGBA8 and all block compressed formats
+		static const VkDeviceSize ALIGNMENT = 16;
+
+		struct Segment {
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+		};
+
+		vks::VulkanDevice* device;
+		VkQueue queue;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		unsigned char* mapped = nullptr;
+		VkDeviceSize segmentSize;
+		Segment segments[SEGMENT_COUNT];
+		uint32_t current = 0;
+		VkDeviceSize used = 0;
+		bool recording = false;
+
+		void begin()
+		{
+			Segment& segment = segments[current];
+			// The copies recorded the last time this segment was used have to be done before its memory is overwritten
+			VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &segment.fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &segment.fence));
+			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+			VK_CHECK_RESULT(vkBeginCommandBuffer(segment.commandBuffer, &cmdBufInfo));
+			used = 0;
+			recording = true;
+		}
+
+		void submit()
+		{
+			if (!recording) {
+				return;
+			}
+			Segment& segment = segments[current];
+			VK_CHECK_RESULT(vkEndCommandBuffer(segment.commandBuffer));
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &segment.commandBuffer;
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, segment.fence));
+			recording = false;
+			current = (current + 1) % SEGMENT_COUNT;
+		}
+	};
+}
+
+/*
+	Decoding runs on a thread pool, uploads are batched through a staging ring on the transfer queue
+	and all mip chains are generated by one command buffer on the graphics queue at the end
+*/
+void vkglTF::Model::loadImages(std::vector<tinygltf::Image> &images, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags)
+{
+	std::vector<TextureSource> sources(images.size());
+
+	// jpg and png images are cooked to BC7 if requested and the device can sample it
+	bool compressTextures = (fileLoadingFlags & FileLoadingFlags::CompressTextures) && device->enabledFeatures.textureCompressionBC
+		&& vkglTF::TextureCompression::isFormatSupported(device->physicalDevice, VK_FORMAT_BC7_UNORM_BLOCK);
+#if defined(__ANDROID__)
+	compressTextures = false;
+#endif
+	// BC7 mode 6 blurs normal and metallic roughness data, only images used purely as color are cooked (1 color, 2 data)
+	std::vector<char> cookImage(sources.size(), 0);
+	if (compressTextures) {
+		auto markImage = [&](int image, char value) {
+			if (image >= 0 && image < static_cast<int>(cookImage.size()) && cookImage[image] != 2) {
+				cookImage[image] = value;
+			}
+		};
+		for (const Material& material : materials) {
+			markImage(material.baseColorTextureId, 1);
+			markImage(material.emissiveTextureId, 1);
+		}
+		// Data use wins over color use of the same image
+		for (const Material& material : materials) {
+			markImage(material.normalTextureId, 2);
+			markImage(material.metallicRoughnessTextureId, 2);
+			markImage(material.occlusionTextureId, 2);
+		}
+	}
+
+	// Decode the images, expand RGB to RGBA and read ktx files on all cores
+	{
+		std::vector<char> loaded(sources.size(), 0);
+		vks::JobSystem::shared().parallelFor(static_cast<uint32_t>(sources.size()), 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				const std::string cookedFilename = (cookImage[i] == 1) ? vkglTF::TextureCompression::cookedFilename(filename, i) : std::string();
+				loaded[i] = loadTextureSource(images[i], path, cookedFilename, sources[i]) ? 1 : 0;
+			}
+		});
+		for (size_t i = 0; i < sources.size(); i++) {
+			if (!loaded[i]) {
+				vks::tools::exitFatal("Could not load texture \"" + images[i].uri + "\" from " + path + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
+			}
+			if (sources[i].format == VK_FORMAT_UNDEFINED || !vkglTF::TextureCompression::isFormatSupported(device->physicalDevice, sources[i].format)) {
+				vks::tools::exitFatal("The format of texture \"" + images[i].uri + "\" is not supported by the device", -1);
+			}
+		}
 	}
+
+	if (!sources.empty()) {
+		// The transfer queue may belong to another family, the images are then handed over to the graphics queue for the mip generation
+		const uint32_t graphicsFamily = device->queueFamilyIndices.graphics;
+		const uint32_t transferFamily = device->queueFamilyIndices.transfer;
+		const bool ownershipTransfer = transferFamily != graphicsFamily;
+		VkQueue uploadQueue = transferQueue;
+		if (ownershipTransfer) {
+			vkGetDeviceQueue(device->logicalDevice, transferFamily, 0, &uploadQueue);
+		}
+
+		VkDeviceSize largestUpload = 0;
+		for (const TextureSource& source : sources) {
+			largestUpload = std::max(largestUpload, source.size);
+		}
+		const VkDeviceSize stagingSegmentSize = 32 * 1024 * 1024;
+		StagingRing stagingRing(device, uploadQueue, transferFamily, std::max(stagingSegmentSize, largestUpload));
+
+		const size_t firstTexture = textures.size();
+		textures.resize(firstTexture + sources.size());
+		for (size_t i = 0; i < sources.size(); i++) {
+			TextureSource& source = sources[i];
+			vkglTF::Texture& texture = textures[firstTexture + i];
+			texture.device = device;
+			texture.width = source.width;
+			texture.height = source.height;
+			texture.mipLevels = source.mipLevels;
+			texture.layerCount = 1;
+
+			VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageCreateInfo.format = source.format;
+			imageCreateInfo.mipLevels = texture.mipLevels;
+			imageCreateInfo.arrayLayers = 1;
+			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageCreateInfo.extent = { texture.width, texture.height, 1 };
+			imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			if (source.generateMips) {
+				imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			}
+			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &texture.image));
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device->logicalDevice, texture.image, &memReqs);
+			VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+			memAllocInfo.allocationSize = memReqs.size;
+			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &texture.deviceMemory));
+			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, texture.image, texture.deviceMemory, 0));
+
+			VkDeviceSize stagingOffset;
+			unsigned char* stagingData;
+			VkCommandBuffer copyCmd = stagingRing.allocate(source.size, stagingOffset, stagingData);
+			memcpy(stagingData, source.data, source.size);
+			for (VkBufferImageCopy& region : source.regions) {
+				region.bufferOffset += stagingOffset;
+			}
+
+			// All levels stay transfer destinations until the mip pass
+			VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1 };
+			vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+			vkCmdCopyBufferToImage(copyCmd, stagingRing.getBuffer(), texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(source.regions.size()), source.regions.data());
+			if (ownershipTransfer) {
+				VkImageMemoryBarrier releaseBarrier = vks::initializers::imageMemoryBarrier();
+				releaseBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				releaseBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				releaseBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				releaseBarrier.srcQueueFamilyIndex = transferFamily;
+				releaseBarrier.dstQueueFamilyIndex = graphicsFamily;
+				releaseBarrier.image = texture.image;
+				releaseBarrier.subresourceRange = subresourceRange;
+				vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &releaseBarrier);
+			}
+
+			// The pixels live in the staging buffer now
+			if (source.ktx) {
+				ktxTexture_Destroy(source.ktx);
+				source.ktx = nullptr;
+			}
+			else {
+				std::vector<unsigned char>().swap(images[i].image);
+				std::vector<unsigned char>().swap(source.compressed.data);
+			}
+			source.data = nullptr;
+		}
+		stagingRing.finish();
+
+		VkCommandBuffer mipCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		std::vector<VkImageMemoryBarrier> barriers;
+		barriers.reserve(sources.size());
+		auto addBarrier = [&](VkImage image, uint32_t baseMipLevel, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask) {
+			VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.srcAccessMask = srcAccessMask;
+			barrier.dstAccessMask = dstAccessMask;
+			barrier.image = image;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseMipLevel, levelCount, 0, 1 };
+			barriers.push_back(barrier);
+		};
+
+		if (ownershipTransfer) {
+			for (size_t i = 0; i < sources.size(); i++) {
+				const vkglTF::Texture& texture = textures[firstTexture + i];
+				addBarrier(texture.image, 0, texture.mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+				barriers.back().srcQueueFamilyIndex = transferFamily;
+				barriers.back().dstQueueFamilyIndex = graphicsFamily;
+			}
+			vkCmdPipelineBarrier(mipCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+		}
+
+		// Level by level for all textures at once, so each step needs a single barrier
+		uint32_t maxMipLevels = 0;
+		for (const TextureSource& source : sources) {
+			if (source.generateMips) {
+				maxMipLevels = std::max(maxMipLevels, source.mipLevels);
+			}
+		}
+		for (uint32_t level = 1; level <= maxMipLevels; level++) {
+			// The previous level is complete and becomes the blit source
+			barriers.clear();
+			for (size_t i = 0; i < sources.size(); i++) {
+				if (sources[i].generateMips && sources[i].mipLevels >= level) {
+					addBarrier(textures[firstTexture + i].image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+				}
+			}
+			vkCmdPipelineBarrier(mipCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+			for (size_t i = 0; i < sources.size(); i++) {
+				if (!sources[i].generateMips || sources[i].mipLevels <= level) {
+					continue;
+				}
+				const vkglTF::Texture& texture = textures[firstTexture + i];
+				VkImageBlit imageBlit{};
+				imageBlit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+				imageBlit.srcOffsets[1] = { int32_t(std::max(1u, texture.width >> (level - 1))), int32_t(std::max(1u, texture.height >> (level - 1))), 1 };
+				imageBlit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+				imageBlit.dstOffsets[1] = { int32_t(std::max(1u, texture.width >> level)), int32_t(std::max(1u, texture.height >> level)), 1 };
+				vkCmdBlitImage(mipCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+			}
+		}
+
+		// Generated chains are transfer sources by now, ktx files and compressed images still transfer destinations
+		barriers.clear();
+		for (size_t i = 0; i < sources.size(); i++) {
+			const vkglTF::Texture& texture = textures[firstTexture + i];
+			if (sources[i].generateMips) {
+				addBarrier(texture.image, 0, texture.mipLevels, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+			}
+			else {
+				addBarrier(texture.image, 0, texture.mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+			}
+		}
+		vkCmdPipelineBarrier(mipCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+		device->flushCommandBuffer(mipCmd, transferQueue, true);
+
+		for (size_t i = 0; i < sources.size(); i++) {
+			vkglTF::Texture& texture = textures[firstTexture + i];
+			texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			texture.createSamplerAndView(sources[i].format);
+		}
+	}
+
 	// Create an empty texture to be used for empty material images
 	createEmptyTexture(transferQueue);
 }
@@ -1012,13 +1252,13 @@ void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
 {
 	for (tinygltf::Material &mat : gltfModel.materials) {
 		vkglTF::Material material(device);
+		// Index into textures, which holds one texture per glTF image
 		if (mat.values.find("baseColorTexture") != mat.values.end()) {
-			material.baseColorTexture = getTexture(gltfModel.textures[mat.values["baseColorTexture"].TextureIndex()].source);
-			material.baseColorTextureId = mat.values["baseColorTexture"].TextureIndex();
+			material.baseColorTextureId = gltfModel.textures[mat.values["baseColorTexture"].TextureIndex()].source;
 		}
 		// Metallic roughness workflow
 		if (mat.values.find("metallicRoughnessTexture") != mat.values.end()) {
-			material.metallicRoughnessTexture = getTexture(gltfModel.textures[mat.values["metallicRoughnessTexture"].TextureIndex()].source);
+			material.metallicRoughnessTextureId = gltfModel.textures[mat.values["metallicRoughnessTexture"].TextureIndex()].source;
 		}
 		if (mat.values.find("roughnessFactor") != mat.values.end()) {
 			material.roughnessFactor = static_cast<float>(mat.values["roughnessFactor"].Factor());
@@ -1034,15 +1274,13 @@ void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
 			material.emissiveFactor = glm::make_vec4(mat.values["emissiveFactor"].ColorFactor().data());
 		}
 		if (mat.additionalValues.find("normalTexture") != mat.additionalValues.end()) {
-			material.normalTexture = getTexture(gltfModel.textures[mat.additionalValues["normalTexture"].TextureIndex()].source);
-		} else {
-			material.normalTexture = &emptyTexture;
+			material.normalTextureId = gltfModel.textures[mat.additionalValues["normalTexture"].TextureIndex()].source;
 		}
 		if (mat.additionalValues.find("emissiveTexture") != mat.additionalValues.end()) {
-			material.emissiveTexture = getTexture(gltfModel.textures[mat.additionalValues["emissiveTexture"].TextureIndex()].source);
+			material.emissiveTextureId = gltfModel.textures[mat.additionalValues["emissiveTexture"].TextureIndex()].source;
 		}
 		if (mat.additionalValues.find("occlusionTexture") != mat.additionalValues.end()) {
-			material.occlusionTexture = getTexture(gltfModel.textures[mat.additionalValues["occlusionTexture"].TextureIndex()].source);
+			material.occlusionTextureId = gltfModel.textures[mat.additionalValues["occlusionTexture"].TextureIndex()].source;
 		}
 		if (mat.additionalValues.find("alphaMode") != mat.additionalValues.end()) {
 			tinygltf::Parameter param = mat.additionalValues["alphaMode"];
@@ -1063,6 +1301,39 @@ void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
 	materials.push_back(Material(device));
 }
 
+void vkglTF::Model::bindMaterialTextures()
+{
+	auto texture = [&](int id) {
+		return id > -1 ? getTexture(static_cast<uint32_t>(id)) : nullptr;
+	};
+	for (Material &material : materials) {
+		material.baseColorTexture = texture(material.baseColorTextureId);
+		material.metallicRoughnessTexture = texture(material.metallicRoughnessTextureId);
+		material.normalTexture = material.normalTextureId > -1 ? texture(material.normalTextureId) : &emptyTexture;
+		material.occlusionTexture = texture(material.occlusionTextureId);
+		material.emissiveTexture = texture(material.emissiveTextureId);
+	}
+}
+
+void vkglTF::Model::createShadeMaterials()
+{
+	std::vector<GltfShadeMaterial> shadeMaterialBuffer(materials.size());
+	for (size_t i = 0; i < materials.size(); i++) {
+		shadeMaterialBuffer[i].baseColorFactor = materials[i].baseColorFactor;
+		shadeMaterialBuffer[i].baseColorTextureId = glm::vec4(static_cast<float>(materials[i].baseColorTextureId));
+		shadeMaterialBuffer[i].normalTextureId = glm::vec4(static_cast<float>(materials[i].normalTextureId));
+	}
+	shadeMaterials.count = static_cast<int>(shadeMaterialBuffer.size());
+	// Small and rarely read, so it stays in host visible memory
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		shadeMaterialBuffer.size() * sizeof(GltfShadeMaterial),
+		&shadeMaterials.buffer,
+		&shadeMaterials.memory,
+		shadeMaterialBuffer.data()));
+}
+
 void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 {
 	for (tinygltf::Animation &anim : gltfModel.animations) {
@@ -1175,118 +1446,484 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 	}
 }
 
-void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
+/*
+	Scene description of the scene cache, everything loadFromFile otherwise reads from the glTF file apart from the geometry.
+	Nodes are stored in the order of linearNodes (children before their parent), their primitives in the order of the primitive table
+*/
+std::vector<uint8_t> vkglTF::Model::serializeScene(const std::vector<tinygltf::Image> &images)
 {
-	tinygltf::Model gltfModel;
-	tinygltf::TinyGLTF gltfContext;
-	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
-		gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
-	} else {
-		gltfContext.SetImageLoader(loadImageDataFunc, nullptr);
+	SceneCache::Writer writer;
+
+	writer.write(static_cast<uint32_t>(images.size()));
+	for (const tinygltf::Image &image : images) {
+		writer.write(image.uri);
+		writer.write(image.image);
 	}
-#if defined(__ANDROID__)
-	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
-	// We let tinygltf handle this, by passing the asset manager of our app
-	tinygltf::asset_manager = androidApp->activity->assetManager;
-#endif
+
+	writer.write(static_cast<uint32_t>(materials.size()));
+	for (const Material &material : materials) {
+		const int32_t textureIds[] = { material.baseColorTextureId, material.metallicRoughnessTextureId, material.normalTextureId, material.occlusionTextureId, material.emissiveTextureId };
+		writer.write(static_cast<int32_t>(material.alphaMode));
+		writer.write(material.alphaCutoff);
+		writer.write(material.metallicFactor);
+		writer.write(material.roughnessFactor);
+		writer.write(material.baseColorFactor);
+		writer.write(material.emissiveFactor);
+		writer.write(textureIds);
+	}
+
+	std::unordered_map<const Node*, int32_t> linearIndices;
+	for (size_t i = 0; i < linearNodes.size(); i++) {
+		linearIndices[linearNodes[i]] = static_cast<int32_t>(i);
+	}
+	writer.write(static_cast<uint32_t>(linearNodes.size()));
+	for (const Node *node : linearNodes) {
+		writer.write(node->parent ? linearIndices[node->parent] : -1);
+		writer.write(node->index);
+		writer.write(node->skinIndex);
+		writer.write(node->translation);
+		writer.write(node->scale);
+		writer.write(node->rotation);
+		writer.write(node->matrix);
+		writer.write(node->name);
+		writer.write(static_cast<uint8_t>(node->mesh ? 1 : 0));
+		if (node->mesh) {
+			std::vector<int32_t> primitiveMaterials;
+			for (const Primitive *primitive : node->mesh->primitives) {
+				primitiveMaterials.push_back(static_cast<int32_t>(&primitive->material - materials.data()));
+			}
+			writer.write(node->mesh->name);
+			writer.write(primitiveMaterials);
+		}
+	}
+
+	writer.write(static_cast<uint32_t>(skins.size()));
+	for (const Skin *skin : skins) {
+		std::vector<uint32_t> joints;
+		for (const Node *joint : skin->joints) {
+			joints.push_back(joint->index);
+		}
+		writer.write(skin->name);
+		writer.write(skin->skeletonRoot ? static_cast<int32_t>(skin->skeletonRoot->index) : -1);
+		writer.write(joints);
+		writer.write(skin->inverseBindMatrices);
+	}
+
+	writer.write(static_cast<uint32_t>(animations.size()));
+	for (const Animation &animation : animations) {
+		writer.write(animation.name);
+		writer.write(animation.start);
+		writer.write(animation.end);
+		writer.write(static_cast<uint32_t>(animation.samplers.size()));
+		for (const AnimationSampler &sampler : animation.samplers) {
+			writer.write(static_cast<int32_t>(sampler.interpolation));
+			writer.write(sampler.inputs);
+			writer.write(sampler.outputsVec4);
+		}
+		writer.write(static_cast<uint32_t>(animation.channels.size()));
+		for (const AnimationChannel &channel : animation.channels) {
+			writer.write(static_cast<int32_t>(channel.path));
+			writer.write(channel.node->index);
+			writer.write(channel.samplerIndex);
+		}
+	}
+
+	writer.write(static_cast<uint8_t>(metallicRoughnessWorkflow ? 1 : 0));
+	return writer.data;
+}
+
+bool vkglTF::Model::deserializeScene(SceneCache &sceneCache, std::vector<tinygltf::Image> &images)
+{
+	SceneCache::Reader reader = sceneCache.sceneReader();
+	bool linked = false;
+	auto fail = [&]() {
+		// Until the hierarchy is linked every node is deleted on its own, afterwards together with its parent
+		for (Node *node : linked ? nodes : linearNodes) {
+			delete node;
+		}
+		nodes.clear();
+		linearNodes.clear();
+		for (Skin *skin : skins) {
+			delete skin;
+		}
+		skins.clear();
+		materials.clear();
+		animations.clear();
+		images.clear();
+		metallicRoughnessWorkflow = true;
+		return false;
+	};
+
+	uint32_t imageCount;
+	if (!reader.readCount(imageCount)) {
+		return fail();
+	}
+	images.resize(imageCount);
+	for (tinygltf::Image &image : images) {
+		// Files are read by loadImages, images without either were not loaded when the cache was written
+		if (!reader.read(image.uri) || !reader.read(image.image) || (image.uri.empty() && image.image.empty())) {
+			return fail();
+		}
+		image.as_is = true;
+	}
+
+	uint32_t materialCount;
+	if (!reader.readCount(materialCount) || materialCount == 0) {
+		return fail();
+	}
+	for (uint32_t i = 0; i < materialCount; i++) {
+		Material material(device);
+		int32_t alphaMode;
+		int32_t textureIds[5];
+		if (!reader.read(alphaMode) || !reader.read(material.alphaCutoff) || !reader.read(material.metallicFactor) || !reader.read(material.roughnessFactor)
+			|| !reader.read(material.baseColorFactor) || !reader.read(material.emissiveFactor) || !reader.read(textureIds)) {
+			return fail();
+		}
+		if (alphaMode < Material::ALPHAMODE_OPAQUE || alphaMode > Material::ALPHAMODE_BLEND) {
+			return fail();
+		}
+		for (int32_t textureId : textureIds) {
+			if (textureId < -1 || textureId >= static_cast<int32_t>(imageCount)) {
+				return fail();
+			}
+		}
+		material.alphaMode = static_cast<Material::AlphaMode>(alphaMode);
+		material.baseColorTextureId = textureIds[0];
+		material.metallicRoughnessTextureId = textureIds[1];
+		material.normalTextureId = textureIds[2];
+		material.occlusionTextureId = textureIds[3];
+		material.emissiveTextureId = textureIds[4];
+		materials.push_back(material);
+	}
+
+	uint32_t nodeCount;
+	if (!reader.readCount(nodeCount)) {
+		return fail();
+	}
+	std::vector<int32_t> parents(nodeCount);
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		Node *node = new Node{};
+		linearNodes.push_back(node);
+		uint8_t hasMesh;
+		if (!reader.read(parents[i]) || !reader.read(node->index) || !reader.read(node->skinIndex) || !reader.read(node->translation) || !reader.read(node->scale)
+			|| !reader.read(node->rotation) || !reader.read(node->matrix) || !reader.read(node->name) || !reader.read(hasMesh)) {
+			return fail();
+		}
+		if (parents[i] != -1 && (parents[i] <= static_cast<int32_t>(i) || parents[i] >= static_cast<int32_t>(nodeCount))) {
+			return fail();
+		}
+		if (!hasMesh) {
+			continue;
+		}
+		node->mesh = new Mesh(device, node->matrix);
+		std::vector<int32_t> primitiveMaterials;
+		if (!reader.read(node->mesh->name) || !reader.read(primitiveMaterials)) {
+			return fail();
+		}
+		for (int32_t material : primitiveMaterials) {
+			const SceneCache::Primitive *cached = sceneCache.nextPrimitive();
+			if (!cached || material < 0 || material >= static_cast<int32_t>(materials.size())) {
+				return fail();
+			}
+			Primitive *newPrimitive = new Primitive(cached->firstIndex, cached->indexCount, materials[material]);
+			newPrimitive->firstVertex = cached->firstVertex;
+			newPrimitive->vertexCount = cached->vertexCount;
+			newPrimitive->setDimensions(cached->min, cached->max);
+			node->mesh->primitives.push_back(newPrimitive);
+		}
+	}
+	if (sceneCache.primitivesUsed() != sceneCache.streams().primitiveCount) {
+		return fail();
+	}
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		if (parents[i] > -1) {
+			linearNodes[i]->parent = linearNodes[parents[i]];
+			linearNodes[parents[i]]->children.push_back(linearNodes[i]);
+		} else {
+			nodes.push_back(linearNodes[i]);
+		}
+	}
+	linked = true;
+
+	uint32_t skinCount;
+	if (!reader.readCount(skinCount)) {
+		return fail();
+	}
+	for (uint32_t i = 0; i < skinCount; i++) {
+		Skin *skin = new Skin{};
+		skins.push_back(skin);
+		int32_t skeletonRoot;
+		std::vector<uint32_t> joints;
+		if (!reader.read(skin->name) || !reader.read(skeletonRoot) || !reader.read(joints) || !reader.read(skin->inverseBindMatrices)) {
+			return fail();
+		}
+		if (skeletonRoot > -1) {
+			skin->skeletonRoot = nodeFromIndex(static_cast<uint32_t>(skeletonRoot));
+		}
+		for (uint32_t joint : joints) {
+			Node *node = nodeFromIndex(joint);
+			if (!node) {
+				return fail();
+			}
+			skin->joints.push_back(node);
+		}
+		if (skin->inverseBindMatrices.size() < skin->joints.size()) {
+			return fail();
+		}
+	}
+	for (Node *node : linearNodes) {
+		if (node->skinIndex < -1 || node->skinIndex >= static_cast<int32_t>(skins.size())) {
+			return fail();
+		}
+	}
+
+	uint32_t animationCount;
+	if (!reader.readCount(animationCount)) {
+		return fail();
+	}
+	for (uint32_t i = 0; i < animationCount; i++) {
+		Animation animation{};
+		uint32_t samplerCount;
+		if (!reader.read(animation.name) || !reader.read(animation.start) || !reader.read(animation.end) || !reader.readCount(samplerCount)) {
+			return fail();
+		}
+		for (uint32_t j = 0; j < samplerCount; j++) {
+			AnimationSampler sampler{};
+			int32_t interpolation;
+			if (!reader.read(interpolation) || !reader.read(sampler.inputs) || !reader.read(sampler.outputsVec4)) {
+				return fail();
+			}
+			if (interpolation < AnimationSampler::LINEAR || interpolation > AnimationSampler::CUBICSPLINE) {
+				return fail();
+			}
+			sampler.interpolation = static_cast<AnimationSampler::InterpolationType>(interpolation);
+			animation.samplers.push_back(sampler);
+		}
+		uint32_t channelCount;
+		if (!reader.readCount(channelCount)) {
+			return fail();
+		}
+		for (uint32_t j = 0; j < channelCount; j++) {
+			AnimationChannel channel{};
+			int32_t channelPath;
+			uint32_t nodeIndex;
+			if (!reader.read(channelPath) || !reader.read(nodeIndex) || !reader.read(channel.samplerIndex)) {
+				return fail();
+			}
+			if (channelPath < AnimationChannel::TRANSLATION || channelPath > AnimationChannel::SCALE || channel.samplerIndex >= animation.samplers.size()) {
+				return fail();
+			}
+			channel.path = static_cast<AnimationChannel::PathType>(channelPath);
+			channel.node = nodeFromIndex(nodeIndex);
+			if (!channel.node) {
+				return fail();
+			}
+			animation.channels.push_back(channel);
+		}
+		animations.push_back(animation);
+	}
+
+	uint8_t workflow;
+	if (!reader.read(workflow) || !reader.atEnd()) {
+		return fail();
+	}
+	metallicRoughnessWorkflow = workflow != 0;
+	return true;
+}
+
+void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
+{
 	size_t pos = filename.find_last_of('/');
 	path = filename.substr(0, pos);
-
-	std::string error, warning;
+	this->filename = filename;
+	cacheKey = 0;
 
 	this->device = device;
 
-#if defined(__ANDROID__)
-	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
-	// We let tinygltf handle this, by passing the asset manager of our app
-	tinygltf::asset_manager = androidApp->activity->assetManager;
+	// Scene cooked by an earlier load of the same file with the same flags. A hit restores the whole scene
+	// from the cache and the glTF file is not parsed at all
+	SceneCache sceneCache;
+	bool cacheHit = false;
+	std::vector<tinygltf::Image> images;
+#if !defined(__ANDROID__)
+	cacheKey = SceneCache::computeKey(filename, fileLoadingFlags, scale);
+	cacheHit = sceneCache.open(SceneCache::cacheFilename(filename), cacheKey) && deserializeScene(sceneCache, images);
+	if (!cacheHit) {
+		sceneCache.close();
+	}
 #endif
-	bool fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
 
 	std::vector<uint32_t> indexBuffer;
 	std::vector<Vertex> vertexBuffer;
-
-	if (fileLoaded) {
-		if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
-			loadImages(gltfModel, device, transferQueue);
+	// Images as referenced by the glTF file, for the scene description of a new cache
+	std::vector<tinygltf::Image> cacheImages;
+
+	if (!cacheHit) {
+		tinygltf::Model gltfModel;
+		tinygltf::TinyGLTF gltfContext;
+		if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
+			gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
+		} else {
+			gltfContext.SetImageLoader(loadImageDataFunc, nullptr);
+		}
+#if defined(__ANDROID__)
+		// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
+		// We let tinygltf handle this, by passing the asset manager of our app
+		tinygltf::asset_manager = androidApp->activity->assetManager;
+#endif
+		std::string error, warning;
+		if (!gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename)) {
+			// TODO: throw
+			vks::tools::exitFatal("Could not load glTF file \"" + filename + "\": " + error, -1);
+			return;
 		}
+
 		loadMaterials(gltfModel);
+		// Serial pass building the node hierarchy and the buffer range of every primitive, then a parallel pass decoding the primitives
 		const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+		std::vector<PrimitiveSource> primitiveSources;
+		uint32_t indexCount = 0;
+		uint32_t vertexCount = 0;
 		for (size_t i = 0; i < scene.nodes.size(); i++) {
-			const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
-			loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
+			const tinygltf::Node &node = gltfModel.nodes[scene.nodes[i]];
+			loadNode(nullptr, node, scene.nodes[i], gltfModel, primitiveSources, indexCount, vertexCount, scale);
 		}
+		indexBuffer.resize(indexCount);
+		vertexBuffer.resize(vertexCount);
+		loadPrimitives(gltfModel, primitiveSources, indexBuffer, vertexBuffer, fileLoadingFlags);
 		if (gltfModel.animations.size() > 0) {
 			loadAnimations(gltfModel);
 		}
 		loadSkins(gltfModel);
 
-		for (auto node : linearNodes) {
-			// Assign skins
-			if (node->skinIndex > -1) {
-				node->skin = skins[node->skinIndex];
+		for (auto extension : gltfModel.extensionsUsed) {
+			if (extension == "KHR_materials_pbrSpecularGlossiness") {
+				std::cout << "Required extension: " << extension;
+				metallicRoughnessWorkflow = false;
 			}
-			// Initial pose
-			if (node->mesh) {
-				node->update();
+		}
+
+		// Image files are only referenced by the cache, embedded images keep their encoded bytes
+		cacheImages.resize(gltfModel.images.size());
+		for (size_t i = 0; i < gltfModel.images.size(); i++) {
+			const tinygltf::Image &image = gltfModel.images[i];
+			if (!image.uri.empty() && !tinygltf::IsDataURI(image.uri) && vks::tools::fileExists(path + "/" + image.uri)) {
+				cacheImages[i].uri = image.uri;
+			} else {
+				cacheImages[i].image = image.image;
 			}
 		}
+		images.swap(gltfModel.images);
 	}
-	else {
-		// TODO: throw
-		vks::tools::exitFatal("Could not load glTF file \"" + filename + "\": " + error, -1);
-		return;
+
+	if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+		loadImages(images, device, transferQueue, fileLoadingFlags);
 	}
+	bindMaterialTextures();
 
-	// Pre-Calculations for requested features
-	if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
-		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
-		const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
-		const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
+	for (auto node : linearNodes) {
+		// Assign skins
+		if (node->skinIndex > -1) {
+			node->skin = skins[node->skinIndex];
+		}
+		// Initial pose
+		if (node->mesh) {
+			node->update();
+		}
+	}
+
+	// Transform baked into the vertices by loadPrimitive (or the cache)
+	if (fileLoadingFlags & FileLoadingFlags::FlipY) {
+		axisMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, -1.0f, 1.0f));
+	}
+	for (Node* node : linearNodes) {
+		if (node->mesh) {
+			node->bakedMatrix = (fileLoadingFlags & FileLoadingFlags::PreTransformVertices) ? axisMatrix * node->getMatrix() : axisMatrix;
+		}
+	}
+
+	std::vector<HitVertex> hitVertexBuffer;
+	std::vector<HitTriangle> hitTriangleBuffer;
+	SceneCache::Streams streams{};
+	if (cacheHit) {
+		// Uploaded straight from the mapped cache file
+		streams = sceneCache.streams();
+		emissiveTriangles.assign(streams.emissiveTriangles, streams.emissiveTriangles + streams.emissiveTriangleCount);
+	} else {
+		// Compact streams for hit shading. All vertices of a triangle share the material of their primitive
+		hitVertexBuffer.resize(vertexBuffer.size());
+		for (size_t i = 0; i < vertexBuffer.size(); i++) {
+			hitVertexBuffer[i] = HitVertex::pack(vertexBuffer[i]);
+		}
+		hitTriangleBuffer.resize(indexBuffer.size() / 3);
+		for (size_t i = 0; i < hitTriangleBuffer.size(); i++) {
+			hitTriangleBuffer[i] = HitTriangle::create(vertexBuffer[indexBuffer[3 * i]], vertexBuffer[indexBuffer[3 * i + 1]], vertexBuffer[indexBuffer[3 * i + 2]]);
+		}
+
+		// Emissive triangles are sampled as area lights by the path tracer
+		emissiveTriangles.clear();
+		for (size_t i = 0; i < hitTriangleBuffer.size(); i++) {
+			int32_t materialId = hitTriangleBuffer[i].materialId;
+			if (materialId < 0 || materialId >= static_cast<int32_t>(materials.size())) {
+				continue;
+			}
+			glm::vec3 emission = glm::vec3(materials[materialId].emissiveFactor);
+			if (glm::max(emission.r, glm::max(emission.g, emission.b)) <= 0.0f) {
+				continue;
+			}
+			EmissiveTriangle triangle{};
+			triangle.p0 = vertexBuffer[indexBuffer[3 * i]].pos;
+			triangle.p1 = vertexBuffer[indexBuffer[3 * i + 1]].pos;
+			triangle.p2 = vertexBuffer[indexBuffer[3 * i + 2]].pos;
+			triangle.emission = emission;
+			emissiveTriangles.push_back(triangle);
+		}
+
+		// Primitive table in creation order, which matches the order of linearNodes
+		std::vector<SceneCache::Primitive> cachePrimitives;
 		for (Node* node : linearNodes) {
 			if (node->mesh) {
-				const glm::mat4 localMatrix = node->getMatrix();
 				for (Primitive* primitive : node->mesh->primitives) {
-					for (uint32_t i = 0; i < primitive->vertexCount; i++) {
-						Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
-						// Pre-transform vertex positions by node-hierarchy
-						if (preTransform) {
-							vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
-							vertex.normal = glm::normalize(glm::mat3(localMatrix) * vertex.normal);
-						}
-						// Flip Y-Axis of vertex positions
-						if (flipY) {
-							vertex.pos.y *= -1.0f;
-							vertex.normal.y *= -1.0f;
-						}
-						// Pre-Multiply vertex colors with material base color
-						if (preMultiplyColor) {
-							vertex.color = primitive->material.baseColorFactor * vertex.color;
-						}
-					}
+					cachePrimitives.push_back({ primitive->firstIndex, primitive->indexCount, primitive->firstVertex, primitive->vertexCount, primitive->dimensions.min, primitive->dimensions.max });
 				}
 			}
 		}
-	}
 
-	for (auto extension : gltfModel.extensionsUsed) {
-		if (extension == "KHR_materials_pbrSpecularGlossiness") {
-			std::cout << "Required extension: " << extension;
-			metallicRoughnessWorkflow = false;
-		}
+		streams.vertices = vertexBuffer.data();
+		streams.indices = indexBuffer.data();
+		streams.hitVertices = hitVertexBuffer.data();
+		streams.hitTriangles = hitTriangleBuffer.data();
+		streams.emissiveTriangles = emissiveTriangles.data();
+		streams.primitives = cachePrimitives.data();
+		streams.vertexCount = static_cast<uint32_t>(vertexBuffer.size());
+		streams.indexCount = static_cast<uint32_t>(indexBuffer.size());
+		streams.emissiveTriangleCount = static_cast<uint32_t>(emissiveTriangles.size());
+		streams.primitiveCount = static_cast<uint32_t>(cachePrimitives.size());
+#if !defined(__ANDROID__)
+		const std::vector<uint8_t> scene = serializeScene(cacheImages);
+		streams.scene = scene.data();
+		streams.sceneSize = scene.size();
+		SceneCache::write(SceneCache::cacheFilename(filename), cacheKey, streams);
+#endif
+		streams.primitives = nullptr;
+		streams.scene = nullptr;
 	}
 
-	size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
-	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
-	indices.count = static_cast<uint32_t>(indexBuffer.size());
-	vertices.count = static_cast<uint32_t>(vertexBuffer.size());
+	size_t vertexBufferSize = streams.vertexCount * sizeof(Vertex);
+	size_t indexBufferSize = streams.indexCount * sizeof(uint32_t);
+	size_t hitVertexBufferSize = streams.vertexCount * sizeof(HitVertex);
+	size_t hitTriangleBufferSize = (streams.indexCount / 3) * sizeof(HitTriangle);
+	indices.count = static_cast<uint32_t>(streams.indexCount);
+	vertices.count = static_cast<uint32_t>(streams.vertexCount);
+	hitVertices.count = static_cast<uint32_t>(streams.vertexCount);
+	hitTriangles.count = static_cast<uint32_t>(streams.indexCount / 3);
 
 	assert((vertexBufferSize > 0) && (indexBufferSize > 0));
 
 	struct StagingBuffer {
 		VkBuffer buffer;
 		VkDeviceMemory memory;
-	} vertexStaging, indexStaging;
+	} vertexStaging, indexStaging, hitVertexStaging, hitTriangleStaging;
 
 	// Create staging buffers
 	// Vertex data
@@ -1296,7 +1933,7 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		vertexBufferSize,
 		&vertexStaging.buffer,
 		&vertexStaging.memory,
-		vertexBuffer.data()));
+		const_cast<Vertex*>(streams.vertices)));
 	// Index data
 	VK_CHECK_RESULT(device->createBuffer(
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
@@ -1304,7 +1941,22 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		indexBufferSize,
 		&indexStaging.buffer,
 		&indexStaging.memory,
-		indexBuffer.data()));
+		const_cast<uint32_t*>(streams.indices)));
+	// Hit shading data
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		hitVertexBufferSize,
+		&hitVertexStaging.buffer,
+		&hitVertexStaging.memory,
+		const_cast<HitVertex*>(streams.hitVertices)));
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		hitTriangleBufferSize,
+		&hitTriangleStaging.buffer,
+		&hitTriangleStaging.memory,
+		const_cast<HitTriangle*>(streams.hitTriangles)));
 
 	// Create device local buffers
 	// Vertex buffer
@@ -1321,6 +1973,19 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 		indexBufferSize,
 		&indices.buffer,
 		&indices.memory));
+	// Hit shading buffers (storage buffers only, written by skinning for animated meshes)
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		hitVertexBufferSize,
+		&hitVertices.buffer,
+		&hitVertices.memory));
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		hitTriangleBufferSize,
+		&hitTriangles.buffer,
+		&hitTriangles.memory));
 
 	// Copy from staging buffers
 	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
@@ -1333,53 +1998,43 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 	copyRegion.size = indexBufferSize;
 	vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
 
+	copyRegion.size = hitVertexBufferSize;
+	vkCmdCopyBuffer(copyCmd, hitVertexStaging.buffer, hitVertices.buffer, 1, &copyRegion);
+
+	copyRegion.size = hitTriangleBufferSize;
+	vkCmdCopyBuffer(copyCmd, hitTriangleStaging.buffer, hitTriangles.buffer, 1, &copyRegion);
+
 	device->flushCommandBuffer(copyCmd, transferQueue, true);
 
 	vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
 	vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
 	vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
 	vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+	vkDestroyBuffer(device->logicalDevice, hitVertexStaging.buffer, nullptr);
+	vkFreeMemory(device->logicalDevice, hitVertexStaging.memory, nullptr);
+	vkDestroyBuffer(device->logicalDevice, hitTriangleStaging.buffer, nullptr);
+	vkFreeMemory(device->logicalDevice, hitTriangleStaging.memory, nullptr);
+
+	createShadeMaterials();
 
 	getSceneDimensions();
 
 	// Setup descriptors
 	uint32_t uboCount{ 0 };
-	uint32_t imageCount{ 0 };
 	for (auto node : linearNodes) {
 		if (node->mesh) {
 			uboCount++;
 		}
 	}
-	for (auto material : materials) {
-		if (material.baseColorTexture != nullptr) {
-			imageCount++;
-		}
-		if (material.normalTexture != nullptr) {
-			imageCount++;
-		}
-		if (material.metallicRoughnessTexture != nullptr) {
-			imageCount++;
-		}
-	}
+	// Materials are bound bindlessly by the renderpasses, only the per-node uniform buffers get descriptors here
 	std::vector<VkDescriptorPoolSize> poolSizes = {
 		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uboCount },
 	};
-	if (imageCount > 0) {
-		if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
-			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
-		}
-		if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
-			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
-		}
-		if (descriptorBindingFlags & DescriptorBindingFlags::MetallicRoughnessMap) {
-			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
-		}
-	}
 	VkDescriptorPoolCreateInfo descriptorPoolCI{};
 	descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	descriptorPoolCI.pPoolSizes = poolSizes.data();
-	descriptorPoolCI.maxSets = uboCount + imageCount;
+	descriptorPoolCI.maxSets = uboCount;
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
 
 	// Descriptors for per-node uniform buffers
@@ -1399,81 +2054,6 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 			prepareNodeDescriptor(node, descriptorSetLayoutUbo);
 		}
 	}
-
-	// Descriptors for per-material images
-	{
-		// Layout is global, so only create if it hasn't already been created before
-		if (descriptorSetLayoutImage == VK_NULL_HANDLE) {
-			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
-			if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
-				setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(setLayoutBindings.size())));
-			}
-			if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
-				setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(setLayoutBindings.size())));
-			}
-			if (descriptorBindingFlags & DescriptorBindingFlags::MetallicRoughnessMap) {
-				setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(setLayoutBindings.size())));
-			}
-			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
-			descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-			descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
-			descriptorLayoutCI.pBindings = setLayoutBindings.data();
-			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutImage));
-		}
-		for (auto& material : materials) {
-			if (material.baseColorTexture != nullptr) {
-				material.createDescriptorSet(descriptorPool, vkglTF::descriptorSetLayoutImage, descriptorBindingFlags);
-			}
-		}
-	}
-
-
-	VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-	descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	descriptorSetAllocInfo.descriptorPool = descriptorPool;
-	descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayoutImage;
-	descriptorSetAllocInfo.descriptorSetCount = 1;
-	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &emptyDescriptorSet));
-	std::vector<VkDescriptorImageInfo> imageDescriptors{};
-	std::vector<VkWriteDescriptorSet> writeDescriptorSets{};
-	if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor)
-	{
-		imageDescriptors.push_back(emptyTexture.descriptor);
-		VkWriteDescriptorSet writeDescriptorSet{};
-		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.dstSet = emptyDescriptorSet;
-		writeDescriptorSet.dstBinding = static_cast<uint32_t>(writeDescriptorSets.size());
-		writeDescriptorSet.pImageInfo = &emptyTexture.descriptor;
-		writeDescriptorSets.push_back(writeDescriptorSet);
-	}
-	if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap)
-	{
-		imageDescriptors.push_back(emptyTexture.descriptor);
-		VkWriteDescriptorSet writeDescriptorSet{};
-		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.dstSet = emptyDescriptorSet;
-		writeDescriptorSet.dstBinding = static_cast<uint32_t>(writeDescriptorSets.size());
-		writeDescriptorSet.pImageInfo = &emptyTexture.descriptor;
-		writeDescriptorSets.push_back(writeDescriptorSet);
-	}
-	if (descriptorBindingFlags & DescriptorBindingFlags::MetallicRoughnessMap)
-	{
-		imageDescriptors.push_back(emptyTexture.descriptor);
-		VkWriteDescriptorSet writeDescriptorSet{};
-		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.dstSet = emptyDescriptorSet;
-		writeDescriptorSet.dstBinding = static_cast<uint32_t>(writeDescriptorSets.size());
-		writeDescriptorSet.pImageInfo = &emptyTexture.descriptor;
-		writeDescriptorSets.push_back(writeDescriptorSet);
-	}
-	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
-
 }
 
 void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
@@ -1484,7 +2064,14 @@ void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
 	buffersBound = true;
 }
 
-void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer, VkBuffer vertexBuffer)
+{
+	const VkDeviceSize offsets[1] = {0};
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags)
 {
 	if (node->mesh) {
 		for (Primitive* primitive : node->mesh->primitives) {
@@ -1500,13 +2087,6 @@ void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t
 				skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
 			}
 			if (!skip) {
-				if (renderFlags & RenderFlags::BindImages && material.descriptorSet != nullptr) {
-					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
-				}
-				else
-				{
-					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &emptyDescriptorSet, 0, nullptr);
-				}
 				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
 			}
 		}
@@ -1516,7 +2096,7 @@ void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t
 	}
 }
 
-void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags)
 {
 	if (!buffersBound) {
 		const VkDeviceSize offsets[1] = {0};
@@ -1524,7 +2104,7 @@ void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, Vk
 		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 	}
 	for (auto& node : nodes) {
-		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
+		drawNode(node, commandBuffer, renderFlags);
 	}
 }
 
@@ -1616,6 +2196,15 @@ void vkglTF::Model::updateAnimation(uint32_t index, float time)
 	}
 }
 
+/*
+	Vertices are stored with bakedMatrix already applied, so the instance transform only has to
+	carry the difference between the current node pose and the pose at load time
+*/
+glm::mat4 vkglTF::Model::getNodeInstanceMatrix(Node* node)
+{
+	return axisMatrix * node->getMatrix() * glm::inverse(node->bakedMatrix);
+}
+
 /*
 	Helper functions
 */
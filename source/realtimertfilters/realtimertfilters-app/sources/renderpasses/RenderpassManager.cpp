@@ -4,6 +4,9 @@
 #include "../../headers/renderpasses/Renderpass_PostProcess.hpp"
 #include "../../headers/renderpasses/Renderpass_Gui.hpp"
 #include "../../headers/renderpasses/Renderpass_PathTracer.hpp"
+#include "../../headers/renderpasses/Renderpass_PathTracerRayQuery.hpp"
+#include "../../headers/renderpasses/Renderpass_Skinning.hpp"
+#include "../../headers/renderpasses/Renderpass_RestirDI.hpp"
 #include "../../headers/RTFilterDemo.hpp"
 
 namespace rtf
@@ -21,6 +24,7 @@ namespace rtf
 
 	void RenderpassManager::setQueueTemplate(SupportedQueueTemplates queueTemplate)
 	{
+		m_ActiveQueueTemplate = queueTemplate;
 		switch (queueTemplate)
 		{
 		case SupportedQueueTemplates::RasterizationOnly:
@@ -42,6 +46,19 @@ namespace rtf
 		}
 	}
 
+	void RenderpassManager::setReducedIndirect(bool reducedIndirect)
+	{
+		if (m_ReducedIndirect == reducedIndirect)
+		{
+			return;
+		}
+		m_ReducedIndirect = reducedIndirect;
+
+		// Templates are rebuilt, so the active one has to be picked again
+		buildQueueTemplates();
+		setQueueTemplate(m_ActiveQueueTemplate);
+	}
+
 #pragma region Prepare
 
 	void RenderpassManager::prepare(RTFilterDemo* rtFilterDemo, size_t semaphorecount)
@@ -50,6 +67,7 @@ namespace rtf
 		m_device = rtFilterDemo->device;
 		m_queue = rtFilterDemo->queue;
 		m_submitInfo = rtFilterDemo->submitInfo;
+		m_submitInfo.pWaitDstStageMask = &m_waitStageMask;
 		m_presentComplete = rtFilterDemo->semaphores.presentComplete;
 		m_renderComplete = rtFilterDemo->semaphores.renderComplete;
 
@@ -81,6 +99,10 @@ namespace rtf
 	{
 		// CREATE RENDERPASS OBJECTS AND PRECONFIGURE
 
+		// Skinning (has to be prepared before any pass consuming the scene vertex buffer)
+		m_RP_Skinning = std::make_shared<RenderpassSkinning>();
+		registerRenderpass(std::dynamic_pointer_cast<Renderpass, RenderpassSkinning>(m_RP_Skinning));
+
 		// GBuffer
 		m_RP_GBuffer = std::make_shared<RenderpassGbuffer>();
 		registerRenderpass(std::dynamic_pointer_cast<Renderpass, RenderpassGbuffer>(m_RP_GBuffer));
@@ -123,6 +145,16 @@ namespace rtf
 		m_RPF_TempAccu->Push_PastRenderpass_BufferCopy(Attachment::intermediate, Attachment::atrous_output);
 		registerRenderpass(m_RPF_TempAccu);
 
+		// Indirect Upsampling (reduced resolution indirect light of the path tracer)
+		m_RPF_IndirectUpsample = std::make_shared<RenderpassPostProcess>();
+		m_RPF_IndirectUpsample->ConfigureShader("svgf/svgf_indirect_upsample.frag.spv");
+		m_RPF_IndirectUpsample->PushTextureAttachment(TextureBinding(Attachment::position, TextureBinding::Type::Sampler_ReadOnly));
+		m_RPF_IndirectUpsample->PushTextureAttachment(TextureBinding(Attachment::normal, TextureBinding::Type::Sampler_ReadOnly));
+		m_RPF_IndirectUpsample->PushTextureAttachment(TextureBinding(Attachment::rtindirect_reduced, TextureBinding::Type::Sampler_ReadOnly));
+		m_RPF_IndirectUpsample->PushTextureAttachment(TextureBinding(Attachment::rtindirect, TextureBinding::Type::Subpass_Output));
+		m_RPF_IndirectUpsample->PushUBO(std::dynamic_pointer_cast<UBOInterface, ManagedUBO<S_ReducedIndirectConfig>>(rtFilterDemo->m_UBO_ReducedIndirectConfig));
+		registerRenderpass(m_RPF_IndirectUpsample);
+
 		// SVGF Accumulation
 		m_RPF_SVGF_Accumulation = std::make_shared<RenderpassPostProcess>();
 		m_RPF_SVGF_Accumulation->ConfigureShader("svgf/svgf_accumulation.frag.spv");
@@ -154,6 +186,15 @@ namespace rtf
 		m_RPF_SVGF_Accumulation->Push_PastRenderpass_BufferCopy(Attachment::new_moments, Attachment::moments_history);
 		registerRenderpass(m_RPF_SVGF_Accumulation);
 
+		// SVGF Sample Budget (adaptive sampling input of the next frame's path tracer)
+		m_RPF_SVGF_SampleBudget = std::make_shared<RenderpassPostProcess>();
+		m_RPF_SVGF_SampleBudget->ConfigureShader("svgf/svgf_samplebudget.frag.spv");
+		m_RPF_SVGF_SampleBudget->PushTextureAttachment(TextureBinding(Attachment::new_moments, TextureBinding::Type::Sampler_ReadOnly));
+		m_RPF_SVGF_SampleBudget->PushTextureAttachment(TextureBinding(Attachment::new_historylength, TextureBinding::Type::Sampler_ReadOnly));
+		m_RPF_SVGF_SampleBudget->PushTextureAttachment(TextureBinding(Attachment::sample_budget, TextureBinding::Type::Subpass_Output));
+		m_RPF_SVGF_SampleBudget->PushUBO(std::dynamic_pointer_cast<UBOInterface, ManagedUBO<S_AdaptiveSamplingConfig>>(rtFilterDemo->m_UBO_AdaptiveSamplingConfig));
+		registerRenderpass(m_RPF_SVGF_SampleBudget);
+
 		// SVGF Atrous
 		m_RPF_SVGF_Atrous = std::make_shared<RenderpassPostProcess>();
 		m_RPF_SVGF_Atrous->ConfigureShader("svgf/svgf_atrous.frag.spv");
@@ -183,6 +224,18 @@ namespace rtf
 		m_RPF_Atrous->PushUBO(std::dynamic_pointer_cast<UBOInterface, ManagedUBO<S_AtrousConfig>>(rtFilterDemo->m_UBO_AtrousConfig));
 		registerRenderpass(m_RPF_Atrous);
 
+		// Temporal Upscaling (dynamic resolution render size to output resolution)
+		m_RPF_TemporalUpscale = std::make_shared<RenderpassPostProcess>();
+		m_RPF_TemporalUpscale->ConfigureShader("filter/postprocess_temporalUpscale.frag.spv");
+		m_RPF_TemporalUpscale->m_OutputResolution = true;
+		m_RPF_TemporalUpscale->PushTextureAttachment(TextureBinding(Attachment::svgf_output, TextureBinding::Type::Sampler_ReadOnly));
+		m_RPF_TemporalUpscale->PushTextureAttachment(TextureBinding(Attachment::motionvector, TextureBinding::Type::Sampler_ReadOnly));
+		m_RPF_TemporalUpscale->PushTextureAttachment(TextureBinding(Attachment::upscale_history, TextureBinding::Type::Sampler_ReadOnly));
+		m_RPF_TemporalUpscale->PushTextureAttachment(TextureBinding(Attachment::upscaled_output, TextureBinding::Type::Subpass_Output));
+		m_RPF_TemporalUpscale->PushUBO(std::dynamic_pointer_cast<UBOInterface, ManagedUBO<S_DynamicResolutionConfig>>(rtFilterDemo->m_UBO_DynamicResolutionConfig));
+		m_RPF_TemporalUpscale->Push_PastRenderpass_BufferCopy(Attachment::upscaled_output, Attachment::upscale_history);
+		registerRenderpass(m_RPF_TemporalUpscale);
+
 		// GUI Pass (RasterizerOnly)
 		m_RPG_RasterOnly = std::make_shared<RenderpassGui>();
 		m_RPG_RasterOnly->m_allowComposition = true;
@@ -218,6 +271,7 @@ namespace rtf
 		m_RPG_SVGF->m_useTempAccu = false;
 		m_RPG_SVGF->m_useAtrous = true;
 		m_RPG_SVGF->setAttachmentBindings({
+			GuiAttachmentBinding(Attachment::upscaled_output, std::string("Output"), true),
 			GuiAttachmentBinding(Attachment::rtoutput, std::string("Raw RT")),
 			GuiAttachmentBinding(Attachment::atrous_integratedIndirectColor_A, std::string("Integrated Indirect Color")),
 			GuiAttachmentBinding(Attachment::atrous_integratedDirectColor_A, std::string("Integrated Direct Color")),
@@ -244,8 +298,22 @@ namespace rtf
 		registerRenderpass(std::dynamic_pointer_cast<Renderpass, RenderpassGui>(m_RPG_BMFR));
 
 		//// Path Tracer Pass
-		m_RP_PT = std::make_shared<RenderpassPathTracer>();
+		if (rtFilterDemo->m_useRayQueryPathTracer)
+		{
+			m_RP_PT = std::make_shared<RenderpassPathTracerRayQuery>();
+		}
+		else
+		{
+			m_RP_PT = std::make_shared<RenderpassPathTracer>();
+		}
 		registerRenderpass(std::dynamic_pointer_cast<Renderpass, RenderpassPathTracer>(m_RP_PT));
+
+		//// ReSTIR DI Pass (after the path tracer, whose acceleration structure and lights it uses)
+		if (rtFilterDemo->enabledRayQueryFeatures.rayQuery == VK_TRUE)
+		{
+			m_RP_RestirDI = std::make_shared<RenderpassRestirDI>();
+			registerRenderpass(std::dynamic_pointer_cast<Renderpass, RenderpassRestirDI>(m_RP_RestirDI));
+		}
 		
 		// SET RTFILTERDEMO AND PREPARE RENDERPASSES
 		for (auto& renderpass : m_AllRenderpasses)
@@ -262,14 +330,21 @@ namespace rtf
 
 	void RenderpassManager::buildQueueTemplates()
 	{
+		// Skinning only runs if the scene contains skinned meshes
+		QueueTemplate animationPasses{};
+		if (m_RP_Skinning->isActive())
+		{
+			animationPasses.push_back(m_RP_Skinning);
+		}
+
 		// RasterizationOnly
-		m_QT_RasterizationOnly = std::make_shared<QueueTemplate>();
+		m_QT_RasterizationOnly = std::make_shared<QueueTemplate>(animationPasses);
 		m_QT_RasterizationOnly->push_back(m_RP_GBuffer);
 		m_QT_RasterizationOnly->push_back(m_RPF_Gauss);
 		m_QT_RasterizationOnly->push_back(m_RPG_RasterOnly);
 
 		// PathtracerOnly
-		m_QT_PathtracerOnly = std::make_shared<QueueTemplate>();
+		m_QT_PathtracerOnly = std::make_shared<QueueTemplate>(animationPasses);
 		m_QT_PathtracerOnly->push_back(m_RP_GBuffer);
 
 		m_QT_PathtracerOnly->push_back(m_RP_PT);
@@ -277,15 +352,25 @@ namespace rtf
 		m_QT_PathtracerOnly->push_back(m_RPG_PathtracerOnly);
 
 		// SVGF
-		m_QT_SVGF = std::make_shared<QueueTemplate>();
+		m_QT_SVGF = std::make_shared<QueueTemplate>(animationPasses);
 		m_QT_SVGF->push_back(m_RP_GBuffer);
 		m_QT_SVGF->push_back(m_RP_PT);
+		if (m_RP_RestirDI)
+		{
+			m_QT_SVGF->push_back(m_RP_RestirDI);
+		}
+		if (m_ReducedIndirect)
+		{
+			m_QT_SVGF->push_back(m_RPF_IndirectUpsample);
+		}
 		m_QT_SVGF->push_back(m_RPF_SVGF_Accumulation);
+		m_QT_SVGF->push_back(m_RPF_SVGF_SampleBudget);
 		m_QT_SVGF->push_back(m_RPF_SVGF_Atrous);
+		m_QT_SVGF->push_back(m_RPF_TemporalUpscale);
 		m_QT_SVGF->push_back(m_RPG_SVGF);
 
 		// BMFR
-		m_QT_BMFR = std::make_shared<QueueTemplate>();
+		m_QT_BMFR = std::make_shared<QueueTemplate>(animationPasses);
 		m_QT_BMFR->push_back(m_RP_GBuffer);
 
 		m_QT_BMFR->push_back(m_RP_PT);
@@ -341,6 +426,14 @@ namespace rtf
 		}
 	}
 
+	void RenderpassManager::onAttachmentsChanged()
+	{
+		for (auto& renderpass : m_AllRenderpasses)
+		{
+			renderpass->onAttachmentsChanged();
+		}
+	}
+
 #pragma endregion
 }
 
@@ -61,6 +61,11 @@ namespace bmfr
 			vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &m_descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(getLogicalDevice(), &allocInfo, &m_descriptorSet));
 
+		WriteDescriptorSet();
+	}
+
+	void RenderpassBMFRCompute::WriteDescriptorSet()
+	{
 		VkDescriptorImageInfo rtin_imageInfo = vks::initializers::descriptorImageInfo(m_rtFilterDemo->m_DefaultColorSampler, m_RTInput->view, VkImageLayout::VK_IMAGE_LAYOUT_GENERAL);
 		VkDescriptorImageInfo pos_imageInfo = vks::initializers::descriptorImageInfo(m_rtFilterDemo->m_DefaultColorSampler, m_Positions->view, VkImageLayout::VK_IMAGE_LAYOUT_GENERAL);
 		VkDescriptorImageInfo normals_imageInfo = vks::initializers::descriptorImageInfo(m_rtFilterDemo->m_DefaultColorSampler, m_Normals->view, VkImageLayout::VK_IMAGE_LAYOUT_GENERAL);
@@ -141,6 +146,13 @@ namespace bmfr
 		out_commandBufferCount = 1;
 	}
 
+	void RenderpassBMFRCompute::onAttachmentsChanged()
+	{
+		m_Blocks = {(m_rtFilterDemo->width + BLOCK_SIZE_X - 1) / BLOCK_SIZE_X, (m_rtFilterDemo->height + BLOCK_SIZE_Y - 1) / BLOCK_SIZE_Y};
+		WriteDescriptorSet();
+		buildCommandBuffer();
+	}
+
 	void RenderpassBMFRCompute::cleanUp()
 	{
 		vkFreeCommandBuffers(m_vulkanDevice->logicalDevice, m_vulkanDevice->commandPool, 1, &m_cmdBuffer);
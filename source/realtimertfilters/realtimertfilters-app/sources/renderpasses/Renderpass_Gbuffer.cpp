@@ -1,6 +1,10 @@
 #include "../../headers/renderpasses/Renderpass_Gbuffer.hpp"
 #include "../../headers/RTFilterDemo.hpp"
+#include "../../headers/renderpasses/RenderpassManager.hpp"
+#include "../../headers/renderpasses/Renderpass_Skinning.hpp"
 #include <VulkanTools.cpp>
+#include <jobsystem.hpp>
+#include <frustum.hpp>
 
 namespace rtf
 {
@@ -17,8 +21,22 @@ namespace rtf
 		prepareRenderpass();
 		setupDescriptorSetLayout();
 		preparePipeline();
+		prepareDrawPrimitives();
 		setupDescriptorPool();
 		setupDescriptorSet();
+		if (m_VisibilityRenderpass != VK_NULL_HANDLE)
+		{
+			prepareVisibilityResolve();
+		}
+		prepareDrawChunks();
+		if (isGpuCullingSupported())
+		{
+			prepareGpuCulling();
+		}
+		else
+		{
+			m_GpuCulling = false;
+		}
 		buildCommandBuffer();
 	}
 
@@ -30,6 +48,7 @@ namespace rtf
 		m_MotionAttachment = m_attachmentManager->getAttachment(Attachment::motionvector);
 		m_MeshIdAttachment = m_attachmentManager->getAttachment(Attachment::meshid);
 		m_DepthAttachment = m_attachmentManager->getAttachment(Attachment::depth);
+		m_VisibilityAttachment = m_attachmentManager->getAttachment(Attachment::visibility);
 		assert(m_PositionAttachment != nullptr);
 		assert(m_NormalAttachment != nullptr);
 		assert(m_AlbedoAttachment != nullptr);
@@ -109,7 +128,21 @@ namespace rtf
 
 		VK_CHECK_RESULT(vkCreateRenderPass(m_vulkanDevice->logicalDevice, &renderPassInfo, nullptr, &m_renderpass));
 
-		VkImageView attachmentViews[ATTACHMENT_COUNT] = {
+		if (isVisibilityBufferSupported())
+		{
+			prepareVisibilityRenderpass();
+		}
+		else
+		{
+			m_VisibilityBuffer = false;
+		}
+
+		prepareFramebuffer();
+	}
+
+	void RenderpassGbuffer::prepareFramebuffer()
+	{
+		VkImageView attachmentViews[] = {
 			m_PositionAttachment->view, m_NormalAttachment->view, m_AlbedoAttachment->view, m_MotionAttachment->view, m_MeshIdAttachment->view, m_DepthAttachment->view
 		};
 
@@ -120,27 +153,137 @@ namespace rtf
 		fbufCreateInfo.pNext = NULL;
 		fbufCreateInfo.renderPass = m_renderpass;
 		fbufCreateInfo.pAttachments = attachmentViews;
-		fbufCreateInfo.attachmentCount = static_cast<uint32_t>(ATTACHMENT_COUNT);
+		fbufCreateInfo.attachmentCount = static_cast<uint32_t>(std::size(attachmentViews));
 		fbufCreateInfo.width = size.width;
 		fbufCreateInfo.height = size.height;
 		fbufCreateInfo.layers = 1;
 		VK_CHECK_RESULT(vkCreateFramebuffer(m_vulkanDevice->logicalDevice, &fbufCreateInfo, nullptr, &m_FrameBuffer));
+
+		if (m_VisibilityRenderpass != VK_NULL_HANDLE)
+		{
+			VkImageView visibilityViews[] = { m_VisibilityAttachment->view, m_DepthAttachment->view };
+			fbufCreateInfo.renderPass = m_VisibilityRenderpass;
+			fbufCreateInfo.pAttachments = visibilityViews;
+			fbufCreateInfo.attachmentCount = static_cast<uint32_t>(std::size(visibilityViews));
+			VK_CHECK_RESULT(vkCreateFramebuffer(m_vulkanDevice->logicalDevice, &fbufCreateInfo, nullptr, &m_VisibilityFrameBuffer));
+		}
 	}
 
 	void RenderpassGbuffer::draw(const VkCommandBuffer*& out_commandBuffers, uint32_t& out_commandBufferCount)
 	{
+		// Dynamic resolution changed the render size
+		VkExtent2D renderSize = m_attachmentManager->GetRenderSize();
+		if (renderSize.width != m_RecordedSize.width || renderSize.height != m_RecordedSize.height || m_GpuCulling != m_RecordedGpuCulling || m_VisibilityBuffer != m_RecordedVisibilityBuffer)
+		{
+			buildCommandBuffer();
+		}
 		out_commandBufferCount = 1;
 		out_commandBuffers = &m_CmdBuffer;
+		// This submission builds the pyramid the next frame culls against
+		m_HiZValid = m_RecordedGpuCulling;
+	}
+
+	void RenderpassGbuffer::updateUniformBuffer()
+	{
+		updateNodeInstances();
+		if (!m_UBO_CullConfig)
+		{
+			return;
+		}
+		const S_Sceneinfo& sceneInfo = m_rtFilterDemo->m_UBO_SceneInfo->UBO();
+		S_CullConfig& config = m_UBO_CullConfig->UBO();
+
+		vks::Frustum frustum;
+		frustum.update(sceneInfo.ProjMat * sceneInfo.ViewMat);
+		for (size_t i = 0; i < frustum.planes.size(); i++)
+		{
+			config.FrustumPlanes[i] = frustum.planes[i];
+		}
+		// The pyramid holds the depth of the previous frame, so bounds are projected with its camera
+		config.ViewProjPrev = sceneInfo.ProjMatPrev * sceneInfo.ViewMatPrev;
+		config.EnableOcclusion = (m_OcclusionCulling && m_HiZValid) ? 1 : 0;
+		config.HiZLevelCount = m_HiZ.levelCount;
+		config.RenderWidth = m_RecordedSize.width;
+		config.RenderHeight = m_RecordedSize.height;
+		m_UBO_CullConfig->update();
+	}
+
+	void RenderpassGbuffer::onAttachmentsChanged()
+	{
+		// The render pass only depends on the attachment formats, which stay the same
+		vkDestroyFramebuffer(m_vulkanDevice->logicalDevice, m_FrameBuffer, nullptr);
+		vkDestroyFramebuffer(m_vulkanDevice->logicalDevice, m_VisibilityFrameBuffer, nullptr);
+		m_VisibilityFrameBuffer = VK_NULL_HANDLE;
+		prepareFramebuffer();
+		// The resolve writes the new attachments once the descriptor set is rewritten
+		m_ResolveVertexBuffer = VK_NULL_HANDLE;
+		if (m_HiZ.image != VK_NULL_HANDLE)
+		{
+			// The pyramid follows the attachment size
+			destroyHiZ();
+			prepareHiZ();
+		}
+		buildCommandBuffer();
 	}
 
 	void RenderpassGbuffer::cleanUp()
 	{
 		vkDestroyDescriptorPool(m_vulkanDevice->logicalDevice, m_descriptorPool, nullptr);
 		vkFreeCommandBuffers(m_vulkanDevice->logicalDevice, m_vulkanDevice->commandPool, 1, &m_CmdBuffer);
+		m_CmdBuffer = nullptr;
+		for (DrawChunk& chunk : m_DrawChunks)
+		{
+			// Frees the secondary command buffer along with the pool
+			vkDestroyCommandPool(m_vulkanDevice->logicalDevice, chunk.commandPool, nullptr);
+		}
+		m_DrawChunks.clear();
+		m_SecondaryCmdBuffers.clear();
+		destroyHiZ();
+		vkDestroySampler(m_vulkanDevice->logicalDevice, m_HiZSampler, nullptr);
+		vkDestroyPipeline(m_vulkanDevice->logicalDevice, m_HiZPipeline, nullptr);
+		vkDestroyPipelineLayout(m_vulkanDevice->logicalDevice, m_HiZPipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(m_vulkanDevice->logicalDevice, m_HiZDescriptorSetLayout, nullptr);
+		vkDestroyPipeline(m_vulkanDevice->logicalDevice, m_CullPipeline, nullptr);
+		vkDestroyPipelineLayout(m_vulkanDevice->logicalDevice, m_CullPipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(m_vulkanDevice->logicalDevice, m_CullDescriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(m_vulkanDevice->logicalDevice, m_CullDescriptorPool, nullptr);
+		m_HiZSampler = VK_NULL_HANDLE;
+		m_HiZPipeline = VK_NULL_HANDLE;
+		m_HiZPipelineLayout = VK_NULL_HANDLE;
+		m_HiZDescriptorSetLayout = VK_NULL_HANDLE;
+		m_CullPipeline = VK_NULL_HANDLE;
+		m_CullPipelineLayout = VK_NULL_HANDLE;
+		m_CullDescriptorSetLayout = VK_NULL_HANDLE;
+		m_CullDescriptorPool = VK_NULL_HANDLE;
+		m_CullPrimitives.destroy();
+		m_NodeInstances.destroy();
+		m_DrawCommands.destroy();
+		m_DrawCount.destroy();
+		m_CullPrimitives = {};
+		m_NodeInstances = {};
+		m_DrawCommands = {};
+		m_DrawCount = {};
+		m_UBO_CullConfig.reset();
+		vkDestroyPipeline(m_vulkanDevice->logicalDevice, m_ResolvePipeline, nullptr);
+		vkDestroyPipelineLayout(m_vulkanDevice->logicalDevice, m_ResolvePipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(m_vulkanDevice->logicalDevice, m_ResolveDescriptorSetLayout, nullptr);
+		vkDestroyPipeline(m_vulkanDevice->logicalDevice, m_VisibilityPipeline, nullptr);
+		vkDestroyFramebuffer(m_vulkanDevice->logicalDevice, m_VisibilityFrameBuffer, nullptr);
+		vkDestroyRenderPass(m_vulkanDevice->logicalDevice, m_VisibilityRenderpass, nullptr);
+		m_ResolvePipeline = VK_NULL_HANDLE;
+		m_ResolvePipelineLayout = VK_NULL_HANDLE;
+		m_ResolveDescriptorSetLayout = VK_NULL_HANDLE;
+		m_ResolveDescriptorSet = VK_NULL_HANDLE;
+		m_ResolveVertexBuffer = VK_NULL_HANDLE;
+		m_VisibilityPipeline = VK_NULL_HANDLE;
+		m_VisibilityFrameBuffer = VK_NULL_HANDLE;
+		m_VisibilityRenderpass = VK_NULL_HANDLE;
 		vkDestroyFramebuffer(m_vulkanDevice->logicalDevice, m_FrameBuffer, nullptr);
 		vkDestroyPipeline(m_vulkanDevice->logicalDevice, m_pipeline, nullptr);
 		vkDestroyPipelineLayout(m_vulkanDevice->logicalDevice, m_pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(m_vulkanDevice->logicalDevice, m_descriptorSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(m_vulkanDevice->logicalDevice, m_MaterialDescriptorSetLayout, nullptr);
+		m_MaterialDescriptorSetLayout = VK_NULL_HANDLE;
 		vkDestroyRenderPass(m_vulkanDevice->logicalDevice, m_renderpass, nullptr);
 		vkDestroyPipelineCache(m_vulkanDevice->logicalDevice, m_PipelineCache, nullptr);
 	}
@@ -150,17 +293,43 @@ namespace rtf
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 8),
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9)
+		// Material textures for the rasterization and the visibility resolve
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9 + 2 * static_cast<uint32_t>(m_Scene->textures.size())),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 6)
 		};
 
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 4);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(m_vulkanDevice->logicalDevice, &descriptorPoolInfo, nullptr, &m_descriptorPool));
 	}
 
 	void RenderpassGbuffer::setupDescriptorSetLayout()
 	{
-		std::vector<VkDescriptorSetLayout> gltfDescriptorSetLayouts = { vkglTF::descriptorSetLayoutUbo, vkglTF::descriptorSetLayoutImage };
-		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfoOffscreen = vks::initializers::pipelineLayoutCreateInfo(gltfDescriptorSetLayouts.data(), 2);
+		// Bindless materials, the same material buffer and texture array the path tracer uses
+		std::vector<VkDescriptorSetLayoutBinding> materialBindings = {
+			// Binding 0: Material buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			// Binding 1: All scene textures
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1, static_cast<uint32_t>(m_Scene->textures.size())),
+		};
+		VkDescriptorSetLayoutCreateInfo materialLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(materialBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_vulkanDevice->logicalDevice, &materialLayoutInfo, nullptr, &m_MaterialDescriptorSetLayout));
+
+		std::vector<VkDescriptorSetLayoutBinding> sceneBindings = {
+			// Binding 0: Scene info
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+			// Binding 1: Draw primitives
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 1),
+			// Binding 2: Node instances
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 2),
+			// Binding 3: Previous frame's vertices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 3),
+		};
+		VkDescriptorSetLayoutCreateInfo sceneLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(sceneBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_vulkanDevice->logicalDevice, &sceneLayoutInfo, nullptr, &m_descriptorSetLayout));
+
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts = { m_descriptorSetLayout, m_MaterialDescriptorSetLayout };
+		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfoOffscreen = vks::initializers::pipelineLayoutCreateInfo(descriptorSetLayouts.data(), 2);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(m_vulkanDevice->logicalDevice, &pPipelineLayoutCreateInfoOffscreen, nullptr, &m_pipelineLayout));
 	}
 
@@ -168,17 +337,201 @@ namespace rtf
 	{
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
 
-		// Model
-		// use descriptor set layout delivered by gltf
-		VkDescriptorSetAllocateInfo allocInfoOffscreen = vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &vkglTF::descriptorSetLayoutUbo, 1);
+		// Scene
+		VkDescriptorSetAllocateInfo allocInfoOffscreen = vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &m_descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(m_vulkanDevice->logicalDevice, &allocInfoOffscreen, &m_DescriptorSetScene));
+		VkDescriptorBufferInfo primitivesDescriptor{ m_CullPrimitives.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo instancesDescriptor{ m_NodeInstances.buffer, 0, VK_WHOLE_SIZE };
+		// Created once by the skinning pass, only the current pose buffer is bound per recording
+		VkDescriptorBufferInfo previousVerticesDescriptor{ m_rtFilterDemo->m_renderpassManager->m_RP_Skinning->getPreviousVertexBuffer(), 0, VK_WHOLE_SIZE };
 		writeDescriptorSets = {
 			// Binding 0: Vertex shader uniform buffer
-			m_rtFilterDemo->m_UBO_SceneInfo->writeDescriptorSet(m_DescriptorSetScene, 0)
+			m_rtFilterDemo->m_UBO_SceneInfo->writeDescriptorSet(m_DescriptorSetScene, 0),
+			// Binding 1: Draw primitives
+			vks::initializers::writeDescriptorSet(m_DescriptorSetScene, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &primitivesDescriptor),
+			// Binding 2: Node instances
+			vks::initializers::writeDescriptorSet(m_DescriptorSetScene, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &instancesDescriptor),
+			// Binding 3: Previous frame's vertices
+			vks::initializers::writeDescriptorSet(m_DescriptorSetScene, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &previousVerticesDescriptor)
+		};
+		vkUpdateDescriptorSets(m_vulkanDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		// Materials
+		VkDescriptorSetAllocateInfo allocInfoMaterials = vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &m_MaterialDescriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(m_vulkanDevice->logicalDevice, &allocInfoMaterials, &m_DescriptorSetMaterials));
+		VkDescriptorBufferInfo materialBufferDescriptor{ m_Scene->shadeMaterials.buffer, 0, VK_WHOLE_SIZE };
+		std::vector<VkDescriptorImageInfo> textureDescriptors;
+		for (const vkglTF::Texture& texture : m_Scene->textures)
+		{
+			textureDescriptors.push_back(texture.descriptor);
+		}
+		writeDescriptorSets = {
+			// Binding 0: Material buffer
+			vks::initializers::writeDescriptorSet(m_DescriptorSetMaterials, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &materialBufferDescriptor)
 		};
+		// Scenes without textures have an empty texture array
+		if (!textureDescriptors.empty())
+		{
+			// Binding 1: Scene textures
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(m_DescriptorSetMaterials, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, textureDescriptors.data(), static_cast<uint32_t>(textureDescriptors.size())));
+		}
 		vkUpdateDescriptorSets(m_vulkanDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 	}
 
+	void RenderpassGbuffer::prepareDrawPrimitives()
+	{
+		m_DrawNodes.clear();
+		m_DrawPrimitives.clear();
+		for (vkglTF::Node* node : m_Scene->linearNodes)
+		{
+			if (node->mesh == nullptr)
+			{
+				continue;
+			}
+			const uint32_t nodeIndex = static_cast<uint32_t>(m_DrawNodes.size());
+			m_DrawNodes.push_back(node);
+			for (vkglTF::Primitive* primitive : node->mesh->primitives)
+			{
+				// Bounds are in glTF mesh space, vertices were baked with the node's bakedMatrix
+				const vkglTF::Primitive::Dimensions& dimensions = primitive->dimensions;
+				glm::vec3 boundsMin(FLT_MAX);
+				glm::vec3 boundsMax(-FLT_MAX);
+				for (uint32_t corner = 0; corner < 8; corner++)
+				{
+					const glm::vec3 position((corner & 1) ? dimensions.max.x : dimensions.min.x, (corner & 2) ? dimensions.max.y : dimensions.min.y, (corner & 4) ? dimensions.max.z : dimensions.min.z);
+					const glm::vec3 baked = glm::vec3(node->bakedMatrix * glm::vec4(position, 1.0f));
+					boundsMin = glm::min(boundsMin, baked);
+					boundsMax = glm::max(boundsMax, baked);
+				}
+
+				S_CullPrimitive cullPrimitive{};
+				cullPrimitive.Min = boundsMin;
+				cullPrimitive.Max = boundsMax;
+				cullPrimitive.FirstIndex = primitive->firstIndex;
+				cullPrimitive.IndexCount = primitive->indexCount;
+				// Skinned vertices leave the bounds of the rest pose
+				cullPrimitive.Flags = (node->skin != nullptr) ? CULL_FLAG_ALWAYS_VISIBLE : 0;
+				cullPrimitive.NodeIndex = nodeIndex;
+				m_DrawPrimitives.push_back(cullPrimitive);
+			}
+		}
+		// The visibility resolve finds the primitive of a triangle with a binary search
+		std::sort(m_DrawPrimitives.begin(), m_DrawPrimitives.end(), [](const S_CullPrimitive& a, const S_CullPrimitive& b) { return a.FirstIndex < b.FirstIndex; });
+		m_CullPrimitiveCount = static_cast<uint32_t>(m_DrawPrimitives.size());
+
+		// Bounds are static, so they are uploaded once to device local memory
+		const VkDeviceSize primitivesSize = std::max<VkDeviceSize>(1, m_DrawPrimitives.size()) * sizeof(S_CullPrimitive);
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(m_vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			primitivesSize,
+			m_DrawPrimitives.empty() ? nullptr : m_DrawPrimitives.data()));
+		VK_CHECK_RESULT(m_vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&m_CullPrimitives,
+			primitivesSize));
+		VkCommandBuffer copyCmd = m_vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkBufferCopy copyRegion{};
+		copyRegion.size = primitivesSize;
+		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, m_CullPrimitives.buffer, 1, &copyRegion);
+		m_vulkanDevice->flushCommandBuffer(copyCmd, m_rtFilterDemo->queue);
+		stagingBuffer.destroy();
+
+		// Node transforms change with the animation, so they stay host visible
+		VK_CHECK_RESULT(m_vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&m_NodeInstances,
+			std::max<VkDeviceSize>(1, m_DrawNodes.size()) * sizeof(S_NodeInstance)));
+		VK_CHECK_RESULT(m_NodeInstances.map());
+		m_NodeInstanceData.assign(m_DrawNodes.size(), S_NodeInstance{});
+		// Twice, so the first frame has the same previous pose and no motion
+		updateNodeInstances();
+		updateNodeInstances();
+	}
+
+	void RenderpassGbuffer::updateNodeInstances()
+	{
+		for (size_t i = 0; i < m_DrawNodes.size(); i++)
+		{
+			S_NodeInstance& instance = m_NodeInstanceData[i];
+			instance.ModelPrev = instance.Model;
+			// Skinned vertices are already transformed by the skinning pass
+			instance.Model = (m_DrawNodes[i]->skin != nullptr) ? glm::mat4(1.0f) : m_Scene->getNodeInstanceMatrix(m_DrawNodes[i]);
+		}
+		if (!m_NodeInstanceData.empty())
+		{
+			memcpy(m_NodeInstances.mapped, m_NodeInstanceData.data(), m_NodeInstanceData.size() * sizeof(S_NodeInstance));
+		}
+	}
+
+	void RenderpassGbuffer::prepareDrawChunks()
+	{
+		// One chunk per thread that can record, unless that would make the chunks too small to pay off
+		const uint32_t primitiveCount = static_cast<uint32_t>(m_DrawPrimitives.size());
+		const uint32_t threadCount = vks::JobSystem::shared().getWorkerCount() + 1;
+		const uint32_t chunkCount = std::max(1u, std::min(threadCount, (primitiveCount + MIN_PRIMITIVES_PER_CHUNK - 1) / MIN_PRIMITIVES_PER_CHUNK));
+
+		m_DrawChunks.resize(chunkCount);
+		m_SecondaryCmdBuffers.resize(chunkCount);
+		for (uint32_t i = 0; i < chunkCount; i++)
+		{
+			DrawChunk& chunk = m_DrawChunks[i];
+			chunk.firstPrimitive = primitiveCount * i / chunkCount;
+			chunk.primitiveCount = primitiveCount * (i + 1) / chunkCount - chunk.firstPrimitive;
+			chunk.commandPool = m_vulkanDevice->createCommandPool(m_vulkanDevice->queueFamilyIndices.graphics, 0);
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(chunk.commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(m_vulkanDevice->logicalDevice, &cmdBufAllocateInfo, &chunk.cmdBuffer));
+			m_SecondaryCmdBuffers[i] = chunk.cmdBuffer;
+		}
+	}
+
+	// Called from job system workers, only touches the chunk's own pool
+	void RenderpassGbuffer::recordDrawChunk(DrawChunk& chunk, VkExtent2D size, VkBuffer vertexBuffer)
+	{
+		VK_CHECK_RESULT(vkResetCommandPool(m_vulkanDevice->logicalDevice, chunk.commandPool, 0));
+
+		VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
+		inheritanceInfo.renderPass = m_RecordedVisibilityBuffer ? m_VisibilityRenderpass : m_renderpass;
+		inheritanceInfo.subpass = 0;
+		// No framebuffer, so the chunks stay valid when the attachments are recreated at the same render size
+		inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		cmdBufInfo.pInheritanceInfo = &inheritanceInfo;
+
+		VkCommandBuffer cmdBuffer = chunk.cmdBuffer;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+
+		// Dynamic state is not inherited from the primary command buffer
+		VkViewport viewport = vks::initializers::viewport((float)size.width, (float)size.height, 0.0f, 1.0f);
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = vks::initializers::rect2D(size.width, size.height, 0, 0);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_RecordedVisibilityBuffer ? m_VisibilityPipeline : m_pipeline);
+		const std::array<VkDescriptorSet, 2> descriptorSets = { m_DescriptorSetScene, m_DescriptorSetMaterials };
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
+		m_Scene->bindBuffers(cmdBuffer, vertexBuffer);
+		// Materials are looked up per vertex, so the draws need no state changes in between
+		for (uint32_t i = chunk.firstPrimitive; i < chunk.firstPrimitive + chunk.primitiveCount; i++)
+		{
+			// The first instance carries the primitive of the draw to the G-buffer shaders
+			vkCmdDrawIndexed(cmdBuffer, m_DrawPrimitives[i].IndexCount, 1, m_DrawPrimitives[i].FirstIndex, 0, i);
+		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+
+		chunk.recordedSize = size;
+		chunk.recordedVertexBuffer = vertexBuffer;
+		chunk.recordedVisibilityBuffer = m_RecordedVisibilityBuffer;
+	}
+
 	void RenderpassGbuffer::buildCommandBuffer()
 	{
 		if (m_CmdBuffer == nullptr)
@@ -186,6 +539,46 @@ namespace rtf
 			m_CmdBuffer = m_vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
 		}
 
+		VkExtent2D size = m_attachmentManager->GetRenderSize();
+		m_RecordedSize = size;
+		// Rasterize the current pose, which is the scene vertex buffer unless the scene is skinned
+		VkBuffer vertexBuffer = m_rtFilterDemo->m_renderpassManager->m_RP_Skinning->getVertexBuffer();
+
+		m_RecordedGpuCulling = m_GpuCulling;
+		m_RecordedVisibilityBuffer = m_VisibilityBuffer;
+		if (m_VisibilityBuffer && m_ResolveVertexBuffer != vertexBuffer)
+		{
+			updateResolveDescriptorSet(vertexBuffer);
+		}
+		// The pyramid has to be rebuilt at the new size before it can be culled against
+		m_HiZValid = false;
+		if (m_UBO_CullConfig)
+		{
+			m_UBO_CullConfig->UBO().EnableOcclusion = 0;
+			m_UBO_CullConfig->update();
+		}
+
+		if (!m_GpuCulling)
+		{
+			// CPU driven fallback: record the chunks whose state changed in parallel, the others are executed as they are
+			std::vector<DrawChunk*> outdatedChunks;
+			for (DrawChunk& chunk : m_DrawChunks)
+			{
+				if (chunk.recordedSize.width != size.width || chunk.recordedSize.height != size.height || chunk.recordedVertexBuffer != vertexBuffer
+					|| chunk.recordedVisibilityBuffer != m_VisibilityBuffer)
+				{
+					outdatedChunks.push_back(&chunk);
+				}
+			}
+			vks::JobSystem::shared().parallelFor(static_cast<uint32_t>(outdatedChunks.size()), 1, [&](uint32_t begin, uint32_t end)
+				{
+					for (uint32_t i = begin; i < end; i++)
+					{
+						recordDrawChunk(*outdatedChunks[i], size, vertexBuffer);
+					}
+				});
+		}
+
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		// Clear values for all attachments written in the fragment shader
@@ -197,8 +590,6 @@ namespace rtf
 		clearValues[4].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
 		clearValues[5].depthStencil = { 1.0f, 0 };
 
-		VkExtent2D size = m_attachmentManager->GetSize();
-
 		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
 		renderPassBeginInfo.renderPass = m_renderpass;
 		renderPassBeginInfo.framebuffer = m_FrameBuffer;
@@ -206,25 +597,337 @@ namespace rtf
 		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassBeginInfo.pClearValues = clearValues.data();
 
+		// The visibility buffer pass only writes triangle ids and depth, 0 marks the background
+		std::array<VkClearValue, 2> visibilityClearValues;
+		visibilityClearValues[0].color.uint32[0] = 0;
+		visibilityClearValues[0].color.uint32[1] = 0;
+		visibilityClearValues[0].color.uint32[2] = 0;
+		visibilityClearValues[0].color.uint32[3] = 0;
+		visibilityClearValues[1].depthStencil = { 1.0f, 0 };
+		if (m_VisibilityBuffer)
+		{
+			renderPassBeginInfo.renderPass = m_VisibilityRenderpass;
+			renderPassBeginInfo.framebuffer = m_VisibilityFrameBuffer;
+			renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(visibilityClearValues.size());
+			renderPassBeginInfo.pClearValues = visibilityClearValues.data();
+		}
+
 		VK_CHECK_RESULT(vkBeginCommandBuffer(m_CmdBuffer, &cmdBufInfo));
 
-		vkCmdBeginRenderPass(m_CmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		if (m_GpuCulling)
+		{
+			recordCulling(m_CmdBuffer);
+			vkCmdBeginRenderPass(m_CmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			recordIndirectDraws(m_CmdBuffer, size, vertexBuffer);
+			vkCmdEndRenderPass(m_CmdBuffer);
+		}
+		else
+		{
+			vkCmdBeginRenderPass(m_CmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			vkCmdExecuteCommands(m_CmdBuffer, static_cast<uint32_t>(m_SecondaryCmdBuffers.size()), m_SecondaryCmdBuffers.data());
+			vkCmdEndRenderPass(m_CmdBuffer);
+		}
+
+		if (m_VisibilityBuffer)
+		{
+			recordVisibilityResolve(m_CmdBuffer, size);
+		}
+		if (m_GpuCulling)
+		{
+			recordHiZBuild(m_CmdBuffer, size);
+		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(m_CmdBuffer));
+	}
+
+	bool RenderpassGbuffer::isGpuCullingSupported() const
+	{
+		return m_rtFilterDemo->enabledPhysicalDeviceVulkan12Features.drawIndirectCount == VK_TRUE && m_rtFilterDemo->enabledFeatures.multiDrawIndirect == VK_TRUE
+			&& m_rtFilterDemo->enabledFeatures.drawIndirectFirstInstance == VK_TRUE;
+	}
+
+	bool RenderpassGbuffer::isVisibilityBufferSupported() const
+	{
+		// gl_PrimitiveID is only readable in fragment shaders with the geometry shader feature
+		return m_rtFilterDemo->enabledFeatures.geometryShader == VK_TRUE;
+	}
+
+	void RenderpassGbuffer::prepareGpuCulling()
+	{
+		VK_CHECK_RESULT(m_vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&m_DrawCommands,
+			std::max<VkDeviceSize>(1, m_DrawPrimitives.size()) * sizeof(VkDrawIndexedIndirectCommand)));
+		VK_CHECK_RESULT(m_vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&m_DrawCount,
+			sizeof(uint32_t)));
+
+		m_UBO_CullConfig = std::make_shared<ManagedUBO<S_CullConfig>>(m_vulkanDevice);
+		m_UBO_CullConfig->prepare();
+		m_UBO_CullConfig->UBO().PrimitiveCount = m_CullPrimitiveCount;
+
+		prepareCullPipelines();
+		prepareHiZ();
+	}
+
+	void RenderpassGbuffer::prepareCullPipelines()
+	{
+		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.maxLod = static_cast<float>(MAX_HIZ_LEVELS);
+		VK_CHECK_RESULT(vkCreateSampler(getLogicalDevice(), &samplerInfo, nullptr, &m_HiZSampler));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 + MAX_HIZ_LEVELS),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_HIZ_LEVELS)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1 + MAX_HIZ_LEVELS);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(getLogicalDevice(), &descriptorPoolInfo, nullptr, &m_CullDescriptorPool));
+
+		// Culling
+		std::vector<VkDescriptorSetLayoutBinding> cullBindings = {
+			// Binding 0: Cull config
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Primitive bounds
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Indirect draw commands
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3: Draw count
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			// Binding 4: Hi-Z pyramid
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			// Binding 5: Node instances
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+		};
+		VkDescriptorSetLayoutCreateInfo cullLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(cullBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(getLogicalDevice(), &cullLayoutInfo, nullptr, &m_CullDescriptorSetLayout));
+
+		VkDescriptorSetAllocateInfo cullAllocInfo = vks::initializers::descriptorSetAllocateInfo(m_CullDescriptorPool, &m_CullDescriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(getLogicalDevice(), &cullAllocInfo, &m_CullDescriptorSet));
+
+		VkDescriptorBufferInfo primitivesDescriptor{ m_CullPrimitives.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo drawCommandsDescriptor{ m_DrawCommands.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo drawCountDescriptor{ m_DrawCount.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo instancesDescriptor{ m_NodeInstances.buffer, 0, VK_WHOLE_SIZE };
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			m_UBO_CullConfig->writeDescriptorSet(m_CullDescriptorSet, 0),
+			vks::initializers::writeDescriptorSet(m_CullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &primitivesDescriptor),
+			vks::initializers::writeDescriptorSet(m_CullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &drawCommandsDescriptor),
+			vks::initializers::writeDescriptorSet(m_CullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &drawCountDescriptor),
+			vks::initializers::writeDescriptorSet(m_CullDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &instancesDescriptor),
+		};
+		vkUpdateDescriptorSets(getLogicalDevice(), static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 
+		VkPipelineLayoutCreateInfo cullPipelineLayoutInfo = vks::initializers::pipelineLayoutCreateInfo(&m_CullDescriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(getLogicalDevice(), &cullPipelineLayoutInfo, nullptr, &m_CullPipelineLayout));
+		VkComputePipelineCreateInfo cullPipelineInfo = vks::initializers::computePipelineCreateInfo(m_CullPipelineLayout, 0);
+		cullPipelineInfo.stage = m_rtFilterDemo->LoadShader("prepass/gbuffer_cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(getLogicalDevice(), m_PipelineCache, 1, &cullPipelineInfo, nullptr, &m_CullPipeline));
+
+		// Hi-Z downsampling, one set per pyramid level
+		std::vector<VkDescriptorSetLayoutBinding> hiZBindings = {
+			// Binding 0: Depth attachment or the finer pyramid level
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Written pyramid level
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo hiZLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(hiZBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(getLogicalDevice(), &hiZLayoutInfo, nullptr, &m_HiZDescriptorSetLayout));
+
+		// Allocated for the deepest pyramid once, prepareHiZ only rewrites them
+		std::vector<VkDescriptorSetLayout> hiZSetLayouts(MAX_HIZ_LEVELS, m_HiZDescriptorSetLayout);
+		m_HiZ.descriptorSets.resize(MAX_HIZ_LEVELS);
+		VkDescriptorSetAllocateInfo hiZAllocInfo = vks::initializers::descriptorSetAllocateInfo(m_CullDescriptorPool, hiZSetLayouts.data(), MAX_HIZ_LEVELS);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(getLogicalDevice(), &hiZAllocInfo, m_HiZ.descriptorSets.data()));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(SPC_HiZConfig), 0);
+		VkPipelineLayoutCreateInfo hiZPipelineLayoutInfo = vks::initializers::pipelineLayoutCreateInfo(&m_HiZDescriptorSetLayout, 1);
+		hiZPipelineLayoutInfo.pushConstantRangeCount = 1;
+		hiZPipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(getLogicalDevice(), &hiZPipelineLayoutInfo, nullptr, &m_HiZPipelineLayout));
+		VkComputePipelineCreateInfo hiZPipelineInfo = vks::initializers::computePipelineCreateInfo(m_HiZPipelineLayout, 0);
+		hiZPipelineInfo.stage = m_rtFilterDemo->LoadShader("prepass/hiz_downsample.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(getLogicalDevice(), m_PipelineCache, 1, &hiZPipelineInfo, nullptr, &m_HiZPipeline));
+	}
+
+	void RenderpassGbuffer::prepareHiZ()
+	{
+		// Level sizes are halved and rounded down, starting at half the attachment size
+		const VkExtent2D attachmentSize = m_attachmentManager->GetSize();
+		VkExtent2D baseSize = { std::max(1u, attachmentSize.width / 2), std::max(1u, attachmentSize.height / 2) };
+		m_HiZ.levelCount = 1;
+		for (uint32_t size = std::max(baseSize.width, baseSize.height); size > 1 && m_HiZ.levelCount < MAX_HIZ_LEVELS; size /= 2)
+		{
+			m_HiZ.levelCount++;
+		}
+
+		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageInfo.extent = { baseSize.width, baseSize.height, 1 };
+		imageInfo.mipLevels = m_HiZ.levelCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(getLogicalDevice(), &imageInfo, nullptr, &m_HiZ.image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(getLogicalDevice(), m_HiZ.image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = m_vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(getLogicalDevice(), &memAlloc, nullptr, &m_HiZ.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(getLogicalDevice(), m_HiZ.image, m_HiZ.memory, 0));
+
+		VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_HiZ.levelCount, 0, 1 };
+		viewInfo.image = m_HiZ.image;
+		VK_CHECK_RESULT(vkCreateImageView(getLogicalDevice(), &viewInfo, nullptr, &m_HiZ.view));
+		m_HiZ.levelViews.resize(m_HiZ.levelCount);
+		for (uint32_t level = 0; level < m_HiZ.levelCount; level++)
+		{
+			viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+			VK_CHECK_RESULT(vkCreateImageView(getLogicalDevice(), &viewInfo, nullptr, &m_HiZ.levelViews[level]));
+		}
+
+		// Stays in general layout, levels are written as storage images and read with texelFetch
+		VkCommandBuffer layoutCmd = m_vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(layoutCmd, m_HiZ.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_HiZ.levelCount, 0, 1 });
+		m_vulkanDevice->flushCommandBuffer(layoutCmd, m_rtFilterDemo->queue);
+
+		std::vector<VkDescriptorImageInfo> sourceDescriptors(m_HiZ.levelCount);
+		std::vector<VkDescriptorImageInfo> destDescriptors(m_HiZ.levelCount);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+		for (uint32_t level = 0; level < m_HiZ.levelCount; level++)
+		{
+			sourceDescriptors[level] = (level == 0)
+				? vks::initializers::descriptorImageInfo(m_HiZSampler, m_DepthAttachment->view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL)
+				: vks::initializers::descriptorImageInfo(m_HiZSampler, m_HiZ.levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL);
+			destDescriptors[level] = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, m_HiZ.levelViews[level], VK_IMAGE_LAYOUT_GENERAL);
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(m_HiZ.descriptorSets[level], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &sourceDescriptors[level]));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(m_HiZ.descriptorSets[level], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &destDescriptors[level]));
+		}
+		VkDescriptorImageInfo pyramidDescriptor = vks::initializers::descriptorImageInfo(m_HiZSampler, m_HiZ.view, VK_IMAGE_LAYOUT_GENERAL);
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(m_CullDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &pyramidDescriptor));
+		vkUpdateDescriptorSets(getLogicalDevice(), static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void RenderpassGbuffer::destroyHiZ()
+	{
+		for (VkImageView view : m_HiZ.levelViews)
+		{
+			vkDestroyImageView(getLogicalDevice(), view, nullptr);
+		}
+		vkDestroyImageView(getLogicalDevice(), m_HiZ.view, nullptr);
+		vkDestroyImage(getLogicalDevice(), m_HiZ.image, nullptr);
+		vkFreeMemory(getLogicalDevice(), m_HiZ.memory, nullptr);
+		m_HiZ.levelViews.clear();
+		m_HiZ.view = VK_NULL_HANDLE;
+		m_HiZ.image = VK_NULL_HANDLE;
+		m_HiZ.memory = VK_NULL_HANDLE;
+		m_HiZ.levelCount = 0;
+		m_HiZValid = false;
+	}
+
+	void RenderpassGbuffer::recordCulling(VkCommandBuffer cmdBuffer)
+	{
+		// The previous frame's indirect draws have to be done with the buffers before they are reset
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdFillBuffer(cmdBuffer, m_DrawCount.buffer, 0, VK_WHOLE_SIZE, 0);
+
+		// Cleared count and the pyramid written at the end of the previous frame
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		const uint32_t workgroupSize = 64;
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullPipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullPipelineLayout, 0, 1, &m_CullDescriptorSet, 0, nullptr);
+		vkCmdDispatch(cmdBuffer, (m_CullPrimitiveCount + workgroupSize - 1) / workgroupSize, 1, 1);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void RenderpassGbuffer::recordIndirectDraws(VkCommandBuffer cmdBuffer, VkExtent2D size, VkBuffer vertexBuffer)
+	{
 		VkViewport viewport = vks::initializers::viewport((float)size.width, (float)size.height, 0.0f, 1.0f);
-		vkCmdSetViewport(m_CmdBuffer, 0, 1, &viewport);
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 
 		VkRect2D scissor = vks::initializers::rect2D(size.width, size.height, 0, 0);
-		vkCmdSetScissor(m_CmdBuffer, 0, 1, &scissor);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_RecordedVisibilityBuffer ? m_VisibilityPipeline : m_pipeline);
+		const std::array<VkDescriptorSet, 2> descriptorSets = { m_DescriptorSetScene, m_DescriptorSetMaterials };
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
+		m_Scene->bindBuffers(cmdBuffer, vertexBuffer);
+
+		// The whole scene in one draw, the count is written by the culling
+		vkCmdDrawIndexedIndirectCount(cmdBuffer, m_DrawCommands.buffer, 0, m_DrawCount.buffer, 0, m_CullPrimitiveCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
 
-		vkCmdBindPipeline(m_CmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+	void RenderpassGbuffer::recordHiZBuild(VkCommandBuffer cmdBuffer, VkExtent2D size)
+	{
+		const VkImageSubresourceRange depthRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
 
-		// Instanced object
-		vkCmdBindDescriptorSets(m_CmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_DescriptorSetScene, 0, nullptr);
-		m_Scene->draw(m_CmdBuffer, vkglTF::RenderFlags::BindImages, m_pipelineLayout, 1); // vkglTF::RenderFlags::BindImages
+		VkImageMemoryBarrier depthBarrier = vks::initializers::imageMemoryBarrier();
+		depthBarrier.image = m_DepthAttachment->image;
+		depthBarrier.subresourceRange = depthRange;
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		// The culling of this frame has read the pyramid before it is overwritten
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 1, &depthBarrier);
 
-		vkCmdEndRenderPass(m_CmdBuffer);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_HiZPipeline);
+		const uint32_t workgroupSize = 8;
+		VkExtent2D sourceSize = size;
+		for (uint32_t level = 0; level < m_HiZ.levelCount; level++)
+		{
+			SPC_HiZConfig config{};
+			config.SourceWidth = sourceSize.width;
+			config.SourceHeight = sourceSize.height;
+			config.DestWidth = std::max(1u, sourceSize.width / 2);
+			config.DestHeight = std::max(1u, sourceSize.height / 2);
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_HiZPipelineLayout, 0, 1, &m_HiZ.descriptorSets[level], 0, nullptr);
+			vkCmdPushConstants(cmdBuffer, m_HiZPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SPC_HiZConfig), &config);
+			vkCmdDispatch(cmdBuffer, (config.DestWidth + workgroupSize - 1) / workgroupSize, (config.DestHeight + workgroupSize - 1) / workgroupSize, 1);
 
-		VK_CHECK_RESULT(vkEndCommandBuffer(m_CmdBuffer));
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			sourceSize = { config.DestWidth, config.DestHeight };
+		}
+
+		// Back to the layout the render pass leaves the depth in, which the following passes expect
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
 	}
 
 	void RenderpassGbuffer::preparePipeline()
@@ -267,7 +970,8 @@ namespace rtf
 				vkglTF::VertexComponent::Color,
 				vkglTF::VertexComponent::Normal,
 				vkglTF::VertexComponent::Tangent,
-				vkglTF::VertexComponent::MeshId
+				vkglTF::VertexComponent::MeshId,
+				vkglTF::VertexComponent::MaterialId
 			}
 		);
 		rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
@@ -287,5 +991,214 @@ namespace rtf
 		colorBlendState.pAttachments = blendAttachmentStates.data();
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(m_vulkanDevice->logicalDevice, m_PipelineCache, 1, &pipelineCI, nullptr, &m_pipeline));
+
+		if (m_VisibilityRenderpass != VK_NULL_HANDLE)
+		{
+			// Visibility buffer pipeline, only the position is fetched and a single id attachment is written
+			VkPipelineShaderStageCreateInfo visibilityShaderStages[2]
+			{
+				m_rtFilterDemo->LoadShader("prepass/visibility.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+				m_rtFilterDemo->LoadShader("prepass/visibility.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+			};
+			pipelineCI.renderPass = m_VisibilityRenderpass;
+			pipelineCI.pStages = visibilityShaderStages;
+			pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position });
+			colorBlendState.attachmentCount = 1;
+			colorBlendState.pAttachments = &blendAttachmentState;
+
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(m_vulkanDevice->logicalDevice, m_PipelineCache, 1, &pipelineCI, nullptr, &m_VisibilityPipeline));
+		}
+	}
+
+	void RenderpassGbuffer::prepareVisibilityRenderpass()
+	{
+		// Triangle ids and the depth, which the later passes read just like after the G-buffer pass
+		VkAttachmentDescription attachmentDescriptions[2] = {};
+		FrameBufferAttachment* attachments[] = { m_VisibilityAttachment, m_DepthAttachment };
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			attachmentDescriptions[i].samples = VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT;
+			attachmentDescriptions[i].loadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachmentDescriptions[i].storeOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_STORE;
+			attachmentDescriptions[i].stencilLoadOp = VkAttachmentLoadOp::VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachmentDescriptions[i].stencilStoreOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachmentDescriptions[i].initialLayout = VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED;
+			attachmentDescriptions[i].finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_GENERAL;
+			attachmentDescriptions[i].format = attachments[i]->format;
+		}
+		attachmentDescriptions[1].finalLayout = VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		attachmentDescriptions[1].stencilStoreOp = VkAttachmentStoreOp::VK_ATTACHMENT_STORE_OP_STORE;
+
+		VkAttachmentReference attachmentReference_Color = { 0, VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference attachmentReference_Depth = { 1, VkImageLayout::VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &attachmentReference_Color;
+		subpass.pDepthStencilAttachment = &attachmentReference_Depth;
+
+		VkSubpassDependency subPassDependencies[2] = {};
+		subPassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		subPassDependencies[0].dstSubpass = 0;
+		subPassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		subPassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		subPassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		subPassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		subPassDependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		subPassDependencies[1].srcSubpass = 0;
+		subPassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		subPassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		subPassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		subPassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		subPassDependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		subPassDependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.pAttachments = attachmentDescriptions;
+		renderPassInfo.attachmentCount = 2;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = 2;
+		renderPassInfo.pDependencies = subPassDependencies;
+
+		VK_CHECK_RESULT(vkCreateRenderPass(m_vulkanDevice->logicalDevice, &renderPassInfo, nullptr, &m_VisibilityRenderpass));
+	}
+
+	void RenderpassGbuffer::prepareVisibilityResolve()
+	{
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Scene info
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Visibility buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Vertices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3: Indices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			// Binding 4: Material buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			// Binding 5: All scene textures
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 5, static_cast<uint32_t>(m_Scene->textures.size())),
+			// Binding 6 - 10: G-buffer attachments
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 6),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 7),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 8),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 9),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 10),
+			// Binding 11: Draw primitives
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 11),
+			// Binding 12: Node instances
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 12),
+			// Binding 13: Previous frame's vertices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 13),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_vulkanDevice->logicalDevice, &descriptorLayout, nullptr, &m_ResolveDescriptorSetLayout));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &m_ResolveDescriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(m_vulkanDevice->logicalDevice, &allocInfo, &m_ResolveDescriptorSet));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(SPC_VisibilityResolve), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = vks::initializers::pipelineLayoutCreateInfo(&m_ResolveDescriptorSetLayout, 1);
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(m_vulkanDevice->logicalDevice, &pipelineLayoutInfo, nullptr, &m_ResolvePipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineInfo = vks::initializers::computePipelineCreateInfo(m_ResolvePipelineLayout, 0);
+		pipelineInfo.stage = m_rtFilterDemo->LoadShader("prepass/visibility_resolve.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(m_vulkanDevice->logicalDevice, m_PipelineCache, 1, &pipelineInfo, nullptr, &m_ResolvePipeline));
+	}
+
+	void RenderpassGbuffer::updateResolveDescriptorSet(VkBuffer vertexBuffer)
+	{
+		VkDescriptorImageInfo visibilityDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, m_VisibilityAttachment->view, VK_IMAGE_LAYOUT_GENERAL);
+		VkDescriptorBufferInfo vertexBufferDescriptor{ vertexBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo indexBufferDescriptor{ m_Scene->indices.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo materialBufferDescriptor{ m_Scene->shadeMaterials.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo primitivesDescriptor{ m_CullPrimitives.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo instancesDescriptor{ m_NodeInstances.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo previousVerticesDescriptor{ m_rtFilterDemo->m_renderpassManager->m_RP_Skinning->getPreviousVertexBuffer(), 0, VK_WHOLE_SIZE };
+		std::vector<VkDescriptorImageInfo> textureDescriptors;
+		for (const vkglTF::Texture& texture : m_Scene->textures)
+		{
+			textureDescriptors.push_back(texture.descriptor);
+		}
+		FrameBufferAttachment* outputs[] = { m_PositionAttachment, m_NormalAttachment, m_AlbedoAttachment, m_MotionAttachment, m_MeshIdAttachment };
+		std::array<VkDescriptorImageInfo, 5> outputDescriptors;
+		for (uint32_t i = 0; i < outputDescriptors.size(); i++)
+		{
+			outputDescriptors[i] = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, outputs[i]->view, VK_IMAGE_LAYOUT_GENERAL);
+		}
+
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			// Binding 0: Scene info
+			m_rtFilterDemo->m_UBO_SceneInfo->writeDescriptorSet(m_ResolveDescriptorSet, 0),
+			// Binding 1: Visibility buffer
+			vks::initializers::writeDescriptorSet(m_ResolveDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &visibilityDescriptor),
+			// Binding 2: Vertices, skinned ones if the scene is animated
+			vks::initializers::writeDescriptorSet(m_ResolveDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &vertexBufferDescriptor),
+			// Binding 3: Indices
+			vks::initializers::writeDescriptorSet(m_ResolveDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &indexBufferDescriptor),
+			// Binding 4: Material buffer
+			vks::initializers::writeDescriptorSet(m_ResolveDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &materialBufferDescriptor),
+			// Binding 11: Draw primitives
+			vks::initializers::writeDescriptorSet(m_ResolveDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 11, &primitivesDescriptor),
+			// Binding 12: Node instances
+			vks::initializers::writeDescriptorSet(m_ResolveDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 12, &instancesDescriptor),
+			// Binding 13: Previous frame's vertices
+			vks::initializers::writeDescriptorSet(m_ResolveDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 13, &previousVerticesDescriptor),
+		};
+		if (!textureDescriptors.empty())
+		{
+			// Binding 5: Scene textures
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(m_ResolveDescriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, textureDescriptors.data(), static_cast<uint32_t>(textureDescriptors.size())));
+		}
+		for (uint32_t i = 0; i < outputDescriptors.size(); i++)
+		{
+			// Binding 6 - 10: G-buffer attachments
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(m_ResolveDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 6 + i, &outputDescriptors[i]));
+		}
+		vkUpdateDescriptorSets(m_vulkanDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		m_ResolveVertexBuffer = vertexBuffer;
+	}
+
+	void RenderpassGbuffer::recordVisibilityResolve(VkCommandBuffer cmdBuffer, VkExtent2D size)
+	{
+		// The resolve overwrites every pixel, so the G-buffer attachments are taken from any layout
+		FrameBufferAttachment* outputs[] = { m_PositionAttachment, m_NormalAttachment, m_AlbedoAttachment, m_MotionAttachment, m_MeshIdAttachment };
+		std::array<VkImageMemoryBarrier, 5> outputBarriers;
+		for (uint32_t i = 0; i < outputBarriers.size(); i++)
+		{
+			outputBarriers[i] = vks::initializers::imageMemoryBarrier();
+			outputBarriers[i].image = outputs[i]->image;
+			outputBarriers[i].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			outputBarriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			outputBarriers[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			outputBarriers[i].srcAccessMask = 0;
+			outputBarriers[i].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		}
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			1, &memoryBarrier, 0, nullptr, static_cast<uint32_t>(outputBarriers.size()), outputBarriers.data());
+
+		const uint32_t workgroupSize = 8;
+		SPC_VisibilityResolve config;
+		config.RenderWidth = size.width;
+		config.RenderHeight = size.height;
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ResolvePipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ResolvePipelineLayout, 0, 1, &m_ResolveDescriptorSet, 0, nullptr);
+		vkCmdPushConstants(cmdBuffer, m_ResolvePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SPC_VisibilityResolve), &config);
+		vkCmdDispatch(cmdBuffer, (size.width + workgroupSize - 1) / workgroupSize, (size.height + workgroupSize - 1) / workgroupSize, 1);
+
+		// Later passes read the G-buffer in any stage
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 	}
 }
@@ -143,16 +143,7 @@ namespace rtf
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(m_vulkanDevice->logicalDevice, &allocInfo, &m_descriptorSet));
 
-		std::vector<VkDescriptorImageInfo> imageInfos{};
-		imageInfos.reserve(m_attachments.size());
-		for (size_t i = 0; i < m_attachments.size(); i++)
-		{
-			imageInfos.push_back(vks::initializers::descriptorImageInfo(m_rtFilterDemo->m_DefaultColorSampler, m_attachments[i].m_Attachment->view, VK_IMAGE_LAYOUT_GENERAL));
-		}
-
 		writeDescriptorSets = {
-			// Binding 1 : Attachment array
-			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, imageInfos.data(), m_attachments.size()),
 			// Binding 2 : Fragment shader uniform buffer
 			m_rtFilterDemo->m_UBO_Guibase->writeDescriptorSet(m_descriptorSet, 2),
 			// Binding 3 : SceneInfo uniform buffer
@@ -160,6 +151,28 @@ namespace rtf
 		};
 
 		vkUpdateDescriptorSets(m_vulkanDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		writeAttachmentDescriptors();
+	}
+
+	void RenderpassGui::writeAttachmentDescriptors()
+	{
+		std::vector<VkDescriptorImageInfo> imageInfos{};
+		imageInfos.reserve(m_attachments.size());
+		for (size_t i = 0; i < m_attachments.size(); i++)
+		{
+			imageInfos.push_back(vks::initializers::descriptorImageInfo(m_rtFilterDemo->m_DefaultColorSampler, m_attachments[i].m_Attachment->view, VK_IMAGE_LAYOUT_GENERAL));
+		}
+
+		// Binding 1 : Attachment array
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, imageInfos.data(), m_attachments.size());
+		vkUpdateDescriptorSets(m_vulkanDevice->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+	}
+
+	void RenderpassGui::onAttachmentsChanged()
+	{
+		// The swapchain command buffers are shared by all gui passes, RTFilterDemo rebuilds them for the active one
+		writeAttachmentDescriptors();
 	}
 
 	void RenderpassGui::prepareRenderpass()
@@ -256,9 +269,14 @@ namespace rtf
 		m_attachments = attachmentBindings;
 		m_dropoutOptions.clear();
 		m_dropoutOptions.reserve(m_attachments.size());
-		for (auto& attachment : m_attachments)
+		m_outputResolutionMask = 0;
+		for (size_t i = 0; i < m_attachments.size(); i++)
 		{
-			m_dropoutOptions.push_back(attachment.m_Displayname);
+			m_dropoutOptions.push_back(m_attachments[i].m_Displayname);
+			if (m_attachments[i].m_OutputResolution && i < 32)
+			{
+				m_outputResolutionMask |= 1U << i;
+			}
 		}
 	}
 
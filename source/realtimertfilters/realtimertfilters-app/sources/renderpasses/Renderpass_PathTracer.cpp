@@ -1,8 +1,14 @@
 #include "../../headers/renderpasses/Renderpass_PathTracer.hpp"
 #include "../../headers/RTFilterDemo.hpp"
+#include "../../headers/renderpasses/RenderpassManager.hpp"
+#include "../../headers/renderpasses/Renderpass_Skinning.hpp"
+#include "../../headers/BlueNoise.hpp"
 #include "../../data/shaders/glsl/pathTracerShader/binding.glsl"
 #include "../../data/shaders/glsl/pathTracerShader/gltf.glsl"
 #include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
 
 namespace rtf
 {
@@ -11,7 +17,8 @@ namespace rtf
 		// Init push Constant
 		initData();
 		prepareAttachement();
-		createMaterialBuffer();
+		createLightBuffer();
+		createBlueNoiseTexture();
 		createDescriptorImageInfos();
 
 		// Get the function pointers required for ray tracing
@@ -22,9 +29,18 @@ namespace rtf
 		vkDestroyAccelerationStructureKHR = reinterpret_cast<PFN_vkDestroyAccelerationStructureKHR>(vkGetDeviceProcAddr(m_vulkanDevice->logicalDevice, "vkDestroyAccelerationStructureKHR"));
 		vkGetAccelerationStructureBuildSizesKHR = reinterpret_cast<PFN_vkGetAccelerationStructureBuildSizesKHR>(vkGetDeviceProcAddr(m_vulkanDevice->logicalDevice, "vkGetAccelerationStructureBuildSizesKHR"));
 		vkGetAccelerationStructureDeviceAddressKHR = reinterpret_cast<PFN_vkGetAccelerationStructureDeviceAddressKHR>(vkGetDeviceProcAddr(m_vulkanDevice->logicalDevice, "vkGetAccelerationStructureDeviceAddressKHR"));
-		vkCmdTraceRaysKHR = reinterpret_cast<PFN_vkCmdTraceRaysKHR>(vkGetDeviceProcAddr(m_vulkanDevice->logicalDevice, "vkCmdTraceRaysKHR"));
-		vkGetRayTracingShaderGroupHandlesKHR = reinterpret_cast<PFN_vkGetRayTracingShaderGroupHandlesKHR>(vkGetDeviceProcAddr(m_vulkanDevice->logicalDevice, "vkGetRayTracingShaderGroupHandlesKHR"));
-		vkCreateRayTracingPipelinesKHR = reinterpret_cast<PFN_vkCreateRayTracingPipelinesKHR>(vkGetDeviceProcAddr(m_vulkanDevice->logicalDevice, "vkCreateRayTracingPipelinesKHR"));
+		vkCmdWriteAccelerationStructuresPropertiesKHR = reinterpret_cast<PFN_vkCmdWriteAccelerationStructuresPropertiesKHR>(vkGetDeviceProcAddr(m_vulkanDevice->logicalDevice, "vkCmdWriteAccelerationStructuresPropertiesKHR"));
+		vkCmdCopyAccelerationStructureKHR = reinterpret_cast<PFN_vkCmdCopyAccelerationStructureKHR>(vkGetDeviceProcAddr(m_vulkanDevice->logicalDevice, "vkCmdCopyAccelerationStructureKHR"));
+		vkCmdCopyAccelerationStructureToMemoryKHR = reinterpret_cast<PFN_vkCmdCopyAccelerationStructureToMemoryKHR>(vkGetDeviceProcAddr(m_vulkanDevice->logicalDevice, "vkCmdCopyAccelerationStructureToMemoryKHR"));
+		vkCmdCopyMemoryToAccelerationStructureKHR = reinterpret_cast<PFN_vkCmdCopyMemoryToAccelerationStructureKHR>(vkGetDeviceProcAddr(m_vulkanDevice->logicalDevice, "vkCmdCopyMemoryToAccelerationStructureKHR"));
+		vkGetDeviceAccelerationStructureCompatibilityKHR = reinterpret_cast<PFN_vkGetDeviceAccelerationStructureCompatibilityKHR>(vkGetDeviceProcAddr(m_vulkanDevice->logicalDevice, "vkGetDeviceAccelerationStructureCompatibilityKHR"));
+		// VK_KHR_ray_tracing_pipeline is only enabled for the pipeline backend
+		if (!m_rtFilterDemo->m_useRayQueryPathTracer)
+		{
+			vkCmdTraceRaysKHR = reinterpret_cast<PFN_vkCmdTraceRaysKHR>(vkGetDeviceProcAddr(m_vulkanDevice->logicalDevice, "vkCmdTraceRaysKHR"));
+			vkGetRayTracingShaderGroupHandlesKHR = reinterpret_cast<PFN_vkGetRayTracingShaderGroupHandlesKHR>(vkGetDeviceProcAddr(m_vulkanDevice->logicalDevice, "vkGetRayTracingShaderGroupHandlesKHR"));
+			vkCreateRayTracingPipelinesKHR = reinterpret_cast<PFN_vkCreateRayTracingPipelinesKHR>(vkGetDeviceProcAddr(m_vulkanDevice->logicalDevice, "vkCreateRayTracingPipelinesKHR"));
+		}
 
 		// Create the acceleration structures used to render the ray traced scene
 		createBottomLevelAccelerationStructure();
@@ -45,14 +61,45 @@ namespace rtf
 		out_commandBuffers = &m_commandBuffer;
 	}
 
+	void RenderpassPathTracer::updateUniformBuffer()
+	{
+		updateLights();
+
+		// Only the SVGF queue writes the sample budget
+		const RenderpassManager* renderpassManager = m_rtFilterDemo->m_renderpassManager;
+		const bool adaptiveSampling = m_rtFilterDemo->m_UBO_AdaptiveSamplingConfig->UBO().EnableAdaptiveSampling != 0;
+		m_pathtracerconfig.AdaptiveSampling = (adaptiveSampling && renderpassManager->m_QT_Active == renderpassManager->m_QT_SVGF) ? 1 : 0;
+
+		const VkExtent2D renderSize = m_attachmentManager->GetRenderSize();
+		m_pathtracerconfig.RenderWidth = renderSize.width;
+		m_pathtracerconfig.RenderHeight = renderSize.height;
+
+		// Reduced indirect light needs the upsampling pass of the SVGF queue
+		const bool reducedIndirect = renderpassManager->m_ReducedIndirect && renderpassManager->m_QT_Active == renderpassManager->m_QT_SVGF;
+		m_pathtracerconfig.IndirectMode = reducedIndirect ? static_cast<uint>(m_rtFilterDemo->m_UBO_ReducedIndirectConfig->UBO().IndirectMode) : INDIRECT_MODE_FULL;
+
+		// ReSTIR DI runs in the SVGF queue only, and then owns the direct light of the primary hit
+		m_pathtracerconfig.RestirDirect = (renderpassManager->m_RP_RestirDI && renderpassManager->m_QT_Active == renderpassManager->m_QT_SVGF) ? 1 : 0;
+	}
+
 	void RenderpassPathTracer::cleanUp() {
 		deleteStorageImage();
-		deleteAccelerationStructure(m_bottomLevelAS);
+		for (BottomLevelInstance& blas : m_bottomLevelAS)
+		{
+			deleteAccelerationStructure(blas.accelerationStructure);
+		}
+		m_bottomLevelAS.clear();
 		deleteAccelerationStructure(m_topLevelAS);
+		deleteScratchBuffer(m_scratchBuffer);
+		m_scratchBuffer = {};
+		deleteScratchBuffer(m_bottomLevelScratchBuffer);
+		m_bottomLevelScratchBuffer = {};
+		m_instancesBuffer.destroy();
 		m_shaderBindingTables.raygen.destroy();
 		m_shaderBindingTables.miss.destroy();
 		m_shaderBindingTables.hit.destroy();
-		m_material_buffer.destroy();
+		m_light_buffer.destroy();
+		m_blueNoise.destroy();
 
 		vkDestroyDescriptorPool(m_vulkanDevice->logicalDevice, m_descriptorPool, nullptr);
 		vkDestroyPipeline(m_vulkanDevice->logicalDevice, m_pipeline, nullptr);
@@ -75,29 +122,43 @@ namespace rtf
 	{
 		uint32_t frameNumber = m_rtFilterDemo->frameCounter;
 		m_pathtracerconfig.Frame++;
-		m_pathtracerconfig.VertexSize = sizeof(vkglTF::Vertex);
 	}
 
-	void RenderpassPathTracer::createRayTracingPipeline() {
+	void RenderpassPathTracer::createPipelineLayout(VkShaderStageFlags raygenStages, VkShaderStageFlags hitStages, VkShaderStageFlags missStages)
+	{
 		std::vector<VkDescriptorSetLayoutBinding> layoutBindingSet = {
 			// Acceleration structure
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR , B_ACCELERATIONSTRUCTURE),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, raygenStages | hitStages, B_ACCELERATIONSTRUCTURE),
 			// Storage image
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_RAYGEN_BIT_KHR,B_IMAGE),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, raygenStages,B_IMAGE),
 			//  Uniform buffer
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR, B_UBO),
-			// Vertex buffer 
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, B_VERTICES),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, raygenStages | hitStages | missStages, B_UBO),
+			// Vertex buffer (hit shading stream)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, hitStages, B_VERTICES),
 			// Index buffer
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, B_INDICES),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, hitStages, B_INDICES),
+			// Material index per triangle
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, hitStages, B_HITTRIANGLES),
 			//  Material
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, B_MATERIALS),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, hitStages, B_MATERIALS),
 			//  Textures
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, B_TEXTURES,m_Scene->textures.size()),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, hitStages, B_TEXTURES,m_Scene->textures.size()),
 			// Storage image (direct)
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_RAYGEN_BIT_KHR, B_IMAGE_DIRECT),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, raygenStages, B_IMAGE_DIRECT),
 			// Storage image (indirect)
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_RAYGEN_BIT_KHR, B_IMAGE_INDIRECT),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, raygenStages, B_IMAGE_INDIRECT),
+			// Lights
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, raygenStages, B_LIGHTS),
+			// Blue noise tiles
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, raygenStages, B_BLUENOISE),
+			// Storage image (sample budget)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, raygenStages, B_IMAGE_SAMPLEBUDGET),
+			// Storage image (reduced indirect)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, raygenStages, B_IMAGE_INDIRECT_REDUCED),
+			// G-buffer images (hybrid primary visibility)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, raygenStages, B_GBUFFER_POSITION),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, raygenStages, B_GBUFFER_NORMAL),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, raygenStages, B_GBUFFER_ALBEDO),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(layoutBindingSet);
@@ -116,6 +177,10 @@ namespace rtf
 		pPipelineLayoutCI.pushConstantRangeCount = 1;
 
 		VK_CHECK_RESULT(vkCreatePipelineLayout(m_vulkanDevice->logicalDevice, &pPipelineLayoutCI, nullptr, &m_pipelineLayout));
+	}
+
+	void RenderpassPathTracer::createRayTracingPipeline() {
+		createPipelineLayout(VK_SHADER_STAGE_RAYGEN_BIT_KHR, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, VK_SHADER_STAGE_MISS_BIT_KHR);
 
 		//Setup path tracing shader groups
 		std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
@@ -168,7 +233,8 @@ namespace rtf
 		rayTracingPipelineCI.pStages = shaderStages.data();
 		rayTracingPipelineCI.groupCount = static_cast<uint32_t>(shaderGroups.size());
 		rayTracingPipelineCI.pGroups = shaderGroups.data();
-		rayTracingPipelineCI.maxPipelineRayRecursionDepth = 2;
+		// The bounce loop lives in raygen, hit shaders never trace further rays
+		rayTracingPipelineCI.maxPipelineRayRecursionDepth = 1;
 		rayTracingPipelineCI.layout = m_pipelineLayout;
 		VK_CHECK_RESULT(vkCreateRayTracingPipelinesKHR(m_vulkanDevice->logicalDevice, VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &rayTracingPipelineCI, nullptr, &m_pipeline));
 	}
@@ -177,9 +243,9 @@ namespace rtf
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			{ VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3 },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 8 },
 			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 },
 			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 100 }
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
@@ -201,31 +267,30 @@ namespace rtf
 		accelerationStructureWrite.descriptorCount = 1;
 		accelerationStructureWrite.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
 
-		VkDescriptorImageInfo storageImageDescriptor_output{ VK_NULL_HANDLE, m_Rtoutput->view, VK_IMAGE_LAYOUT_GENERAL };
-		VkDescriptorImageInfo storageImageDescriptor_direct{ VK_NULL_HANDLE, m_Direct->view, VK_IMAGE_LAYOUT_GENERAL };
-		VkDescriptorImageInfo storageImageDescriptor_indirect{ VK_NULL_HANDLE, m_Indirect->view, VK_IMAGE_LAYOUT_GENERAL };
-		VkDescriptorBufferInfo vertexBufferDescriptor{ m_Scene->vertices.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo vertexBufferDescriptor{ m_Scene->hitVertices.buffer, 0, VK_WHOLE_SIZE };
 		VkDescriptorBufferInfo indexBufferDescriptor{ m_Scene->indices.buffer, 0, VK_WHOLE_SIZE };
-		VkDescriptorBufferInfo materialBufferDescriptor{ m_material_buffer.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo hitTriangleDescriptor{ m_Scene->hitTriangles.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo materialBufferDescriptor{ m_Scene->shadeMaterials.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo lightBufferDescriptor{ m_light_buffer.buffer, 0, VK_WHOLE_SIZE };
 
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 			// Top level acceleration structure
 			accelerationStructureWrite,
-			// Ray tracing result image
-			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_IMAGE, &storageImageDescriptor_output),
 			// Uniform data
 			m_rtFilterDemo->m_UBO_SceneInfo->writeDescriptorSet(m_descriptorSet, B_UBO),
 			//vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, B_UBO, &m_uniformBufferObject.descriptor),
-			// Scene vertex buffer
+			// Scene hit shading vertex stream
 			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, B_VERTICES, &vertexBufferDescriptor),
 			// Scene index buffer
 			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, B_INDICES, &indexBufferDescriptor),
+			// Scene triangle materials
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, B_HITTRIANGLES, &hitTriangleDescriptor),
 			// Material buffer
 			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, B_MATERIALS, &materialBufferDescriptor),
-			// Ray tracing direct lighting image
-			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_IMAGE_DIRECT, &storageImageDescriptor_direct),
-			// Ray tracing indirect lighting image
-			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_IMAGE_INDIRECT, &storageImageDescriptor_indirect),
+			// Light buffer
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, B_LIGHTS, &lightBufferDescriptor),
+			// Blue noise tiles
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, B_BLUENOISE, &m_blueNoise.descriptor),
 			//// Textures
 			//vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, B_TEXTURES, &textures)
 		};
@@ -238,32 +303,205 @@ namespace rtf
 			);
 		}
 		vkUpdateDescriptorSets(m_vulkanDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, VK_NULL_HANDLE);
+
+		writeAttachmentDescriptors();
 	}
 
-	void RenderpassPathTracer::createDescriptorImageInfos() {
-		if (m_Scene->textures.data() != nullptr) {
-			for (int i = 0; i < m_Scene->textures.size(); i++) {
-				m_textures.push_back(m_Scene->textures[i].descriptor);
-			}
-		}
+	/*
+		Storage images of the attachment manager, rewritten whenever the attachments are reallocated
+	*/
+	void RenderpassPathTracer::writeAttachmentDescriptors()
+	{
+		VkDescriptorImageInfo storageImageDescriptor_output{ VK_NULL_HANDLE, m_Rtoutput->view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo storageImageDescriptor_direct{ VK_NULL_HANDLE, m_Direct->view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo storageImageDescriptor_indirect{ VK_NULL_HANDLE, m_Indirect->view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo storageImageDescriptor_sampleBudget{ VK_NULL_HANDLE, m_SampleBudget->view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo storageImageDescriptor_indirectReduced{ VK_NULL_HANDLE, m_IndirectReduced->view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo gbufferPositionDescriptor{ VK_NULL_HANDLE, m_attachmentManager->getAttachment(Attachment::position)->view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo gbufferNormalDescriptor{ VK_NULL_HANDLE, m_attachmentManager->getAttachment(Attachment::normal)->view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo gbufferAlbedoDescriptor{ VK_NULL_HANDLE, m_attachmentManager->getAttachment(Attachment::albedo)->view, VK_IMAGE_LAYOUT_GENERAL };
+
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			// Ray tracing result image
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_IMAGE, &storageImageDescriptor_output),
+			// Ray tracing direct lighting image
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_IMAGE_DIRECT, &storageImageDescriptor_direct),
+			// Ray tracing indirect lighting image
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_IMAGE_INDIRECT, &storageImageDescriptor_indirect),
+			// Per pixel sample count of adaptive sampling
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_IMAGE_SAMPLEBUDGET, &storageImageDescriptor_sampleBudget),
+			// Reduced resolution indirect lighting image
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_IMAGE_INDIRECT_REDUCED, &storageImageDescriptor_indirectReduced),
+			// G-buffer the paths start at with hybrid primary visibility
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_GBUFFER_POSITION, &gbufferPositionDescriptor),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_GBUFFER_NORMAL, &gbufferNormalDescriptor),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_GBUFFER_ALBEDO, &gbufferAlbedoDescriptor),
+		};
+		vkUpdateDescriptorSets(m_vulkanDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, VK_NULL_HANDLE);
+	}
+
+	/*
+		Light sampling weights are the luminance of the emitted power. Analytic and area lights share one scale,
+		a point light of flux 1 weighs as much as a white triangle emitting a total power of 1
+	*/
+	static float lightLuminance(const glm::vec3& color)
+	{
+		return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+	}
+
+	void RenderpassPathTracer::createBlueNoiseTexture()
+	{
+		// Generated instead of loaded, void and cluster on 64x64 tiles takes a fraction of a second
+		const uint32_t size = 64;
+		const uint32_t layerCount = 8;
+		std::vector<uint8_t> tiles = BlueNoise::generateTextureArray(size, layerCount, 2);
+		m_blueNoise.fromBuffer(tiles.data(), tiles.size(), VK_FORMAT_R8G8_UNORM, size, size, layerCount, m_vulkanDevice, m_queue, VK_FILTER_NEAREST);
 	}
 
-	void RenderpassPathTracer::createMaterialBuffer()
+	void RenderpassPathTracer::createLightBuffer()
 	{
-		std::vector<vkglTF::Material> materials = m_Scene->materials;
-		this->m_materials.resize(materials.size());
-		for (int i = 0; i < materials.size(); i++) {
-			m_materials[i].baseColorFactor = materials[i].baseColorFactor;
-			m_materials[i].baseColorTextureId = glm::vec4(materials[i].baseColorTextureId);
+		m_emissiveLights.clear();
+		m_emissiveLightWeights.clear();
+		for (const vkglTF::Model::EmissiveTriangle& triangle : m_Scene->emissiveTriangles)
+		{
+			S_SceneLight light{};
+			light.Position = triangle.p0;
+			light.Type = LIGHT_TYPE_TRIANGLE;
+			light.Color = triangle.emission;
+			light.RadiantFlux = 1.f;
+			light.Edge1 = triangle.p1 - triangle.p0;
+			light.Edge2 = triangle.p2 - triangle.p0;
+			float area = 0.5f * glm::length(glm::cross(light.Edge1, light.Edge2));
+			float weight = lightLuminance(light.Color) * area * glm::pi<float>();
+			if (weight > 0.f)
+			{
+				m_emissiveLights.push_back(light);
+				m_emissiveLightWeights.push_back(weight);
+			}
 		}
 
+		// Room for all lights of the scene info UBO, at least one entry so the buffer is never empty
+		VkDeviceSize capacity = UBO_SCENEINFO_LIGHT_COUNT + m_emissiveLights.size();
 		VK_CHECK_RESULT(m_vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&m_material_buffer,
-			sizeof(GltfShadeMaterial) * this->m_materials.size(),
-			m_materials.data())
+			&m_light_buffer,
+			sizeof(S_SceneLight) * capacity)
 		);
+		VK_CHECK_RESULT(m_light_buffer.map());
+		m_bufferedSceneLights.clear();
+		updateLights();
+	}
+
+	/*
+		Collect the enabled lights of the scene info UBO and the emissive triangles, and rebuild the alias table over them.
+		Skipped while the scene info lights stay the same, the emissive part is static
+	*/
+	void RenderpassPathTracer::updateLights()
+	{
+		if (m_light_buffer.mapped == nullptr)
+		{
+			return;
+		}
+
+		const S_Sceneinfo& sceneinfo = m_rtFilterDemo->m_UBO_SceneInfo->UBO();
+		if (m_bufferedSceneLights.size() == UBO_SCENEINFO_LIGHT_COUNT && memcmp(m_bufferedSceneLights.data(), sceneinfo.Lights, sizeof(sceneinfo.Lights)) == 0)
+		{
+			return;
+		}
+		m_bufferedSceneLights.assign(sceneinfo.Lights, sceneinfo.Lights + UBO_SCENEINFO_LIGHT_COUNT);
+
+		std::vector<S_SceneLight> lights;
+		std::vector<float> weights;
+		lights.reserve(UBO_SCENEINFO_LIGHT_COUNT + m_emissiveLights.size());
+		weights.reserve(UBO_SCENEINFO_LIGHT_COUNT + m_emissiveLights.size());
+
+		for (const S_Light& sceneLight : sceneinfo.Lights)
+		{
+			float weight = lightLuminance(sceneLight.Color) * sceneLight.RadiantFlux;
+			// Negative types are disabled lights
+			if (sceneLight.Type < 0 || weight <= 0.f)
+			{
+				continue;
+			}
+			S_SceneLight light{};
+			light.Position = sceneLight.Position;
+			light.Type = sceneLight.Type;
+			light.Color = sceneLight.Color;
+			light.RadiantFlux = sceneLight.RadiantFlux;
+			lights.push_back(light);
+			weights.push_back(weight);
+		}
+		lights.insert(lights.end(), m_emissiveLights.begin(), m_emissiveLights.end());
+		weights.insert(weights.end(), m_emissiveLightWeights.begin(), m_emissiveLightWeights.end());
+
+		buildLightAliasTable(lights, weights);
+		memcpy(m_light_buffer.mapped, lights.data(), lights.size() * sizeof(S_SceneLight));
+		m_pathtracerconfig.LightCount = static_cast<uint32_t>(lights.size());
+	}
+
+	/*
+		Vose's alias method: every entry keeps itself with AliasProbability and redirects to Alias otherwise,
+		so picking a light proportional to its weight takes one uniform index and one coin flip
+	*/
+	void RenderpassPathTracer::buildLightAliasTable(std::vector<S_SceneLight>& lights, const std::vector<float>& weights)
+	{
+		const size_t count = lights.size();
+		double totalWeight = 0.0;
+		for (float weight : weights)
+		{
+			totalWeight += weight;
+		}
+		if (count == 0 || totalWeight <= 0.0)
+		{
+			return;
+		}
+
+		std::vector<float> scaled(count);
+		std::vector<uint32_t> small, large;
+		for (size_t i = 0; i < count; i++)
+		{
+			lights[i].SelectionPdf = static_cast<float>(weights[i] / totalWeight);
+			scaled[i] = static_cast<float>(weights[i] * count / totalWeight);
+			(scaled[i] < 1.f ? small : large).push_back(static_cast<uint32_t>(i));
+		}
+
+		while (!small.empty() && !large.empty())
+		{
+			uint32_t less = small.back();
+			small.pop_back();
+			uint32_t more = large.back();
+
+			lights[less].AliasProbability = scaled[less];
+			lights[less].Alias = more;
+
+			scaled[more] = (scaled[more] + scaled[less]) - 1.f;
+			if (scaled[more] < 1.f)
+			{
+				large.pop_back();
+				small.push_back(more);
+			}
+		}
+
+		// Leftovers are 1 up to rounding errors
+		for (uint32_t i : large)
+		{
+			lights[i].AliasProbability = 1.f;
+			lights[i].Alias = i;
+		}
+		for (uint32_t i : small)
+		{
+			lights[i].AliasProbability = 1.f;
+			lights[i].Alias = i;
+		}
+	}
+
+	void RenderpassPathTracer::createDescriptorImageInfos() {
+		if (m_Scene->textures.data() != nullptr) {
+			for (int i = 0; i < m_Scene->textures.size(); i++) {
+				m_textures.push_back(m_Scene->textures[i].descriptor);
+			}
+		}
 	}
 
 	void RenderpassPathTracer::createShaderBindingTables()
@@ -329,96 +567,499 @@ namespace rtf
 		m_Rtoutput = m_attachmentManager->getAttachment(Attachment::rtoutput);
 		m_Direct = m_attachmentManager->getAttachment(Attachment::rtdirect);
 		m_Indirect = m_attachmentManager->getAttachment(Attachment::rtindirect);
+		m_SampleBudget = m_attachmentManager->getAttachment(Attachment::sample_budget);
+		m_IndirectReduced = m_attachmentManager->getAttachment(Attachment::rtindirect_reduced);
 	}
 
 	/*
-		Create the bottom level acceleration structure contains the scene's actual geometry (vertices, triangles)
+		Create the bottom level acceleration structures containing the scene's actual geometry (vertices, triangles)
+		Every mesh node gets its own structure, so animated nodes can be moved via their instance transform
+		All structures are built in one command buffer sharing a single scratch buffer, and optionally compacted afterwards
 	*/
 	void RenderpassPathTracer::createBottomLevelAccelerationStructure()
 	{
-		VkDeviceOrHostAddressConstKHR vertexBufferDeviceAddress{};
-		VkDeviceOrHostAddressConstKHR indexBufferDeviceAddress{};
+		for (vkglTF::Node* node : m_Scene->linearNodes)
+		{
+			if (node->mesh == nullptr || node->mesh->primitives.empty())
+			{
+				continue;
+			}
+			// Primitives of a mesh are appended consecutively by the loader
+			BottomLevelInstance blas{};
+			blas.node = node;
+			blas.skinned = node->skin != nullptr;
+			blas.firstIndex = node->mesh->primitives.front()->firstIndex;
+			for (vkglTF::Primitive* primitive : node->mesh->primitives)
+			{
+				blas.indexCount += primitive->indexCount;
+			}
+			if (blas.indexCount > 0)
+			{
+				m_bottomLevelAS.push_back(blas);
+			}
+		}
 
-		vertexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(m_Scene->vertices.buffer);
-		indexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(m_Scene->indices.buffer);
+		const uint32_t blasCount = static_cast<uint32_t>(m_bottomLevelAS.size());
+		if (blasCount == 0)
+		{
+			throw std::runtime_error("RenderpassPathTracer::createBottomLevelAccelerationStructure: Scene contains no indexed geometry");
+		}
 
-		uint32_t numTriangles = static_cast<uint32_t>(m_Scene->indices.count) / 3;
-		uint32_t maxVertex = m_Scene->vertices.count;
+		// Warm start, deserialise the structures an earlier run built for this scene
+		if (loadBottomLevelAccelerationStructures())
+		{
+			return;
+		}
 
-		// Build
-		VkAccelerationStructureGeometryKHR accelerationStructureGeometry = vks::initializers::accelerationStructureGeometryKHR();
-		accelerationStructureGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
-		accelerationStructureGeometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-		accelerationStructureGeometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
-		accelerationStructureGeometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
-		accelerationStructureGeometry.geometry.triangles.vertexData = vertexBufferDeviceAddress;
-		accelerationStructureGeometry.geometry.triangles.maxVertex = maxVertex;
-		accelerationStructureGeometry.geometry.triangles.vertexStride = sizeof(vkglTF::Vertex);
-		accelerationStructureGeometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
-		accelerationStructureGeometry.geometry.triangles.indexData = indexBufferDeviceAddress;
-		accelerationStructureGeometry.geometry.triangles.transformData.deviceAddress = 0;
-		accelerationStructureGeometry.geometry.triangles.transformData.hostAddress = nullptr;
+		// All structures read the same vertex and index buffers, so they share one geometry description
+		const VkAccelerationStructureGeometryKHR accelerationStructureGeometry = getBottomLevelGeometry();
 
-		// Get size info
-		VkAccelerationStructureBuildGeometryInfoKHR accelerationStructureBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
-		accelerationStructureBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-		accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-		accelerationStructureBuildGeometryInfo.geometryCount = 1;
-		accelerationStructureBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
+		// Build info and range per structure. Kept in arrays as they are consumed after the loop
+		std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildGeometryInfos(blasCount);
+		std::vector<VkAccelerationStructureBuildRangeInfoKHR> buildRangeInfos(blasCount);
+		// Indices of the structures taking part in compaction, the query index is the position in this list
+		std::vector<uint32_t> compactedIndices{};
+		VkDeviceSize maxScratchSize = 0;
+		VkDeviceSize maxUpdateScratchSize = 0;
 
-		VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
-		vkGetAccelerationStructureBuildSizesKHR(
-			m_vulkanDevice->logicalDevice,
-			VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-			&accelerationStructureBuildGeometryInfo,
-			&numTriangles,
-			&accelerationStructureBuildSizesInfo);
+		for (uint32_t i = 0; i < blasCount; i++)
+		{
+			BottomLevelInstance& blas = m_bottomLevelAS[i];
+			uint32_t numTriangles = blas.indexCount / 3;
+
+			VkAccelerationStructureBuildGeometryInfoKHR& accelerationBuildGeometryInfo = buildGeometryInfos[i];
+			accelerationBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+			accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+			accelerationBuildGeometryInfo.flags = getBottomLevelBuildFlags(blas);
+			accelerationBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+			accelerationBuildGeometryInfo.geometryCount = 1;
+			accelerationBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
+
+			// Get size info
+			VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+			vkGetAccelerationStructureBuildSizesKHR(
+				m_vulkanDevice->logicalDevice,
+				VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+				&accelerationBuildGeometryInfo,
+				&numTriangles,
+				&accelerationStructureBuildSizesInfo);
+
+			createAccelerationStructure(blas.accelerationStructure, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, accelerationStructureBuildSizesInfo);
+			accelerationBuildGeometryInfo.dstAccelerationStructure = blas.accelerationStructure.handle;
+			maxScratchSize = std::max(maxScratchSize, accelerationStructureBuildSizesInfo.buildScratchSize);
+			if (blas.skinned)
+			{
+				maxUpdateScratchSize = std::max(maxUpdateScratchSize, accelerationStructureBuildSizesInfo.updateScratchSize);
+			}
+			else if (m_compactBottomLevelAS)
+			{
+				compactedIndices.push_back(i);
+			}
 
-		createAccelerationStructure(m_bottomLevelAS, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, accelerationStructureBuildSizesInfo);
+			VkAccelerationStructureBuildRangeInfoKHR& accelerationStructureBuildRangeInfo = buildRangeInfos[i];
+			accelerationStructureBuildRangeInfo.primitiveCount = numTriangles;
+			accelerationStructureBuildRangeInfo.primitiveOffset = blas.firstIndex * sizeof(uint32_t);
+			accelerationStructureBuildRangeInfo.firstVertex = 0;
+			accelerationStructureBuildRangeInfo.transformOffset = 0;
+		}
 
-		// Create a small scratch buffer used during build of the bottom level acceleration structure
-		ScratchBuffer scratchBuffer = createScratchBuffer(accelerationStructureBuildSizesInfo.buildScratchSize);
+		// One scratch buffer, sized for the largest build, is reused for all structures
+		ScratchBuffer scratchBuffer = createScratchBuffer(maxScratchSize);
 
-		VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
-		accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-		accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-		accelerationBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-		accelerationBuildGeometryInfo.dstAccelerationStructure = m_bottomLevelAS.handle;
-		accelerationBuildGeometryInfo.geometryCount = 1;
-		accelerationBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
-		accelerationBuildGeometryInfo.scratchData.deviceAddress = scratchBuffer.deviceAddress;
+		const uint32_t queryCount = static_cast<uint32_t>(compactedIndices.size());
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		if (queryCount > 0)
+		{
+			VkQueryPoolCreateInfo queryPoolCreateInfo{};
+			queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolCreateInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+			queryPoolCreateInfo.queryCount = queryCount;
+			VK_CHECK_RESULT(vkCreateQueryPool(m_vulkanDevice->logicalDevice, &queryPoolCreateInfo, nullptr, &queryPool));
+		}
 
-		VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
-		accelerationStructureBuildRangeInfo.primitiveCount = numTriangles;
-		accelerationStructureBuildRangeInfo.primitiveOffset = 0;
-		accelerationStructureBuildRangeInfo.firstVertex = 0;
-		accelerationStructureBuildRangeInfo.transformOffset = 0;
-		std::vector<VkAccelerationStructureBuildRangeInfoKHR*> accelerationBuildStructureRangeInfos = { &accelerationStructureBuildRangeInfo };
+		// Subsequent builds share the scratch buffer, so each build has to finish before the next one starts
+		VkMemoryBarrier buildBarrier = vks::initializers::memoryBarrier();
+		buildBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		buildBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
 
-		if (m_rtFilterDemo->accelerationStructureFeatures.accelerationStructureHostCommands)
+		VkCommandBuffer commandBuffer = m_vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		if (queryPool != VK_NULL_HANDLE)
 		{
-			// Implementation supports building acceleration structure building on host
-			// Implementation supports building acceleration structure building on host
-			vkBuildAccelerationStructuresKHR(
-				m_vulkanDevice->logicalDevice,
-				VK_NULL_HANDLE,
-				1,
-				&accelerationBuildGeometryInfo,
-				accelerationBuildStructureRangeInfos.data());
+			vkCmdResetQueryPool(commandBuffer, queryPool, 0, queryCount);
 		}
-		else
+		for (uint32_t i = 0; i < blasCount; i++)
 		{
-			// Acceleration structure needs to be build on the device
-			VkCommandBuffer commandBuffer = m_vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			buildGeometryInfos[i].pGeometries = &accelerationStructureGeometry;
+			buildGeometryInfos[i].scratchData.deviceAddress = scratchBuffer.deviceAddress;
+			const VkAccelerationStructureBuildRangeInfoKHR* accelerationBuildStructureRangeInfo = &buildRangeInfos[i];
 			vkCmdBuildAccelerationStructuresKHR(
 				commandBuffer,
 				1,
+				&buildGeometryInfos[i],
+				&accelerationBuildStructureRangeInfo);
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+				VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+				0, 1, &buildBarrier, 0, nullptr, 0, nullptr);
+		}
+		for (uint32_t query = 0; query < queryCount; query++)
+		{
+			vkCmdWriteAccelerationStructuresPropertiesKHR(
+				commandBuffer,
+				1,
+				&m_bottomLevelAS[compactedIndices[query]].accelerationStructure.handle,
+				VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR,
+				queryPool,
+				query);
+		}
+		m_vulkanDevice->flushCommandBuffer(commandBuffer, m_queue);
+		deleteScratchBuffer(scratchBuffer);
+
+		// Skinned structures keep a scratch buffer for their per frame refit
+		m_skinnedBottomLevelAS = maxUpdateScratchSize > 0;
+		if (m_skinnedBottomLevelAS)
+		{
+			m_bottomLevelScratchBuffer = createScratchBuffer(maxUpdateScratchSize);
+		}
+
+		if (queryPool != VK_NULL_HANDLE)
+		{
+			compactBottomLevelAccelerationStructures(queryPool, compactedIndices);
+			vkDestroyQueryPool(m_vulkanDevice->logicalDevice, queryPool, nullptr);
+		}
+
+		saveBottomLevelAccelerationStructures();
+	}
+
+	/*
+		Copy the given bottom level acceleration structures into buffers of their compacted size and release the originals
+		Query i of the pool holds the compacted size of m_bottomLevelAS[blasIndices[i]]
+	*/
+	void RenderpassPathTracer::compactBottomLevelAccelerationStructures(VkQueryPool queryPool, const std::vector<uint32_t>& blasIndices)
+	{
+		const uint32_t blasCount = static_cast<uint32_t>(blasIndices.size());
+		std::vector<VkDeviceSize> compactedSizes(blasCount);
+		VK_CHECK_RESULT(vkGetQueryPoolResults(
+			m_vulkanDevice->logicalDevice,
+			queryPool,
+			0,
+			blasCount,
+			compactedSizes.size() * sizeof(VkDeviceSize),
+			compactedSizes.data(),
+			sizeof(VkDeviceSize),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+		std::vector<AccelerationStructure> originals(blasCount);
+		VkCommandBuffer commandBuffer = m_vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		for (uint32_t i = 0; i < blasCount; i++)
+		{
+			AccelerationStructure& accelerationStructure = m_bottomLevelAS[blasIndices[i]].accelerationStructure;
+			originals[i] = accelerationStructure;
+
+			VkAccelerationStructureBuildSizesInfoKHR compactedSizeInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+			compactedSizeInfo.accelerationStructureSize = compactedSizes[i];
+			accelerationStructure = AccelerationStructure{};
+			createAccelerationStructure(accelerationStructure, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, compactedSizeInfo);
+
+			VkCopyAccelerationStructureInfoKHR copyInfo{};
+			copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+			copyInfo.src = originals[i].handle;
+			copyInfo.dst = accelerationStructure.handle;
+			copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+			vkCmdCopyAccelerationStructureKHR(commandBuffer, &copyInfo);
+		}
+		m_vulkanDevice->flushCommandBuffer(commandBuffer, m_queue);
+
+		for (uint32_t i = 0; i < blasCount; i++)
+		{
+			deleteAccelerationStructure(originals[i]);
+		}
+	}
+
+	namespace
+	{
+		const uint32_t AS_CACHE_MAGIC = 0x53415452; // "RTAS"
+		const uint32_t AS_CACHE_VERSION = 1;
+		// Memory addresses of acceleration structure (de)serialisation have to be 256 byte aligned
+		const VkDeviceSize AS_SERIALIZATION_ALIGNMENT = 256;
+		// Serialised structures start with the driver and compatibility UUIDs, the serialised size, the deserialised size and the handle count
+		const size_t AS_SERIALIZED_HEADER_SIZE = 2 * VK_UUID_SIZE + 3 * sizeof(uint64_t);
+		const size_t AS_DESERIALIZED_SIZE_OFFSET = 2 * VK_UUID_SIZE + sizeof(uint64_t);
+
+		struct AccelerationStructureCacheHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t sceneKey;
+			uint32_t blasCount;
+			uint32_t reserved;
+		};
+
+		// One per bottom level structure, followed by its serialised data
+		struct AccelerationStructureCacheEntry
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			uint32_t buildFlags;
+			uint32_t reserved;
+			uint64_t serializedSize;
+		};
+
+		VkDeviceSize alignSerialization(VkDeviceSize value)
+		{
+			return (value + AS_SERIALIZATION_ALIGNMENT - 1) & ~(AS_SERIALIZATION_ALIGNMENT - 1);
+		}
+	}
+
+	std::string RenderpassPathTracer::getAccelerationStructureCacheFilename()
+	{
+		return m_Scene->filename + ".rtfas";
+	}
+
+	/*
+		Deserialise the bottom level acceleration structures written by an earlier run
+		Fails before creating anything if the cache is missing, belongs to another scene or partition, or the device cannot read it
+	*/
+	bool RenderpassPathTracer::loadBottomLevelAccelerationStructures()
+	{
+		if (!m_cacheBottomLevelAS || m_Scene->cacheKey == 0)
+		{
+			return false;
+		}
+		std::ifstream file(getAccelerationStructureCacheFilename(), std::ios::binary);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		const std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		const uint32_t blasCount = static_cast<uint32_t>(m_bottomLevelAS.size());
+		AccelerationStructureCacheHeader header{};
+		if (contents.size() < sizeof(header))
+		{
+			return false;
+		}
+		memcpy(&header, contents.data(), sizeof(header));
+		if (header.magic != AS_CACHE_MAGIC || header.version != AS_CACHE_VERSION || header.sceneKey != m_Scene->cacheKey || header.blasCount != blasCount)
+		{
+			return false;
+		}
+
+		std::vector<AccelerationStructureCacheEntry> entries(blasCount);
+		std::vector<const char*> serializedData(blasCount);
+		std::vector<VkDeviceSize> stagingOffsets(blasCount);
+		VkDeviceSize stagingSize = 0;
+		size_t offset = sizeof(header);
+		for (uint32_t i = 0; i < blasCount; i++)
+		{
+			AccelerationStructureCacheEntry& entry = entries[i];
+			if (contents.size() - offset < sizeof(entry))
+			{
+				return false;
+			}
+			memcpy(&entry, contents.data() + offset, sizeof(entry));
+			offset += sizeof(entry);
+
+			const BottomLevelInstance& blas = m_bottomLevelAS[i];
+			if (entry.firstIndex != blas.firstIndex || entry.indexCount != blas.indexCount || entry.buildFlags != getBottomLevelBuildFlags(blas)
+				|| entry.serializedSize < AS_SERIALIZED_HEADER_SIZE || contents.size() - offset < entry.serializedSize)
+			{
+				return false;
+			}
+			serializedData[i] = contents.data() + offset;
+			offset += static_cast<size_t>(entry.serializedSize);
+
+			VkAccelerationStructureVersionInfoKHR versionInfo{};
+			versionInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_VERSION_INFO_KHR;
+			versionInfo.pVersionData = reinterpret_cast<const uint8_t*>(serializedData[i]);
+			VkAccelerationStructureCompatibilityKHR compatibility = VK_ACCELERATION_STRUCTURE_COMPATIBILITY_INCOMPATIBLE_KHR;
+			vkGetDeviceAccelerationStructureCompatibilityKHR(m_vulkanDevice->logicalDevice, &versionInfo, &compatibility);
+			if (compatibility != VK_ACCELERATION_STRUCTURE_COMPATIBILITY_COMPATIBLE_KHR)
+			{
+				std::cout << "BLAS cache: written by an incompatible device or driver, rebuilding" << std::endl;
+				return false;
+			}
+
+			stagingOffsets[i] = stagingSize;
+			stagingSize = alignSerialization(stagingSize + entry.serializedSize);
+		}
+
+		// Over allocated, so the copy sources can be aligned independent of the buffer's address
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(m_vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			stagingSize + AS_SERIALIZATION_ALIGNMENT));
+		VK_CHECK_RESULT(stagingBuffer.map());
+		const uint64_t stagingBufferAddress = getBufferDeviceAddress(stagingBuffer.buffer);
+		const VkDeviceSize alignmentOffset = alignSerialization(stagingBufferAddress) - stagingBufferAddress;
+
+		VkCommandBuffer commandBuffer = m_vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		for (uint32_t i = 0; i < blasCount; i++)
+		{
+			memcpy(static_cast<char*>(stagingBuffer.mapped) + alignmentOffset + stagingOffsets[i], serializedData[i], static_cast<size_t>(entries[i].serializedSize));
+
+			uint64_t deserializedSize = 0;
+			memcpy(&deserializedSize, serializedData[i] + AS_DESERIALIZED_SIZE_OFFSET, sizeof(deserializedSize));
+			VkAccelerationStructureBuildSizesInfoKHR sizeInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+			sizeInfo.accelerationStructureSize = deserializedSize;
+			createAccelerationStructure(m_bottomLevelAS[i].accelerationStructure, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sizeInfo);
+
+			VkCopyMemoryToAccelerationStructureInfoKHR copyInfo{};
+			copyInfo.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_INFO_KHR;
+			copyInfo.src.deviceAddress = stagingBufferAddress + alignmentOffset + stagingOffsets[i];
+			copyInfo.dst = m_bottomLevelAS[i].accelerationStructure.handle;
+			copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_DESERIALIZE_KHR;
+			vkCmdCopyMemoryToAccelerationStructureKHR(commandBuffer, &copyInfo);
+		}
+		m_vulkanDevice->flushCommandBuffer(commandBuffer, m_queue);
+		stagingBuffer.destroy();
+
+		// Skinned structures still need scratch memory for their per frame refit
+		const VkAccelerationStructureGeometryKHR accelerationStructureGeometry = getBottomLevelGeometry();
+		VkDeviceSize maxUpdateScratchSize = 0;
+		for (const BottomLevelInstance& blas : m_bottomLevelAS)
+		{
+			if (!blas.skinned)
+			{
+				continue;
+			}
+			VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+			accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+			accelerationBuildGeometryInfo.flags = getBottomLevelBuildFlags(blas);
+			accelerationBuildGeometryInfo.geometryCount = 1;
+			accelerationBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
+			const uint32_t numTriangles = blas.indexCount / 3;
+			VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+			vkGetAccelerationStructureBuildSizesKHR(
+				m_vulkanDevice->logicalDevice,
+				VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
 				&accelerationBuildGeometryInfo,
-				accelerationBuildStructureRangeInfos.data());
-			m_vulkanDevice->flushCommandBuffer(commandBuffer, m_queue);
+				&numTriangles,
+				&accelerationStructureBuildSizesInfo);
+			maxUpdateScratchSize = std::max(maxUpdateScratchSize, accelerationStructureBuildSizesInfo.updateScratchSize);
+		}
+		m_skinnedBottomLevelAS = maxUpdateScratchSize > 0;
+		if (m_skinnedBottomLevelAS)
+		{
+			m_bottomLevelScratchBuffer = createScratchBuffer(maxUpdateScratchSize);
 		}
 
-		deleteScratchBuffer(scratchBuffer);
+		return true;
+	}
+
+	/*
+		Serialise the freshly built (and compacted) bottom level acceleration structures for the next run
+		Failing to write the cache only costs the next start-up
+	*/
+	void RenderpassPathTracer::saveBottomLevelAccelerationStructures()
+	{
+		if (!m_cacheBottomLevelAS || m_Scene->cacheKey == 0)
+		{
+			return;
+		}
+		const uint32_t blasCount = static_cast<uint32_t>(m_bottomLevelAS.size());
+		std::vector<VkAccelerationStructureKHR> handles(blasCount);
+		for (uint32_t i = 0; i < blasCount; i++)
+		{
+			handles[i] = m_bottomLevelAS[i].accelerationStructure.handle;
+		}
+
+		VkQueryPoolCreateInfo queryPoolCreateInfo{};
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR;
+		queryPoolCreateInfo.queryCount = blasCount;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		VK_CHECK_RESULT(vkCreateQueryPool(m_vulkanDevice->logicalDevice, &queryPoolCreateInfo, nullptr, &queryPool));
+
+		VkCommandBuffer commandBuffer = m_vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vkCmdResetQueryPool(commandBuffer, queryPool, 0, blasCount);
+		vkCmdWriteAccelerationStructuresPropertiesKHR(commandBuffer, blasCount, handles.data(), VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR, queryPool, 0);
+		m_vulkanDevice->flushCommandBuffer(commandBuffer, m_queue);
+
+		std::vector<VkDeviceSize> serializedSizes(blasCount);
+		VK_CHECK_RESULT(vkGetQueryPoolResults(
+			m_vulkanDevice->logicalDevice,
+			queryPool,
+			0,
+			blasCount,
+			serializedSizes.size() * sizeof(VkDeviceSize),
+			serializedSizes.data(),
+			sizeof(VkDeviceSize),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+		vkDestroyQueryPool(m_vulkanDevice->logicalDevice, queryPool, nullptr);
+
+		std::vector<VkDeviceSize> readbackOffsets(blasCount);
+		VkDeviceSize readbackSize = 0;
+		for (uint32_t i = 0; i < blasCount; i++)
+		{
+			readbackOffsets[i] = readbackSize;
+			readbackSize = alignSerialization(readbackSize + serializedSizes[i]);
+		}
+
+		vks::Buffer readbackBuffer;
+		VK_CHECK_RESULT(m_vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&readbackBuffer,
+			readbackSize + AS_SERIALIZATION_ALIGNMENT));
+		const uint64_t readbackBufferAddress = getBufferDeviceAddress(readbackBuffer.buffer);
+		const VkDeviceSize alignmentOffset = alignSerialization(readbackBufferAddress) - readbackBufferAddress;
+
+		commandBuffer = m_vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		for (uint32_t i = 0; i < blasCount; i++)
+		{
+			VkCopyAccelerationStructureToMemoryInfoKHR copyInfo{};
+			copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_INFO_KHR;
+			copyInfo.src = handles[i];
+			copyInfo.dst.deviceAddress = readbackBufferAddress + alignmentOffset + readbackOffsets[i];
+			copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_SERIALIZE_KHR;
+			vkCmdCopyAccelerationStructureToMemoryKHR(commandBuffer, &copyInfo);
+		}
+		m_vulkanDevice->flushCommandBuffer(commandBuffer, m_queue);
+		VK_CHECK_RESULT(readbackBuffer.map());
+
+		// Written under a temporary name, so an interrupted write never leaves a truncated cache behind
+		const std::string filename = getAccelerationStructureCacheFilename();
+		const std::string tempFilename = filename + ".tmp";
+		bool written = false;
+		{
+			std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+			if (file.is_open())
+			{
+				AccelerationStructureCacheHeader header{};
+				header.magic = AS_CACHE_MAGIC;
+				header.version = AS_CACHE_VERSION;
+				header.sceneKey = m_Scene->cacheKey;
+				header.blasCount = blasCount;
+				file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+				for (uint32_t i = 0; i < blasCount; i++)
+				{
+					const BottomLevelInstance& blas = m_bottomLevelAS[i];
+					AccelerationStructureCacheEntry entry{};
+					entry.firstIndex = blas.firstIndex;
+					entry.indexCount = blas.indexCount;
+					entry.buildFlags = getBottomLevelBuildFlags(blas);
+					entry.serializedSize = serializedSizes[i];
+					file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+					file.write(static_cast<const char*>(readbackBuffer.mapped) + alignmentOffset + readbackOffsets[i], static_cast<std::streamsize>(serializedSizes[i]));
+				}
+				written = file.good();
+			}
+		}
+		readbackBuffer.destroy();
+
+		if (written)
+		{
+			std::remove(filename.c_str());
+		}
+		if (!written || std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+		{
+			std::remove(tempFilename.c_str());
+			std::cerr << "Could not write acceleration structure cache \"" << filename << "\"" << std::endl;
+		}
 	}
 
 	RenderpassPathTracer::ScratchBuffer RenderpassPathTracer::createScratchBuffer(VkDeviceSize size)
@@ -464,85 +1105,59 @@ namespace rtf
 	}
 
 	/*
-	The top level acceleration structure contains the scene's object instances
-*/
+		The top level acceleration structure contains one instance per mesh node
+		It is built with ALLOW_UPDATE, so animated scenes can refit it every frame instead of rebuilding
+	*/
 	void RenderpassPathTracer::createTopLevelAccelerationStructure()
 	{
-		VkTransformMatrixKHR transformMatrix = {
-			1.0f, 0.0f, 0.0f, 0.0f,
-			0.0f, 1.0f, 0.0f, 0.0f,
-			0.0f, 0.0f, 1.0f, 0.0f };
-
-		VkAccelerationStructureInstanceKHR instance{};
-		instance.transform = transformMatrix;
-		instance.instanceCustomIndex = 0;
-		instance.mask = 0xFF;
-		instance.instanceShaderBindingTableRecordOffset = 0;
-		instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-		instance.accelerationStructureReference = m_bottomLevelAS.deviceAddress;
-
-		// Buffer for instance data
-		vks::Buffer instancesBuffer;
+		const uint32_t instanceCount = static_cast<uint32_t>(m_bottomLevelAS.size());
+
+		// Buffer for instance data, kept mapped for per frame transform updates
 		VK_CHECK_RESULT(m_vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&instancesBuffer,
-			sizeof(VkAccelerationStructureInstanceKHR),
-			&instance));
+			&m_instancesBuffer,
+			sizeof(VkAccelerationStructureInstanceKHR) * instanceCount));
+		VK_CHECK_RESULT(m_instancesBuffer.map());
+		updateInstances();
 
-		VkDeviceOrHostAddressConstKHR instanceDataDeviceAddress{};
-		instanceDataDeviceAddress.deviceAddress = getBufferDeviceAddress(instancesBuffer.buffer);
-
-		VkAccelerationStructureGeometryKHR accelerationStructureGeometry = vks::initializers::accelerationStructureGeometryKHR();
-		accelerationStructureGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
-		accelerationStructureGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
-		accelerationStructureGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
-		accelerationStructureGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
-		accelerationStructureGeometry.geometry.instances.data = instanceDataDeviceAddress;
+		VkAccelerationStructureGeometryKHR accelerationStructureGeometry = getTopLevelGeometry();
 
 		// Get size info
 		VkAccelerationStructureBuildGeometryInfoKHR accelerationStructureBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
 		accelerationStructureBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-		accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+		accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
 		accelerationStructureBuildGeometryInfo.geometryCount = 1;
 		accelerationStructureBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
 
-		uint32_t primitive_count = 1;
-
 		VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
 		vkGetAccelerationStructureBuildSizesKHR(
 			m_vulkanDevice->logicalDevice,
 			VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
 			&accelerationStructureBuildGeometryInfo,
-			&primitive_count,
+			&instanceCount,
 			&accelerationStructureBuildSizesInfo);
 
-		// @todo: as return value?
-
 		createAccelerationStructure(m_topLevelAS, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, accelerationStructureBuildSizesInfo);
 
-		// Create a small scratch buffer used during build of the top level acceleration structure
-		ScratchBuffer scratchBuffer = createScratchBuffer(accelerationStructureBuildSizesInfo.buildScratchSize);
-
-		VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
-		accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-		accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-		accelerationBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-		accelerationBuildGeometryInfo.dstAccelerationStructure = m_topLevelAS.handle;
-		accelerationBuildGeometryInfo.geometryCount = 1;
-		accelerationBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
-		accelerationBuildGeometryInfo.scratchData.deviceAddress = scratchBuffer.deviceAddress;
-
-		VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
-		accelerationStructureBuildRangeInfo.primitiveCount = 1;
-		accelerationStructureBuildRangeInfo.primitiveOffset = 0;
-		accelerationStructureBuildRangeInfo.firstVertex = 0;
-		accelerationStructureBuildRangeInfo.transformOffset = 0;
-		std::vector<VkAccelerationStructureBuildRangeInfoKHR*> accelerationBuildStructureRangeInfos = { &accelerationStructureBuildRangeInfo };
+		// The scratch buffer is kept alive for the per frame updates, so it has to fit both the build and the update
+		m_scratchBuffer = createScratchBuffer(std::max(accelerationStructureBuildSizesInfo.buildScratchSize, accelerationStructureBuildSizesInfo.updateScratchSize));
 
 		if (m_rtFilterDemo->accelerationStructureFeatures.accelerationStructureHostCommands)
 		{
-			// Implementation supports building acceleration structure building on host
+			VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+			accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+			accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+			accelerationBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+			accelerationBuildGeometryInfo.dstAccelerationStructure = m_topLevelAS.handle;
+			accelerationBuildGeometryInfo.geometryCount = 1;
+			accelerationBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
+			accelerationBuildGeometryInfo.scratchData.deviceAddress = m_scratchBuffer.deviceAddress;
+
+			VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
+			accelerationStructureBuildRangeInfo.primitiveCount = instanceCount;
+			std::vector<VkAccelerationStructureBuildRangeInfoKHR*> accelerationBuildStructureRangeInfos = { &accelerationStructureBuildRangeInfo };
+
 			// Implementation supports building acceleration structure building on host
 			vkBuildAccelerationStructuresKHR(
 				m_vulkanDevice->logicalDevice,
@@ -555,16 +1170,187 @@ namespace rtf
 		{
 			// Acceleration structure needs to be build on the device
 			VkCommandBuffer commandBuffer = m_vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			buildTopLevelAccelerationStructure(commandBuffer, VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR);
+			m_vulkanDevice->flushCommandBuffer(commandBuffer, m_queue);
+		}
+
+		// Only scenes with animations or skinned meshes need the per frame refit
+		m_dynamicTopLevelAS = !m_Scene->animations.empty() || m_skinnedBottomLevelAS;
+	}
+
+	VkAccelerationStructureGeometryKHR RenderpassPathTracer::getBottomLevelGeometry()
+	{
+		VkDeviceOrHostAddressConstKHR vertexBufferDeviceAddress{};
+		VkDeviceOrHostAddressConstKHR indexBufferDeviceAddress{};
+		vertexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(getSceneVertexBuffer());
+		indexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(m_Scene->indices.buffer);
+
+		VkAccelerationStructureGeometryKHR accelerationStructureGeometry = vks::initializers::accelerationStructureGeometryKHR();
+		accelerationStructureGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+		accelerationStructureGeometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+		accelerationStructureGeometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+		accelerationStructureGeometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+		accelerationStructureGeometry.geometry.triangles.vertexData = vertexBufferDeviceAddress;
+		accelerationStructureGeometry.geometry.triangles.maxVertex = m_Scene->vertices.count;
+		accelerationStructureGeometry.geometry.triangles.vertexStride = sizeof(vkglTF::Vertex);
+		accelerationStructureGeometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+		accelerationStructureGeometry.geometry.triangles.indexData = indexBufferDeviceAddress;
+		accelerationStructureGeometry.geometry.triangles.transformData.deviceAddress = 0;
+		accelerationStructureGeometry.geometry.triangles.transformData.hostAddress = nullptr;
+		return accelerationStructureGeometry;
+	}
+
+	VkBuildAccelerationStructureFlagsKHR RenderpassPathTracer::getBottomLevelBuildFlags(const BottomLevelInstance& blas)
+	{
+		if (blas.skinned)
+		{
+			return VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+		}
+		if (m_compactBottomLevelAS)
+		{
+			return VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+		}
+		return VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+	}
+
+	/*
+		Refit the skinned bottom level acceleration structures to the vertices written by the skinning pass
+		The topology does not change, so an in place update is sufficient
+	*/
+	void RenderpassPathTracer::updateBottomLevelAccelerationStructures(VkCommandBuffer commandBuffer)
+	{
+		const VkAccelerationStructureGeometryKHR accelerationStructureGeometry = getBottomLevelGeometry();
+
+		// The refits share one scratch buffer, and the top level update reads their results
+		VkMemoryBarrier buildBarrier = vks::initializers::memoryBarrier();
+		buildBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		buildBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+
+		for (const BottomLevelInstance& blas : m_bottomLevelAS)
+		{
+			if (!blas.skinned)
+			{
+				continue;
+			}
+			VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+			accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+			accelerationBuildGeometryInfo.flags = getBottomLevelBuildFlags(blas);
+			accelerationBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+			accelerationBuildGeometryInfo.srcAccelerationStructure = blas.accelerationStructure.handle;
+			accelerationBuildGeometryInfo.dstAccelerationStructure = blas.accelerationStructure.handle;
+			accelerationBuildGeometryInfo.geometryCount = 1;
+			accelerationBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
+			accelerationBuildGeometryInfo.scratchData.deviceAddress = m_bottomLevelScratchBuffer.deviceAddress;
+
+			VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
+			accelerationStructureBuildRangeInfo.primitiveCount = blas.indexCount / 3;
+			accelerationStructureBuildRangeInfo.primitiveOffset = blas.firstIndex * sizeof(uint32_t);
+			const VkAccelerationStructureBuildRangeInfoKHR* accelerationBuildStructureRangeInfo = &accelerationStructureBuildRangeInfo;
+
 			vkCmdBuildAccelerationStructuresKHR(
 				commandBuffer,
 				1,
 				&accelerationBuildGeometryInfo,
-				accelerationBuildStructureRangeInfos.data());
-			m_vulkanDevice->flushCommandBuffer(commandBuffer, m_queue);
+				&accelerationBuildStructureRangeInfo);
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+				VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+				0, 1, &buildBarrier, 0, nullptr, 0, nullptr);
 		}
+	}
 
-		deleteScratchBuffer(scratchBuffer);
-		instancesBuffer.destroy();
+	VkAccelerationStructureGeometryKHR RenderpassPathTracer::getTopLevelGeometry()
+	{
+		VkDeviceOrHostAddressConstKHR instanceDataDeviceAddress{};
+		instanceDataDeviceAddress.deviceAddress = getBufferDeviceAddress(m_instancesBuffer.buffer);
+
+		VkAccelerationStructureGeometryKHR accelerationStructureGeometry = vks::initializers::accelerationStructureGeometryKHR();
+		accelerationStructureGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+		accelerationStructureGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+		accelerationStructureGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+		accelerationStructureGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
+		accelerationStructureGeometry.geometry.instances.data = instanceDataDeviceAddress;
+		return accelerationStructureGeometry;
+	}
+
+	/*
+		Write the current node transforms into the mapped instance buffer
+	*/
+	void RenderpassPathTracer::updateInstances()
+	{
+		VkAccelerationStructureInstanceKHR* instances = static_cast<VkAccelerationStructureInstanceKHR*>(m_instancesBuffer.mapped);
+		for (size_t i = 0; i < m_bottomLevelAS.size(); i++)
+		{
+			const BottomLevelInstance& blas = m_bottomLevelAS[i];
+			// VkTransformMatrixKHR is a row major 3x4 matrix, glm is column major
+			// Skinned vertices are already transformed by the skinning pass
+			glm::mat4 transform = blas.skinned ? glm::mat4(1.0f) : glm::transpose(m_Scene->getNodeInstanceMatrix(blas.node));
+
+			VkAccelerationStructureInstanceKHR instance{};
+			memcpy(&instance.transform, &transform, sizeof(VkTransformMatrixKHR));
+			// The hit shader offsets gl_PrimitiveID by this to index into the scene index buffer
+			// instanceCustomIndex only has 24 bits
+			if (blas.firstIndex / 3 >= (1u << 24))
+			{
+				throw std::runtime_error("RenderpassPathTracer::updateInstances: Scene index buffer exceeds the 24 bit instance custom index");
+			}
+			instance.instanceCustomIndex = blas.firstIndex / 3;
+			instance.mask = 0xFF;
+			instance.instanceShaderBindingTableRecordOffset = 0;
+			instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+			instance.accelerationStructureReference = blas.accelerationStructure.deviceAddress;
+			instances[i] = instance;
+		}
+	}
+
+	/*
+		Record a build (or in place update) of the top level acceleration structure from the instance buffer
+	*/
+	void RenderpassPathTracer::buildTopLevelAccelerationStructure(VkCommandBuffer commandBuffer, VkBuildAccelerationStructureModeKHR mode)
+	{
+		VkAccelerationStructureGeometryKHR accelerationStructureGeometry = getTopLevelGeometry();
+
+		VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+		accelerationBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+		accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+		accelerationBuildGeometryInfo.mode = mode;
+		accelerationBuildGeometryInfo.srcAccelerationStructure = (mode == VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR) ? m_topLevelAS.handle : VK_NULL_HANDLE;
+		accelerationBuildGeometryInfo.dstAccelerationStructure = m_topLevelAS.handle;
+		accelerationBuildGeometryInfo.geometryCount = 1;
+		accelerationBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
+		accelerationBuildGeometryInfo.scratchData.deviceAddress = m_scratchBuffer.deviceAddress;
+
+		VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
+		accelerationStructureBuildRangeInfo.primitiveCount = static_cast<uint32_t>(m_bottomLevelAS.size());
+		accelerationStructureBuildRangeInfo.primitiveOffset = 0;
+		accelerationStructureBuildRangeInfo.firstVertex = 0;
+		accelerationStructureBuildRangeInfo.transformOffset = 0;
+		std::vector<VkAccelerationStructureBuildRangeInfoKHR*> accelerationBuildStructureRangeInfos = { &accelerationStructureBuildRangeInfo };
+
+		vkCmdBuildAccelerationStructuresKHR(
+			commandBuffer,
+			1,
+			&accelerationBuildGeometryInfo,
+			accelerationBuildStructureRangeInfos.data());
+	}
+
+	/*
+		Refit the top level acceleration structure to the current node transforms and make the result visible to the tracing stage
+	*/
+	void RenderpassPathTracer::updateTopLevelAccelerationStructure(VkCommandBuffer commandBuffer)
+	{
+		updateInstances();
+		buildTopLevelAccelerationStructure(commandBuffer, VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR);
+
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+			m_rtFilterDemo->m_useRayQueryPathTracer ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+			0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 	}
 
 	void RenderpassPathTracer::createAccelerationStructure(AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo)
@@ -602,16 +1388,12 @@ namespace rtf
 	}
 
 	/*
-		If the window has been resized, we need to recreate the storage image and it's descriptor
+		If the window has been resized, the attachments were recreated and the descriptors have to point to the new images
+		The command buffer is recorded every frame, acceleration structures and the pipeline are independent of the size
 	*/
-	void RenderpassPathTracer::handleResize(uint32_t width, uint32_t height)
+	void RenderpassPathTracer::onAttachmentsChanged()
 	{
-		// Recreate image
-		//createStorageImage(m_swapChain->colorFormat, { width, height, 1 });
-		// Update descriptor
-		VkDescriptorImageInfo storageImageDescriptor{ VK_NULL_HANDLE, m_Rtoutput->view, VK_IMAGE_LAYOUT_GENERAL };
-		VkWriteDescriptorSet resultImageWrite = vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_IMAGE, &storageImageDescriptor);
-		vkUpdateDescriptorSets(m_vulkanDevice->logicalDevice, 1, &resultImageWrite, 0, VK_NULL_HANDLE);
+		writeAttachmentDescriptors();
 	}
 
 	void RenderpassPathTracer::buildCommandBuffer()
@@ -626,6 +1408,15 @@ namespace rtf
 		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
 		vkBeginCommandBuffer(m_commandBuffer, &commandBufferBeginInfo);
 
+		if (m_skinnedBottomLevelAS)
+		{
+			updateBottomLevelAccelerationStructures(m_commandBuffer);
+		}
+		if (m_dynamicTopLevelAS)
+		{
+			updateTopLevelAccelerationStructure(m_commandBuffer);
+		}
+
 		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 		vks::tools::setImageLayout(
 			m_commandBuffer,
@@ -634,23 +1425,29 @@ namespace rtf
 			VK_IMAGE_LAYOUT_GENERAL,
 			subresourceRange);
 
-		vkCmdBindPipeline(m_commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_pipeline);
-		vkCmdBindDescriptorSets(m_commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, 0);
+		recordTrace(m_commandBuffer);
+
+		vkEndCommandBuffer(m_commandBuffer);
+	}
+
+	void RenderpassPathTracer::recordTrace(VkCommandBuffer commandBuffer)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, 0);
 
 		//upload the matrix to the GPU via pushconstants
-		vkCmdPushConstants(m_commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(SPC_PathtracerConfig), &m_pathtracerconfig);
+		vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(SPC_PathtracerConfig), &m_pathtracerconfig);
 
 		VkStridedDeviceAddressRegionKHR emptySbtEntry = {};
 		vkCmdTraceRaysKHR(
-			m_commandBuffer,
+			commandBuffer,
 			&m_shaderBindingTables.raygen.stridedDeviceAddressRegion,
 			&m_shaderBindingTables.miss.stridedDeviceAddressRegion,
 			&m_shaderBindingTables.hit.stridedDeviceAddressRegion,
 			&emptySbtEntry,
-			m_rtFilterDemo->width,
-			m_rtFilterDemo->height,
+			m_pathtracerconfig.RenderWidth,
+			m_pathtracerconfig.RenderHeight,
 			1);
-		vkEndCommandBuffer(m_commandBuffer);
 	}
 
 
@@ -662,6 +1459,12 @@ namespace rtf
 		return vkGetBufferDeviceAddress(m_vulkanDevice->logicalDevice, &bufferDeviceAI);
 	}
 
+	VkBuffer RenderpassPathTracer::getSceneVertexBuffer()
+	{
+		// Current pose of the scene, skinned if the scene contains skins
+		return m_rtFilterDemo->m_renderpassManager->m_RP_Skinning->getVertexBuffer();
+	}
+
 	void RenderpassPathTracer::createStorageImage(VkFormat format, VkExtent3D extent)
 	{
 		// Release ressources if image is to be recreated
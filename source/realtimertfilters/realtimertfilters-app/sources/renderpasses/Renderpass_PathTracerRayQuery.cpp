@@ -0,0 +1,32 @@
+#include "../../headers/renderpasses/Renderpass_PathTracerRayQuery.hpp"
+#include "../../headers/RTFilterDemo.hpp"
+
+namespace rtf
+{
+	void RenderpassPathTracerRayQuery::createRayTracingPipeline()
+	{
+		createPipelineLayout(VK_SHADER_STAGE_COMPUTE_BIT, VK_SHADER_STAGE_COMPUTE_BIT, VK_SHADER_STAGE_COMPUTE_BIT);
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(m_pipelineLayout, 0);
+		computePipelineCreateInfo.stage = m_rtFilterDemo->LoadShader("pathTracerShader/raytrace_rayquery.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(m_vulkanDevice->logicalDevice, nullptr, 1, &computePipelineCreateInfo, nullptr, &m_pipeline));
+	}
+
+	void RenderpassPathTracerRayQuery::createShaderBindingTables()
+	{
+		// Rays are traced inline, there are no shader groups to bind
+	}
+
+	void RenderpassPathTracerRayQuery::recordTrace(VkCommandBuffer commandBuffer)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, 0);
+
+		vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(SPC_PathtracerConfig), &m_pathtracerconfig);
+
+		// Matches the 8x8 work group size of raytrace_rayquery.comp
+		const uint32_t groupCountX = (m_pathtracerconfig.RenderWidth + 7) / 8;
+		const uint32_t groupCountY = (m_pathtracerconfig.RenderHeight + 7) / 8;
+		vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+	}
+}
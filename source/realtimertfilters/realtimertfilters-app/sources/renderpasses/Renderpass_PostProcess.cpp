@@ -279,6 +279,9 @@ namespace rtf
 			m_CmdBuffer = m_vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
 		}
 
+		VkExtent2D size = getRenderSize();
+		m_RecordedSize = size;
+
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 		VK_CHECK_RESULT(vkBeginCommandBuffer(m_CmdBuffer, &cmdBufInfo));
 
@@ -298,8 +301,8 @@ namespace rtf
 		renderPassBeginInfo.renderPass = m_renderpass;
 		renderPassBeginInfo.renderArea.offset.x = 0;
 		renderPassBeginInfo.renderArea.offset.y = 0;
-		renderPassBeginInfo.renderArea.extent.width = m_rtFilterDemo->width;
-		renderPassBeginInfo.renderArea.extent.height = m_rtFilterDemo->height;
+		renderPassBeginInfo.renderArea.extent.width = size.width;
+		renderPassBeginInfo.renderArea.extent.height = size.height;
 		renderPassBeginInfo.clearValueCount = 0;
 		renderPassBeginInfo.pClearValues = clearValues;
 
@@ -308,10 +311,10 @@ namespace rtf
 
 		vkCmdBeginRenderPass(m_CmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-		VkViewport viewport = vks::initializers::viewport((float)m_rtFilterDemo->width, (float)m_rtFilterDemo->height, 0.0f, 1.0f);
+		VkViewport viewport = vks::initializers::viewport((float)size.width, (float)size.height, 0.0f, 1.0f);
 		vkCmdSetViewport(m_CmdBuffer, 0, 1, &viewport);
 
-		VkRect2D scissor = vks::initializers::rect2D(m_rtFilterDemo->width, m_rtFilterDemo->height, 0, 0);
+		VkRect2D scissor = vks::initializers::rect2D(size.width, size.height, 0, 0);
 		vkCmdSetScissor(m_CmdBuffer, 0, 1, &scissor);
 
 		uint32_t descriptorSetCount = (getUboCount() > 0) ? 2U : 1U;
@@ -319,7 +322,7 @@ namespace rtf
 
 		vkCmdBindPipeline(m_CmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
 
-		m_PushConstants = PushConstantsContainer{ m_rtFilterDemo->width, m_rtFilterDemo->height };
+		m_PushConstants = PushConstantsContainer{ size.width, size.height, m_HistoryReset ? 1U : 0U };
 		vkCmdPushConstants(m_CmdBuffer, m_pipelineLayout, VkShaderStageFlagBits::VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantsContainer), &m_PushConstants);
 
 		// Final composition as full screen quad
@@ -363,7 +366,7 @@ namespace rtf
 			copyRegion.srcOffset = { 0, 0, 0 };
 			copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
 			copyRegion.dstOffset = { 0, 0, 0 };
-			copyRegion.extent = { m_rtFilterDemo->width, m_rtFilterDemo->height, 1 };
+			copyRegion.extent = { size.width, size.height, 1 };
 			vkCmdCopyImage(m_CmdBuffer, sourceImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, destinationImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
 
 			// Transition destination image back to layout general
@@ -391,12 +394,47 @@ namespace rtf
 #pragma endregion
 #pragma region draw
 
+	VkExtent2D RenderpassPostProcess::getRenderSize() const
+	{
+		return m_OutputResolution ? m_attachmentManager->GetSize() : m_attachmentManager->GetRenderSize();
+	}
+
 	void RenderpassPostProcess::draw(const VkCommandBuffer*& out_commandBuffers, uint32_t& out_commandBufferCount)
 	{
+		// Dynamic resolution changed the render size. Reprojected history covers the old size, so the temporal passes
+		// drop it for one frame. Output resolution passes keep their size but still re-record for the flag
+		const VkExtent2D renderSize = m_attachmentManager->GetRenderSize();
+		const bool historyReset = renderSize.width != m_LastRenderSize.width || renderSize.height != m_LastRenderSize.height;
+		m_LastRenderSize = renderSize;
+		VkExtent2D size = getRenderSize();
+		if (size.width != m_RecordedSize.width || size.height != m_RecordedSize.height || historyReset != m_HistoryReset)
+		{
+			m_HistoryReset = historyReset;
+			buildCommandBuffer();
+		}
 		out_commandBufferCount = 1;
 		out_commandBuffers = &m_CmdBuffer;
 	}
 
+	void RenderpassPostProcess::onAttachmentsChanged()
+	{
+		// Own image views (e.g. depth only aspects) reference the old images
+		for (auto& textureBinding : m_TextureBindings)
+		{
+			textureBinding.destroyImageview(m_vulkanDevice);
+		}
+		preprocessTextureBindings();
+
+		vkDestroyFramebuffer(m_vulkanDevice->logicalDevice, m_Framebuffer, nullptr);
+		setupFramebuffer();
+
+		// The UBO set is unaffected
+		TextureBinding::UpdateDescriptorSet(getLogicalDevice(), m_TextureBindings.data(), getAttachmentCount(),
+			m_descriptorSets[DESCRIPTORSET_IMAGES], Statics->m_ColorSampler_Normalized);
+
+		buildCommandBuffer();
+	}
+
 #pragma endregion
 #pragma region cleanup
 
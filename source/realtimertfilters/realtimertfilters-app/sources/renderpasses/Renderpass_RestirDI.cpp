@@ -0,0 +1,217 @@
+#include "../../headers/renderpasses/Renderpass_RestirDI.hpp"
+#include "../../headers/renderpasses/Renderpass_PathTracer.hpp"
+#include "../../headers/renderpasses/RenderpassManager.hpp"
+#include "../../headers/RTFilterDemo.hpp"
+#include "../../data/shaders/glsl/restir/binding.glsl"
+
+namespace rtf
+{
+	void RenderpassRestirDI::prepare()
+	{
+		m_Direct = m_attachmentManager->getAttachment(Attachment::rtdirect);
+		m_Size = m_attachmentManager->GetSize();
+
+		createReservoirBuffers();
+		setupDescriptors();
+		preparePipelines();
+	}
+
+	void RenderpassRestirDI::onAttachmentsChanged()
+	{
+		// Reservoirs are per pixel, history is lost anyway as the G-buffer is recreated too
+		m_Size = m_attachmentManager->GetSize();
+		m_Reservoirs.destroy();
+		m_TemporalReservoirs.destroy();
+		createReservoirBuffers();
+		writeDescriptorSet();
+	}
+
+	void RenderpassRestirDI::createReservoirBuffers()
+	{
+		const VkDeviceSize reservoirBufferSize = static_cast<VkDeviceSize>(m_Size.width) * m_Size.height * sizeof(S_Reservoir);
+		VK_CHECK_RESULT(m_vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&m_Reservoirs,
+			reservoirBufferSize));
+		VK_CHECK_RESULT(m_vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&m_TemporalReservoirs,
+			reservoirBufferSize));
+
+		// Empty reservoirs (M = 0) are never reused, the first frame clears them
+		m_ReservoirSize = {};
+	}
+
+	void RenderpassRestirDI::setupDescriptors()
+	{
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, VK_SHADER_STAGE_COMPUTE_BIT, B_RESTIR_ACCELERATIONSTRUCTURE),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, B_RESTIR_LIGHTS),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, B_RESTIR_POSITION),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, B_RESTIR_NORMAL),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, B_RESTIR_MOTION),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, B_RESTIR_RESERVOIRS),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, B_RESTIR_TEMPORALRESERVOIRS),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, B_RESTIR_DIRECT),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, B_RESTIR_ALBEDO),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, B_RESTIR_OUTPUT),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(getLogicalDevice(), &descriptorLayout, nullptr, &m_descriptorSetLayout));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 6),
+		};
+		VkDescriptorPoolCreateInfo poolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(getLogicalDevice(), &poolCI, nullptr, &m_descriptorPool));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &m_descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(getLogicalDevice(), &allocInfo, &m_descriptorSet));
+
+		writeDescriptorSet();
+	}
+
+	void RenderpassRestirDI::writeDescriptorSet()
+	{
+		// Scene resources are owned by the path tracer
+		const std::shared_ptr<RenderpassPathTracer>& pathTracer = m_rtFilterDemo->m_renderpassManager->m_RP_PT;
+		VkAccelerationStructureKHR topLevelAS = pathTracer->getTopLevelAccelerationStructure();
+		VkWriteDescriptorSetAccelerationStructureKHR descriptorAccelerationStructureInfo = vks::initializers::writeDescriptorSetAccelerationStructureKHR();
+		descriptorAccelerationStructureInfo.accelerationStructureCount = 1;
+		descriptorAccelerationStructureInfo.pAccelerationStructures = &topLevelAS;
+
+		VkWriteDescriptorSet accelerationStructureWrite{};
+		accelerationStructureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		accelerationStructureWrite.pNext = &descriptorAccelerationStructureInfo;
+		accelerationStructureWrite.dstSet = m_descriptorSet;
+		accelerationStructureWrite.dstBinding = B_RESTIR_ACCELERATIONSTRUCTURE;
+		accelerationStructureWrite.descriptorCount = 1;
+		accelerationStructureWrite.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+
+		VkDescriptorBufferInfo lightsDescriptor{ pathTracer->getLightBuffer(), 0, VK_WHOLE_SIZE };
+		VkDescriptorImageInfo positionDescriptor{ VK_NULL_HANDLE, m_attachmentManager->getAttachment(Attachment::position)->view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo normalDescriptor{ VK_NULL_HANDLE, m_attachmentManager->getAttachment(Attachment::normal)->view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo motionDescriptor{ VK_NULL_HANDLE, m_attachmentManager->getAttachment(Attachment::motionvector)->view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorBufferInfo reservoirsDescriptor{ m_Reservoirs.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo temporalReservoirsDescriptor{ m_TemporalReservoirs.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorImageInfo directDescriptor{ VK_NULL_HANDLE, m_Direct->view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo albedoDescriptor{ VK_NULL_HANDLE, m_attachmentManager->getAttachment(Attachment::albedo)->view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo outputDescriptor{ VK_NULL_HANDLE, m_attachmentManager->getAttachment(Attachment::rtoutput)->view, VK_IMAGE_LAYOUT_GENERAL };
+
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			accelerationStructureWrite,
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, B_RESTIR_LIGHTS, &lightsDescriptor),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_RESTIR_POSITION, &positionDescriptor),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_RESTIR_NORMAL, &normalDescriptor),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_RESTIR_MOTION, &motionDescriptor),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, B_RESTIR_RESERVOIRS, &reservoirsDescriptor),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, B_RESTIR_TEMPORALRESERVOIRS, &temporalReservoirsDescriptor),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_RESTIR_DIRECT, &directDescriptor),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_RESTIR_ALBEDO, &albedoDescriptor),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, B_RESTIR_OUTPUT, &outputDescriptor),
+		};
+		vkUpdateDescriptorSets(getLogicalDevice(), static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void RenderpassRestirDI::preparePipelines()
+	{
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(SPC_RestirConfig), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&m_descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(getLogicalDevice(), &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout));
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(m_pipelineLayout, 0);
+		computePipelineCreateInfo.stage = m_rtFilterDemo->LoadShader("restir/restir_temporal.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(getLogicalDevice(), nullptr, 1, &computePipelineCreateInfo, nullptr, &m_pipeline));
+
+		computePipelineCreateInfo.stage = m_rtFilterDemo->LoadShader("restir/restir_spatial.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(getLogicalDevice(), nullptr, 1, &computePipelineCreateInfo, nullptr, &m_SpatialPipeline));
+	}
+
+	void RenderpassRestirDI::buildCommandBuffer()
+	{
+		if (m_CmdBuffer == nullptr)
+		{
+			m_CmdBuffer = m_vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+		}
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(m_CmdBuffer, &cmdBufInfo));
+
+		// Reservoir rows are RenderWidth long and their pixels move with the render size, so a new size drops the history
+		if (m_config.RenderWidth != m_ReservoirSize.width || m_config.RenderHeight != m_ReservoirSize.height)
+		{
+			vkCmdFillBuffer(m_CmdBuffer, m_Reservoirs.buffer, 0, VK_WHOLE_SIZE, 0);
+			VkMemoryBarrier fillBarrier = vks::initializers::memoryBarrier();
+			fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			fillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(
+				m_CmdBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 1, &fillBarrier, 0, nullptr, 0, nullptr);
+			m_ReservoirSize = { m_config.RenderWidth, m_config.RenderHeight };
+		}
+
+		vkCmdBindDescriptorSets(m_CmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+		vkCmdPushConstants(m_CmdBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SPC_RestirConfig), &m_config);
+
+		// Matches the 8x8 work group size of the ReSTIR shaders
+		const uint32_t groupCountX = (m_config.RenderWidth + 7) / 8;
+		const uint32_t groupCountY = (m_config.RenderHeight + 7) / 8;
+
+		// Initial candidates and temporal reuse
+		vkCmdBindPipeline(m_CmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+		vkCmdDispatch(m_CmdBuffer, groupCountX, groupCountY, 1);
+
+		// The spatial pass reads the temporal reservoirs of neighbouring pixels, and overwrites the final reservoirs read above
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			m_CmdBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		// Spatial reuse and shading
+		vkCmdBindPipeline(m_CmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_SpatialPipeline);
+		vkCmdDispatch(m_CmdBuffer, groupCountX, groupCountY, 1);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(m_CmdBuffer));
+	}
+
+	void RenderpassRestirDI::draw(const VkCommandBuffer*& out_commandBuffers, uint32_t& out_commandBufferCount)
+	{
+		m_config.Frame++;
+		m_config.LightCount = m_rtFilterDemo->m_renderpassManager->m_RP_PT->m_pathtracerconfig.LightCount;
+		// Reservoirs are allocated for the full size, dynamic resolution only uses the start of them
+		const VkExtent2D renderSize = m_attachmentManager->GetRenderSize();
+		m_config.RenderWidth = renderSize.width;
+		m_config.RenderHeight = renderSize.height;
+		buildCommandBuffer();
+		out_commandBufferCount = 1;
+		out_commandBuffers = &m_CmdBuffer;
+	}
+
+	void RenderpassRestirDI::cleanUp()
+	{
+		if (m_CmdBuffer != nullptr)
+		{
+			vkFreeCommandBuffers(getLogicalDevice(), m_vulkanDevice->commandPool, 1, &m_CmdBuffer);
+			m_CmdBuffer = nullptr;
+		}
+		vkDestroyPipeline(getLogicalDevice(), m_SpatialPipeline, nullptr);
+		vkDestroyPipeline(getLogicalDevice(), m_pipeline, nullptr);
+		vkDestroyPipelineLayout(getLogicalDevice(), m_pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(getLogicalDevice(), m_descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(getLogicalDevice(), m_descriptorPool, nullptr);
+		m_Reservoirs.destroy();
+		m_TemporalReservoirs.destroy();
+	}
+}
@@ -0,0 +1,221 @@
+#include "../../headers/renderpasses/Renderpass_Skinning.hpp"
+#include "../../headers/RTFilterDemo.hpp"
+
+namespace rtf
+{
+	void RenderpassSkinning::prepare()
+	{
+		m_Scene = &(m_rtFilterDemo->m_Scene);
+
+		m_SkinnedNodes.clear();
+		m_JointCount = 0;
+		for (vkglTF::Node* node : m_Scene->linearNodes)
+		{
+			if (node->mesh != nullptr && node->skin != nullptr)
+			{
+				m_SkinnedNodes.push_back({ node, m_JointCount });
+				m_JointCount += static_cast<uint32_t>(node->skin->joints.size());
+			}
+		}
+
+		if (!isActive())
+		{
+			return;
+		}
+
+		createBuffers();
+		updateUniformBuffer();
+		setupDescriptors();
+		preparePipeline();
+		buildCommandBuffer();
+
+		// Skin the current pose once, so the first frame's previous pose is not the rest pose
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &m_CmdBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(m_rtFilterDemo->queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vkQueueWaitIdle(m_rtFilterDemo->queue));
+	}
+
+	VkBuffer RenderpassSkinning::getVertexBuffer() const
+	{
+		return isActive() ? m_AnimatedVertices.buffer : m_Scene->vertices.buffer;
+	}
+
+	VkBuffer RenderpassSkinning::getPreviousVertexBuffer() const
+	{
+		return isActive() ? m_PreviousVertices.buffer : m_Scene->vertices.buffer;
+	}
+
+	void RenderpassSkinning::createBuffers()
+	{
+		const VkDeviceSize vertexBufferSize = static_cast<VkDeviceSize>(m_Scene->vertices.count) * sizeof(vkglTF::Vertex);
+
+		// Same usage as the scene vertex buffer, so it can be bound for rasterization and used as BLAS build input
+		VK_CHECK_RESULT(m_vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | vkglTF::memoryPropertyFlags,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&m_AnimatedVertices,
+			vertexBufferSize));
+		VK_CHECK_RESULT(m_vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&m_PreviousVertices,
+			vertexBufferSize));
+
+		VK_CHECK_RESULT(m_vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&m_JointMatrices,
+			sizeof(glm::mat4) * m_JointCount));
+		VK_CHECK_RESULT(m_JointMatrices.map());
+
+		// Attributes which are not touched by skinning only have to be copied once
+		VkCommandBuffer copyCmd = m_vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkBufferCopy copyRegion{};
+		copyRegion.size = vertexBufferSize;
+		vkCmdCopyBuffer(copyCmd, m_Scene->vertices.buffer, m_AnimatedVertices.buffer, 1, &copyRegion);
+		vkCmdCopyBuffer(copyCmd, m_Scene->vertices.buffer, m_PreviousVertices.buffer, 1, &copyRegion);
+		m_vulkanDevice->flushCommandBuffer(copyCmd, m_rtFilterDemo->queue);
+	}
+
+	void RenderpassSkinning::updateUniformBuffer()
+	{
+		if (!isActive())
+		{
+			return;
+		}
+		// Joint matrices map from the baked vertex positions (see Node::bakedMatrix) to the skinned pose in the same space
+		glm::mat4* jointMatrices = static_cast<glm::mat4*>(m_JointMatrices.mapped);
+		for (const SkinnedNode& skinned : m_SkinnedNodes)
+		{
+			const vkglTF::Skin* skin = skinned.node->skin;
+			const glm::mat4 inverseBaked = glm::inverse(skinned.node->bakedMatrix);
+			for (size_t i = 0; i < skin->joints.size(); i++)
+			{
+				jointMatrices[skinned.jointOffset + i] = m_Scene->axisMatrix * skin->joints[i]->getMatrix() * skin->inverseBindMatrices[i] * inverseBaked;
+			}
+		}
+	}
+
+	void RenderpassSkinning::setupDescriptors()
+	{
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Rest pose vertices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Animated vertices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Joint matrices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3: Hit shading vertices (normals are updated in place)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			// Binding 4: Previous frame's vertices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(getLogicalDevice(), &descriptorLayout, nullptr, &m_descriptorSetLayout));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5)
+		};
+		VkDescriptorPoolCreateInfo poolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(getLogicalDevice(), &poolCI, nullptr, &m_descriptorPool));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &m_descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(getLogicalDevice(), &allocInfo, &m_descriptorSet));
+
+		VkDescriptorBufferInfo restVerticesDescriptor{ m_Scene->vertices.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo animatedVerticesDescriptor{ m_AnimatedVertices.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo jointMatricesDescriptor{ m_JointMatrices.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo hitVerticesDescriptor{ m_Scene->hitVertices.buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo previousVerticesDescriptor{ m_PreviousVertices.buffer, 0, VK_WHOLE_SIZE };
+
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &restVerticesDescriptor),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &animatedVerticesDescriptor),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &jointMatricesDescriptor),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &hitVerticesDescriptor),
+			vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &previousVerticesDescriptor),
+		};
+		vkUpdateDescriptorSets(getLogicalDevice(), static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void RenderpassSkinning::preparePipeline()
+	{
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(SPC_SkinningConfig), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&m_descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(getLogicalDevice(), &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout));
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(m_pipelineLayout, 0);
+		computePipelineCreateInfo.stage = m_rtFilterDemo->LoadShader("skinning/skinning.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(getLogicalDevice(), nullptr, 1, &computePipelineCreateInfo, nullptr, &m_pipeline));
+	}
+
+	void RenderpassSkinning::buildCommandBuffer()
+	{
+		if (m_CmdBuffer == nullptr)
+		{
+			m_CmdBuffer = m_vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+		}
+
+		// Joint matrices live in host coherent memory, so the recorded dispatches stay valid across frames
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(m_CmdBuffer, &cmdBufInfo));
+
+		vkCmdBindPipeline(m_CmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+		vkCmdBindDescriptorSets(m_CmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+
+		const uint32_t workgroupSize = 64;
+		for (const SkinnedNode& skinned : m_SkinnedNodes)
+		{
+			for (const vkglTF::Primitive* primitive : skinned.node->mesh->primitives)
+			{
+				SPC_SkinningConfig config{};
+				config.FirstVertex = primitive->firstVertex;
+				config.VertexCount = primitive->vertexCount;
+				config.JointOffset = skinned.jointOffset;
+				vkCmdPushConstants(m_CmdBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SPC_SkinningConfig), &config);
+				vkCmdDispatch(m_CmdBuffer, (config.VertexCount + workgroupSize - 1) / workgroupSize, 1, 1);
+			}
+		}
+
+		// Consumers are vertex input and previous pose reads (G-buffer), BLAS refit and hit shader reads of the hit vertex stream (path tracer)
+		const VkPipelineStageFlags traceStage = m_rtFilterDemo->m_useRayQueryPathTracer ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+		vkCmdPipelineBarrier(
+			m_CmdBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | traceStage,
+			0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(m_CmdBuffer));
+	}
+
+	void RenderpassSkinning::draw(const VkCommandBuffer*& out_commandBuffers, uint32_t& out_commandBufferCount)
+	{
+		// Without skins the submission only forwards the semaphore chain
+		out_commandBufferCount = isActive() ? 1 : 0;
+		out_commandBuffers = &m_CmdBuffer;
+	}
+
+	void RenderpassSkinning::cleanUp()
+	{
+		if (!isActive())
+		{
+			return;
+		}
+		vkFreeCommandBuffers(getLogicalDevice(), m_vulkanDevice->commandPool, 1, &m_CmdBuffer);
+		vkDestroyPipeline(getLogicalDevice(), m_pipeline, nullptr);
+		vkDestroyPipelineLayout(getLogicalDevice(), m_pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(getLogicalDevice(), m_descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(getLogicalDevice(), m_descriptorPool, nullptr);
+		m_JointMatrices.destroy();
+		m_AnimatedVertices.destroy();
+		m_PreviousVertices.destroy();
+		m_SkinnedNodes.clear();
+	}
+}